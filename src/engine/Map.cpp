@@ -34,12 +34,27 @@ Map::Map( MapManifest *manifest ) : manifest_( manifest ) {
 		tilePath = "maps/" + manifest_->filename + "/tiles/";
 	}
 
-	// create the terrain
-	terrain_ = new Terrain( tilePath );
-	// then load the Pmg if it exists otherwise
+	// load the Pmg if it exists otherwise
 	// we'll just assume it's a new map (heightmap data can be imported after)
 	std::string pmgPath = "maps/" + manifest_->filename + "/" + manifest_->filename + ".pmg";
-	terrain_->LoadPmg( pmgPath );
+	if ( PagedTerrain::IsPagedPmg( pmgPath ) ) {
+		// too large to hold every chunk's mesh at once, so they're paged in around the camera instead
+		paged_terrain_ = new PagedTerrain( pmgPath, tilePath );
+	} else {
+		terrain_ = new Terrain( tilePath );
+
+		// the cooked terrain is used instead so long as the Pmg and tileset haven't changed
+		std::string cachePath = GetTerrainCachePath();
+		if ( cachePath.empty() || !terrain_->Deserialize( cachePath, pmgPath ) ) {
+			terrain_->LoadPmg( pmgPath );
+			if ( !cachePath.empty() ) {
+				terrain_->Serialize( cachePath );
+			}
+		}
+
+		// generate anything that wasn't loaded in
+		terrain_->Update();
+	}
 
 	std::string pogPath = "maps/" + manifest_->filename + "/" + manifest_->filename + ".pog";
 	LoadSpawns( pogPath );
@@ -49,9 +64,22 @@ Map::Map( MapManifest *manifest ) : manifest_( manifest ) {
 }
 
 Map::~Map() {
+	Engine::Resource()->Release( sky_model_top_ );
+	Engine::Resource()->Release( sky_model_bottom_ );
+
+	delete paged_terrain_;
 	delete terrain_;
 }
 
+std::string Map::GetTerrainCachePath() {
+	std::string path = Engine::GetCacheDirectory( "maps/" );
+	if ( path.empty() ) {
+		return "";
+	}
+
+	return path + manifest_->filename + ".terrain";
+}
+
 void Map::LoadSky() {
 	if ( sky_model_top_ == nullptr ) {
 		sky_model_top_ = LoadSkyModel( "skys/skydome" );
@@ -63,7 +91,7 @@ void Map::LoadSky() {
 }
 
 PLModel *Map::LoadSkyModel( const std::string &path ) {
-	PLModel *model = Engine::Resource()->LoadModel( path, true, true );
+	PLModel *model = Engine::Resource()->LoadModel( path, false, true );
 	model->model_matrix = plTranslateMatrix4( PLVector3( TERRAIN_PIXEL_WIDTH / 2, 0, TERRAIN_PIXEL_WIDTH / 2 ) );
 	// Default skydome is smaller than the map, so we'll scale it
 	model->model_matrix = plScaleMatrix4( model->model_matrix, PLVector3( 5, 5, 5 ) );
@@ -208,6 +236,56 @@ void Map::LoadSpawns( const std::string &path ) {
 	}
 }
 
+float Map::GetPixelWidth() const {
+	return ( paged_terrain_ != nullptr ) ? paged_terrain_->GetPixelWidth() : TERRAIN_PIXEL_WIDTH;
+}
+
+float Map::GetHeight( const PLVector2& pos ) {
+	return ( paged_terrain_ != nullptr ) ? paged_terrain_->GetHeight( pos ) : terrain_->GetHeight( pos );
+}
+
+float Map::GetMaxHeight() {
+	return ( paged_terrain_ != nullptr ) ? paged_terrain_->GetMaxHeight() : terrain_->GetMaxHeight();
+}
+
+Terrain::Tile::Surface Map::GetSurface( const PLVector2& pos ) {
+	if ( paged_terrain_ != nullptr ) {
+		return paged_terrain_->GetSurface( pos );
+	}
+
+	Terrain::Tile tile = terrain_->GetTile( pos );
+	return tile.IsValid() ? tile.GetSurface() : Terrain::Tile::SURFACE_MUD;
+}
+
+Terrain::Tile::Behaviour Map::GetBehaviour( const PLVector2& pos ) {
+	if ( paged_terrain_ != nullptr ) {
+		return paged_terrain_->GetBehaviour( pos );
+	}
+
+	Terrain::Tile tile = terrain_->GetTile( pos );
+	return tile.IsValid() ? tile.GetBehaviour() : Terrain::Tile::BEHAVIOUR_NONE;
+}
+
+bool Map::Raycast( const PLVector3& origin, const PLVector3& direction, float max_distance,
+				   PLVector3* hit, float* distance ) {
+	if ( paged_terrain_ != nullptr ) {
+		return paged_terrain_->Raycast( origin, direction, max_distance, hit, distance );
+	}
+
+	return terrain_->Raycast( origin, direction, max_distance, hit, distance );
+}
+
+/**
+ * Pages the terrain in around the camera, for maps that are too large to
+ * be held all at once. Done here rather than on draw, so the ground is there
+ * for anything ticking whether or not it's being drawn.
+ */
+void Map::Tick() {
+	if ( paged_terrain_ != nullptr ) {
+		paged_terrain_->Update( Engine::Game()->GetCamera()->GetPosition() );
+	}
+}
+
 void Map::Draw() {
 	Shaders_SetProgramByName( "generic_untextured" );
 
@@ -236,7 +314,11 @@ void Map::Draw() {
 	plSetNamedShaderUniformVector4( program, "sun_colour", manifest_->sun_colour.ToVec4() );
 	plSetNamedShaderUniformVector4( program, "ambient_colour", manifest_->ambient_colour.ToVec4() );
 
-	terrain_->Draw();
+	if ( paged_terrain_ != nullptr ) {
+		paged_terrain_->Draw();
+	} else {
+		terrain_->Draw();
+	}
 
 #if 0 // debug sun position
 	Shaders_SetProgramByName( "generic_untextured" );
@@ -18,6 +18,7 @@
 #pragma once
 
 #include "terrain.h"
+#include "paged_terrain.h"
 
 struct MapManifest;
 
@@ -30,10 +31,24 @@ class Map {
   explicit Map(MapManifest* manifest);
   ~Map();
 
+  void Tick();
   void Draw();
 
   MapManifest* GetManifest() { return manifest_; }
+  // Only one or the other, depending on whether the map is too large for Terrain.
   Terrain* GetTerrain() { return terrain_; }
+  PagedTerrain* GetPagedTerrain() { return paged_terrain_; }
+
+  // The ground, from whichever terrain the map has; anywhere off of it is flat at 0.
+  float GetPixelWidth() const;
+  float GetHeight(const PLVector2& pos);
+  float GetMaxHeight();
+  Terrain::Tile::Surface GetSurface(const PLVector2& pos);
+  Terrain::Tile::Behaviour GetBehaviour(const PLVector2& pos);
+  bool Raycast(const PLVector3& origin, const PLVector3& direction, float max_distance,
+               PLVector3* hit = nullptr, float* distance = nullptr);
+  // Null for paged maps, which have no overview.
+  PLTexture* GetOverview() { return (terrain_ != nullptr) ? terrain_->GetOverview() : nullptr; }
 
   const std::vector<ActorSpawn>& GetSpawns() { return spawns_; }
 
@@ -45,6 +60,8 @@ class Map {
   void LoadSky();
   static PLModel* LoadSkyModel(const std::string& path);
 
+  std::string GetTerrainCachePath();
+
   void UpdateSkyModel(PLModel* model);
 
   MapManifest* manifest_{nullptr};
@@ -55,4 +72,5 @@ class Map {
   PLModel* sky_model_bottom_{nullptr};
 
   Terrain* terrain_{nullptr};
+  PagedTerrain* paged_terrain_{nullptr};
 };
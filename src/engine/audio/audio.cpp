@@ -363,6 +363,9 @@ AudioManager::~AudioManager() {
 }
 
 const AudioSample *AudioManager::CacheSample( const std::string &path, bool preserve ) {
+	// so it can be preloaded the next time the map is played
+	Engine::Resource()->RecordSampleRequest( path );
+
 	auto i = samples_.find( path );
 	if ( i != samples_.end()) {
 		return &( i->second );
@@ -153,9 +153,11 @@ PLConsoleVariable *cv_debug_fps = nullptr;
 PLConsoleVariable *cv_debug_skeleton = nullptr;
 PLConsoleVariable *cv_debug_input = nullptr;
 PLConsoleVariable *cv_debug_cache = nullptr;
+PLConsoleVariable *cv_debug_resource_stats = nullptr;
 PLConsoleVariable *cv_debug_shaders = nullptr;
 
 PLConsoleVariable *cv_game_language = nullptr;
+PLConsoleVariable *cv_game_preload_manifests = nullptr;
 
 PLConsoleVariable *cv_camera_mode = nullptr;
 PLConsoleVariable *cv_camera_fov = nullptr;
@@ -175,8 +177,16 @@ PLConsoleVariable *cv_graphics_draw_world = nullptr;
 PLConsoleVariable *cv_graphics_draw_sprites = nullptr;
 PLConsoleVariable *cv_graphics_draw_audio_sources = nullptr;
 PLConsoleVariable *cv_graphics_texture_filter = nullptr;
+PLConsoleVariable *cv_graphics_texture_compression = nullptr;
+PLConsoleVariable *cv_graphics_texture_cache_size = nullptr;
+PLConsoleVariable *cv_graphics_upload_budget = nullptr;
+PLConsoleVariable *cv_graphics_resource_budget = nullptr;
 PLConsoleVariable *cv_graphics_alpha_to_coverage = nullptr;
 PLConsoleVariable *cv_graphics_debug_normals = nullptr;
+PLConsoleVariable *cv_graphics_terrain_lod_distance = nullptr;
+PLConsoleVariable *cv_graphics_terrain_page_radius = nullptr;
+PLConsoleVariable *cv_graphics_terrain_page_budget = nullptr;
+PLConsoleVariable *cv_graphics_terrain_overview_scale = nullptr;
 
 PLConsoleVariable *cv_audio_volume = nullptr;
 PLConsoleVariable *cv_audio_volume_sfx = nullptr;
@@ -224,9 +234,14 @@ void Console_Initialize( void ) {
 		  "1: keyboard states\n2: controller states"
 	);
 	rvar( cv_debug_cache, false, "0", pl_bool_var, nullptr, "display memory and other info" );
+	rvar( cv_debug_resource_stats, false, "0", pl_bool_var, nullptr,
+		  "record how long each texture and model spends in io, decoding and uploading as it's loaded" );
 	rvar( cv_debug_shaders, false, "-1", pl_int_var, nullptr, "Forces specified GLSL shader on all draw calls." );
 
 	rvar( cv_game_language, true, "eng", pl_string_var, &LanguageManager::SetLanguageCallback, "Set the language" );
+	rvar( cv_game_preload_manifests, true, "1", pl_int_var, nullptr,
+		  "0 = disabled, 1 = preload whatever maps were recorded using and record any without, "
+		  "2 = also add anything new each time a map is played" );
 
 	rvar( cv_camera_mode, false, "0", pl_int_var, nullptr, "0 = default, 1 = debug" );
 	rvar( cv_camera_fov, true, "75", pl_float_var, nullptr, "field of view" );
@@ -246,8 +261,24 @@ void Console_Initialize( void ) {
 	rvar( cv_graphics_draw_sprites, false, "true", pl_bool_var, nullptr, "Toggles rendering of sprites." );
 	rvar( cv_graphics_draw_audio_sources, false, "false", pl_bool_var, nullptr, "toggles rendering of audio sources" );
 	rvar( cv_graphics_texture_filter, true, "false", pl_bool_var, nullptr, "Filter level/model textures?" );
+	rvar( cv_graphics_texture_compression, true, "true", pl_bool_var, nullptr,
+		  "prefer block compressed textures where they exist and the driver supports them" );
+	rvar( cv_graphics_texture_cache_size, true, "512", pl_int_var, nullptr,
+		  "most disk space decoded textures can be cached in, in megabytes, 0 = disabled" );
+	rvar( cv_graphics_upload_budget, true, "2", pl_float_var, nullptr,
+		  "time spent uploading resources loaded in the background each frame, in milliseconds" );
+	rvar( cv_graphics_resource_budget, true, "262144", pl_int_var, nullptr,
+		  "most memory cached textures and models can take up before unused ones are evicted, in kilobytes" );
 	rvar( cv_graphics_alpha_to_coverage, true, "false", pl_bool_var, nullptr, "Enable/disable alpha-to-coverage" );
 	rvar( cv_graphics_debug_normals, false, "false", pl_bool_var, nullptr, "Forces normals to be displayed" );
+	rvar( cv_graphics_terrain_lod_distance, true, "8192", pl_float_var, nullptr,
+		  "distance between each terrain level of detail, 0 = always use the highest" );
+	rvar( cv_graphics_terrain_page_radius, true, "8", pl_int_var, nullptr,
+		  "chunks kept paged in around the camera, for maps too large to keep whole" );
+	rvar( cv_graphics_terrain_page_budget, true, "65536", pl_int_var, nullptr,
+		  "most memory paged terrain chunks can take up, in kilobytes" );
+	rvar( cv_graphics_terrain_overview_scale, true, "1", pl_int_var, nullptr,
+		  "pixels along each side of a tile on the terrain overview, from 1 to 8" );
 
 	rvar( cv_audio_volume, true, "1", pl_float_var, nullptr, "set global audio volume" );
 	rvar( cv_audio_volume_sfx, true, "1", pl_float_var, nullptr, "set sfx audio volume" );
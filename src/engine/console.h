@@ -24,9 +24,11 @@ extern PLConsoleVariable *cv_debug_fps;
 extern PLConsoleVariable *cv_debug_skeleton;
 extern PLConsoleVariable *cv_debug_input;
 extern PLConsoleVariable *cv_debug_cache;
+extern PLConsoleVariable *cv_debug_resource_stats;
 extern PLConsoleVariable *cv_debug_shaders;
 
 extern PLConsoleVariable *cv_game_language;
+extern PLConsoleVariable *cv_game_preload_manifests;
 
 extern PLConsoleVariable *cv_camera_mode;
 extern PLConsoleVariable *cv_camera_fov;
@@ -46,8 +48,16 @@ extern PLConsoleVariable* cv_graphics_draw_world;
 extern PLConsoleVariable* cv_graphics_draw_sprites;
 extern PLConsoleVariable* cv_graphics_draw_audio_sources;
 extern PLConsoleVariable *cv_graphics_texture_filter;
+extern PLConsoleVariable *cv_graphics_texture_compression;
+extern PLConsoleVariable *cv_graphics_texture_cache_size;
+extern PLConsoleVariable *cv_graphics_upload_budget;
+extern PLConsoleVariable *cv_graphics_resource_budget;
 extern PLConsoleVariable *cv_graphics_alpha_to_coverage;
 extern PLConsoleVariable *cv_graphics_debug_normals;
+extern PLConsoleVariable *cv_graphics_terrain_lod_distance;
+extern PLConsoleVariable *cv_graphics_terrain_page_radius;
+extern PLConsoleVariable *cv_graphics_terrain_page_budget;
+extern PLConsoleVariable *cv_graphics_terrain_overview_scale;
 
 extern PLConsoleVariable *cv_audio_volume;
 extern PLConsoleVariable *cv_audio_volume_sfx;
@@ -32,14 +32,18 @@ public:
 		texturePath = path;
 	}
 
-	~TextureViewer() override = default;
+	~TextureViewer() override {
+		if ( !texturePath.empty() ) {
+			openhow::Engine::Resource()->Release( texturePtr );
+		}
+	}
 
 	void ReloadTexture( PLTextureFilter filter_mode ) {
 		if ( texturePath.empty() || filter_mode == filterMode ) {
 			return;
 		}
 
-		plDestroyTexture( texturePtr );
+		openhow::Engine::Resource()->Release( texturePtr );
 		texturePtr = openhow::Engine::Resource()->LoadTexture( texturePath, filter_mode );
 		filterMode = filter_mode;
 	}
@@ -42,6 +42,9 @@ openhow::Engine::Engine() {
 	g_state.gfx.num_actors_drawn = 0;
 	g_state.gfx.num_chunks_drawn = 0;
 	g_state.gfx.num_triangles_total = 0;
+	g_state.gfx.num_chunks_total = 0;
+	g_state.gfx.num_terrain_draws = 0;
+	g_state.gfx.terrain_buffer_bytes = 0;
 }
 
 openhow::Engine::~Engine() {
@@ -52,6 +55,7 @@ openhow::Engine::~Engine() {
 	delete game_manager_;
 	delete audio_manager_;
 	delete resource_manager_;
+	delete job_pool_;
 
 	IPhysicsInterface::DestroyInstance( physics_interface_ );
 	LanguageManager::DestroyInstance();
@@ -84,6 +88,9 @@ void openhow::Engine::Initialize() {
 
 	// now initialize all other sub-systems
 
+	// the main thread also takes jobs, so leave a core for it
+	job_pool_ = new JobPool( std::max( std::thread::hardware_concurrency(), 1U ) - 1 );
+
 	Input_Initialize();
 	Display_Initialize();
 	resource_manager_ = new ResourceManager();
@@ -120,6 +127,30 @@ std::string openhow::Engine::GetVersionString() {
 		GIT_BRANCH + ":" + GIT_COMMIT_HASH + "-" + GIT_COMMIT_COUNT;
 }
 
+std::string openhow::Engine::GetAppDataDirectory( const std::string &subdir ) {
+	char out[PL_SYSTEM_MAX_PATH];
+	if ( plGetApplicationDataDirectory( ENGINE_APP_NAME, out, PL_SYSTEM_MAX_PATH ) == nullptr ) {
+		LogWarn( "Failed to get app data directory!\n%s\n", plGetError() );
+		return "";
+	}
+
+	std::string path = std::string( out ) + subdir;
+	if ( !subdir.empty() && !plCreatePath( path.c_str() ) ) {
+		LogWarn( "Failed to create \"%s\"!\n%s\n", path.c_str(), plGetError() );
+		return "";
+	}
+
+	return path;
+}
+
+/**
+ * Everything under here can be thrown away at any time,
+ * and is rebuilt from the game's data as it's needed.
+ */
+std::string openhow::Engine::GetCacheDirectory( const std::string &subdir ) {
+	return GetAppDataDirectory( "cache/" + subdir );
+}
+
 bool openhow::Engine::IsRunning() {
 	System_PollEvents();
 
@@ -144,6 +175,8 @@ bool openhow::Engine::IsRunning() {
 		loops++;
 	}
 
+	Resource()->ProcessPendingLoads();
+
 	deltaTime = ( double ) ( System_GetTicks() + SKIP_TICKS - next_tick ) / ( double ) ( SKIP_TICKS );
 	Display_Draw( deltaTime );
 
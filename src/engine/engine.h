@@ -52,6 +52,7 @@
 
 #ifdef __cplusplus
 #include "resource_manager.h"
+#include "job_pool.h"
 
 #include "audio/audio.h"
 #include "game/game.h"
@@ -77,11 +78,18 @@ public:
 	static IPhysicsInterface *Physics() {
 		return engine->physics_interface_;
 	}
+	static JobPool *Jobs() {
+		return engine->job_pool_;
+	}
 
 	void Initialize();
 
 	std::string GetVersionString();
 
+	// both hand back the path with a trailing slash, creating it if needed, or an empty string on failure
+	static std::string GetAppDataDirectory( const std::string &subdir = "" );
+	static std::string GetCacheDirectory( const std::string &subdir = "" );
+
 	bool IsRunning();
 
 	double GetDeltaTime() { return deltaTime; }
@@ -91,6 +99,7 @@ private:
 	AudioManager *audio_manager_{ nullptr };
 	ResourceManager *resource_manager_{ nullptr };
 	IPhysicsInterface *physics_interface_{ nullptr };
+	JobPool *job_pool_{ nullptr };
 
 	double deltaTime{ 0 };
 };
@@ -115,8 +124,12 @@ typedef struct EngineState {
 
 	struct {
 		unsigned int num_chunks_drawn;
+		unsigned int num_chunks_total;
 		unsigned int num_actors_drawn;
 		unsigned int num_triangles_total;
+
+		unsigned int num_terrain_draws;      // draw calls submitted for the terrain
+		unsigned int terrain_buffer_bytes;   // vertex and index data held by the terrain
 	} gfx;
 } EngineState;
 extern EngineState g_state;
@@ -138,6 +151,7 @@ void System_DisplayMessageBox( unsigned int level, const char *msg, ... );
 void System_DisplayWindow( bool fullscreen, int width, int height );
 
 int System_SetSwapInterval( int interval );
+bool System_IsGLExtensionSupported( const char *extension );
 void System_SwapDisplay( void );
 
 void System_SetWindowTitle( const char *title );
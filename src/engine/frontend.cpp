@@ -98,22 +98,22 @@ static void FrontendInputCallback( int key, bool is_pressed ) {
 
 static void FrontEnd_CacheGameData() {
 	fe_tx_game_textures[ FE_TEXTURE_ANG ] =
-		Engine::Resource()->LoadTexture( "frontend/dash/ang", PL_TEXTURE_FILTER_LINEAR, true );
+		Engine::Resource()->LoadTexture( "frontend/dash/ang", PL_TEXTURE_FILTER_LINEAR );
 	fe_tx_game_textures[ FE_TEXTURE_ANGPOINT ] =
-		Engine::Resource()->LoadTexture( "frontend/dash/angpoint", PL_TEXTURE_FILTER_LINEAR, true );
+		Engine::Resource()->LoadTexture( "frontend/dash/angpoint", PL_TEXTURE_FILTER_LINEAR );
 	fe_tx_game_textures[ FE_TEXTURE_CLOCK ] =
-		Engine::Resource()->LoadTexture( "frontend/dash/clock", PL_TEXTURE_FILTER_LINEAR, true );
+		Engine::Resource()->LoadTexture( "frontend/dash/clock", PL_TEXTURE_FILTER_LINEAR );
 	fe_tx_game_textures[ FE_TEXTURE_CLIGHT ] =
-		Engine::Resource()->LoadTexture( "frontend/dash/timlit.png", PL_TEXTURE_FILTER_LINEAR, true );
+		Engine::Resource()->LoadTexture( "frontend/dash/timlit.png", PL_TEXTURE_FILTER_LINEAR );
 	fe_tx_game_textures[ FE_TEXTURE_TIMER ] =
-		Engine::Resource()->LoadTexture( "frontend/dash/timer", PL_TEXTURE_FILTER_LINEAR, true );
+		Engine::Resource()->LoadTexture( "frontend/dash/timer", PL_TEXTURE_FILTER_LINEAR );
 }
 
 static void FrontEnd_CacheMenuData() {
-	fe_background = Engine::Resource()->LoadTexture( "frontend/pigbkpc1", PL_TEXTURE_FILTER_LINEAR, true );
+	fe_background = Engine::Resource()->LoadTexture( "frontend/pigbkpc1", PL_TEXTURE_FILTER_LINEAR );
 	for ( unsigned int i = 0; i < MAX_TEAMS; ++i ) {
 		fe_papers_teams[ i ] =
-			Engine::Resource()->LoadTexture( papers_teams_paths[ i ], PL_TEXTURE_FILTER_LINEAR, true );
+			Engine::Resource()->LoadTexture( papers_teams_paths[ i ], PL_TEXTURE_FILTER_LINEAR );
 	}
 }
 
@@ -121,15 +121,19 @@ static void FrontEnd_CacheMenuData() {
 
 void FE_Initialize( void ) {
 	FrontEnd_CacheFontData();
+
+	// kept around for as long as the game is running, regardless of any maps
+	Engine::Resource()->BeginGroup( "frontend" );
 	FrontEnd_CacheMenuData();
 	FrontEnd_CacheGameData();
 
 	// Cache all the minimap icons
-	minimapIcons[ MINIMAP_ICON_BOMB ] = Engine::Resource()->LoadTexture( "frontend/map/bomb", PL_TEXTURE_FILTER_NEAREST, true );
-	minimapIcons[ MINIMAP_ICON_HEALTH ] = Engine::Resource()->LoadTexture( "frontend/map/iconhart", PL_TEXTURE_FILTER_NEAREST, true );
-	minimapIcons[ MINIMAP_ICON_PIG ] = Engine::Resource()->LoadTexture( "frontend/map/iconpig", PL_TEXTURE_FILTER_NEAREST, true );
-	minimapIcons[ MINIMAP_ICON_PICKUP ] = Engine::Resource()->LoadTexture( "frontend/map/iconpkup.png", PL_TEXTURE_FILTER_NEAREST, true );
-	minimapIcons[ MINIMAP_ICON_PROP ] = Engine::Resource()->LoadTexture( "frontend/map/iconprop", PL_TEXTURE_FILTER_NEAREST, true );
+	minimapIcons[ MINIMAP_ICON_BOMB ] = Engine::Resource()->LoadTexture( "frontend/map/bomb", PL_TEXTURE_FILTER_NEAREST );
+	minimapIcons[ MINIMAP_ICON_HEALTH ] = Engine::Resource()->LoadTexture( "frontend/map/iconhart", PL_TEXTURE_FILTER_NEAREST );
+	minimapIcons[ MINIMAP_ICON_PIG ] = Engine::Resource()->LoadTexture( "frontend/map/iconpig", PL_TEXTURE_FILTER_NEAREST );
+	minimapIcons[ MINIMAP_ICON_PICKUP ] = Engine::Resource()->LoadTexture( "frontend/map/iconpkup.png", PL_TEXTURE_FILTER_NEAREST );
+	minimapIcons[ MINIMAP_ICON_PROP ] = Engine::Resource()->LoadTexture( "frontend/map/iconprop", PL_TEXTURE_FILTER_NEAREST );
+	Engine::Resource()->EndGroup();
 }
 
 void FE_Shutdown( void ) {
@@ -175,7 +179,10 @@ void FE_SetLoadingBackground( const char *name ) {
 		snprintf( screen_path, sizeof( screen_path ), "frontend/briefing/loadmult" );
 	}
 
-	fe_background = Engine::Resource()->LoadTexture( screen_path, PL_TEXTURE_FILTER_LINEAR );
+	// hand back whichever background was up before
+	PLTexture *texture = Engine::Resource()->LoadTexture( screen_path, PL_TEXTURE_FILTER_LINEAR );
+	Engine::Resource()->Release( fe_background );
+	fe_background = texture;
 	Redraw();
 }
 
@@ -257,7 +264,11 @@ static void FrontEnd_DrawMinimap() {
 	transform.Rotate( plDegreesToRadians( 90.0f ), PLVector3( 1, 0, 0 ) );
 	transform.Rotate( plDegreesToRadians( camera->GetAngles().y ), PLVector3( 0, 1, 0 ) );
 
-	plDrawTexturedRectangle( &transform, -64, -64, 128, 128, map->GetTerrain()->GetOverview() );
+	// paged maps are too large to have an overview, but everything else can still be shown
+	PLTexture *overview = map->GetOverview();
+	if ( overview != nullptr ) {
+		plDrawTexturedRectangle( &transform, -64, -64, 128, 128, overview );
+	}
 
 	// Now draw everything on top
 	for ( const auto &actor : ActorManager::GetInstance()->GetActors() ) {
@@ -313,6 +324,11 @@ static void FrontEnd_DrawMinimap() {
  * later. */
 
 static void DrawLoadingScreen() {
+	// anything still being loaded in the background takes over the bar
+	if ( Engine::Resource()->GetNumPendingLoads() > 0 ) {
+		loading_progress = Engine::Resource()->GetLoadProgress();
+	}
+
 	PLMatrix4 transform = plMatrix4Identity();
 	plDrawTexturedRectangle( &transform, 0, 0, frontend_width, frontend_height, fe_background );
 
@@ -134,7 +134,7 @@ void Actor::DropToFloor() {
 	}
 
 	PLVector3 nPosition = position_;
-	float height = map->GetTerrain()->GetHeight( PLVector2( nPosition.x, nPosition.z ) );
+	float height = map->GetHeight( PLVector2( nPosition.x, nPosition.z ) );
 	nPosition.y = height + bounds_.GetValue().y;
 	SetPosition( nPosition );
 }
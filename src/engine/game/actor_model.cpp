@@ -45,15 +45,16 @@ void AModel::Draw() {
 	mat.Rotate( angles.x, { 0, 0, 1 } );
 	mat.Translate( position_ );
 
-	Model_Draw( model_, mat );
+	// stands in with the fallback until it's loaded
+	Model_Draw( model_->Get(), mat );
 }
 
 void AModel::SetModel( const std::string &path ) {
-	model_ = Engine::Resource()->LoadModel( "chars/" + path, false );
-	u_assert( model_ != nullptr );
+	// loaded in the background, so new actors don't hitch the game
+	model_ = Engine::Resource()->LoadModelAsync( "chars/" + path, false );
 
 	// Keep model path up-to-date
-	modelPath = model_->path;
+	modelPath = "chars/" + path;
 }
 
 void AModel::ShowModel( bool show ) {
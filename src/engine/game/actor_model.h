@@ -32,7 +32,7 @@ public:
 	void SetModel( const std::string &path );
 
 protected:
-	PLModel *model_{ nullptr };
+	AsyncModel model_;
 
 private:
 	bool show_model_{ true };
@@ -83,7 +83,7 @@ void APig::Tick() {
 
 	// Clamp height based on current tile pos
 	Map *map = Engine::Game()->GetCurrentMap();
-	float height = map->GetTerrain()->GetHeight( { nPosition.x, nPosition.z } );
+	float height = map->GetHeight( { nPosition.x, nPosition.z } );
 	if ( ( nPosition.y - 32.f ) < height ) {
 		nPosition.y = height + 32.f;
 	}
@@ -173,7 +173,7 @@ void APig::Deserialize( const ActorSpawn &spawn ) {
 
 	// Ensure pig is spawned up in the air for deployment
 	Map *map = Engine::Game()->GetCurrentMap();
-	SetPosition( { position_.GetValue().x, map->GetTerrain()->GetMaxHeight(), position_.GetValue().z } );
+	SetPosition( { position_.GetValue().x, map->GetMaxHeight(), position_.GetValue().z } );
 
 	SetHealth( 100 );
 	SetModel( "pigs/ac_hi" ); // temp
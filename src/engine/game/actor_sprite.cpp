@@ -40,6 +40,8 @@ public:
 protected:
 private:
 	Sprite *sprite_;
+	// only what was loaded through the path is handed back
+	PLTexture *loaded_texture_{ nullptr };
 };
 
 REGISTER_ACTOR( sprite, ASprite )
@@ -52,12 +54,18 @@ ASprite::ASprite() : SuperClass() {
 
 ASprite::~ASprite() {
 	delete sprite_;
+
+	Engine::Resource()->Release( loaded_texture_ );
 }
 
 void ASprite::SetSpriteTexture( const std::string &path ) {
-	SetSpriteTexture( Engine::Resource()->LoadTexture( path,
-													   cv_graphics_texture_filter->b_value ? PL_TEXTURE_FILTER_LINEAR
-																						   : PL_TEXTURE_FILTER_NEAREST ) );
+	PLTexture *texture = Engine::Resource()->LoadTexture( path,
+														  cv_graphics_texture_filter->b_value ? PL_TEXTURE_FILTER_LINEAR
+																							  : PL_TEXTURE_FILTER_NEAREST );
+	SetSpriteTexture( texture );
+
+	Engine::Resource()->Release( loaded_texture_ );
+	loaded_texture_ = texture;
 }
 
 void ASprite::SetSpriteTexture( PLTexture *texture ) {
@@ -27,6 +27,7 @@
 #include "game.h"
 
 #include "../script/json_reader.h"
+#include "../graphics/texture_atlas.h"
 
 #include "actor_pig.h"
 #include "actor_static_model.h"
@@ -88,6 +89,15 @@ GameManager::GameManager() {
 	plRegisterConsoleCommand( "GiveItem", GiveItemCommand, "Gives a specified item to the current occupied pig." );
 	plRegisterConsoleCommand( "SpawnModel", SpawnModelCommand, "Creates a model at your current position." );
 	plRegisterConsoleCommand( "KillSelf", KillSelfCommand, "Kills the currently occupied pig." );
+	plRegisterConsoleCommand( "TerrainBenchmark", Terrain::BenchmarkCommand,
+							  "Benchmarks terrain queries and generation against the current map. "
+							  "Usage: TerrainBenchmark [heights|meshes|cull|pmg|rays|uvs|masks] [samples]" );
+	plRegisterConsoleCommand( "PagedTerrainBenchmark", PagedTerrain::BenchmarkCommand,
+							  "Flies across a generated large map, paging terrain in and out." );
+	plRegisterConsoleCommand( "TerrainDumpOverview", Terrain::DumpOverviewCommand,
+							  "Writes the current map's terrain overview out to an image." );
+	plRegisterConsoleCommand( "AtlasBenchmark", TextureAtlas::BenchmarkCommand,
+							  "Compares atlas packers against the images in the given directory." );
 
 	camera_ = new Camera( { 0, 0, 0 }, { 0, 0, 0 } );
 }
@@ -109,13 +119,17 @@ void GameManager::Tick() {
 		return;
 	}
 
+	if ( map_ != nullptr ) {
+		map_->Tick();
+	}
+
 	if ( ambient_emit_delay_ < g_state.sim_ticks ) {
 		const AudioSample *sample = ambient_samples_[ rand() % MAX_AMBIENT_SAMPLES ];
 		if ( sample != nullptr ) {
 			PLVector3 position = {
-				plGenerateRandomf( TERRAIN_PIXEL_WIDTH ),
-				map_->GetTerrain()->GetMaxHeight(),
-				plGenerateRandomf( TERRAIN_PIXEL_WIDTH )
+				plGenerateRandomf( map_->GetPixelWidth() ),
+				map_->GetMaxHeight(),
+				plGenerateRandomf( map_->GetPixelWidth() )
 			};
 			Engine::Audio()->PlayLocalSound( sample, position, { 0, 0, 0 }, true, 0.5f );
 		}
@@ -163,12 +177,17 @@ void GameManager::LoadMap( const std::string &name ) {
 		return;
 	}
 
-	Map *map = new Map( manifest );
+	// done with the last map before anything's loaded in for this one
 	if ( map_ != nullptr ) {
 		EndMode();
 	}
 
-	map_ = map;
+	// everything loaded from here on is dropped along with the map, in EndMode
+	Engine::Resource()->BeginGroup( "map" );
+
+	// whatever the map was recorded using is read in alongside the terrain
+	Engine::Resource()->BeginMapSession( name );
+	map_ = new Map( manifest );
 
 	/* todo: we should actually pause here and wait for user input
 	 *       otherwise players won't have time to read the loading screen */
@@ -177,12 +196,14 @@ void GameManager::LoadMap( const std::string &name ) {
 
 void GameManager::UnloadMap() {
 	delete map_;
+	map_ = nullptr;
 }
 
 void GameManager::CachePersistentData() {
-	// Cache all of the pig models we need
+	// Cache all of the pig models we need, kept around between maps
+	std::vector<std::string> models;
 	for ( const CharacterClass &playerClass : defaultClasses ) {
-		Engine::Resource()->LoadModel( playerClass.model, true, true );
+		models.push_back( playerClass.model );
 
 		// Now cache all the colour variations for this class
 		/*
@@ -191,6 +212,7 @@ void GameManager::CachePersistentData() {
 		}
 		 */
 	}
+	Engine::Resource()->PreloadGroup( "characters", {}, models );
 }
 
 void GameManager::RegisterTeamManifest( const std::string &path ) {
@@ -547,8 +569,10 @@ void GameManager::EndMode() {
 
 	ActorManager::GetInstance()->DestroyActors();
 
-	Engine::Resource()->ClearTextures();
-	Engine::Resource()->ClearModels();
+	// only what was specific to the map, the frontend and characters stick around for the next one
+	Engine::Resource()->EndGroup();
+	Engine::Resource()->EndMapSession();
+	Engine::Resource()->ReleaseGroup( "map" );
 
 	Engine::Audio()->FreeSources();
 	Engine::Audio()->FreeSamples();
@@ -126,7 +126,7 @@ void BaseGameMode::SpawnActors() {
 		Error( "Failed to create model actor!\n" );
 	}
 
-	model_actor->SetPosition( { TERRAIN_PIXEL_WIDTH / 2, Engine::Game()->GetCurrentMap()->GetTerrain()->GetMaxHeight(),  TERRAIN_PIXEL_WIDTH / 2, } );
+	model_actor->SetPosition( { map->GetPixelWidth() / 2, map->GetMaxHeight(), map->GetPixelWidth() / 2, } );
 
 	ActorManager::GetInstance()->ActivateActors();
 }
@@ -71,3 +71,90 @@ void Camera::MakeActive() {
 
 	plSetupCamera( camera_ );
 }
+
+/**
+ * Returns the frustum for the camera as of the last time it was made active.
+ */
+ViewFrustum Camera::GetFrustum() {
+	float aspect = 1.0f;
+	if ( camera_->viewport.h > 0 ) {
+		aspect = static_cast<float>( camera_->viewport.w ) / static_cast<float>( camera_->viewport.h );
+	}
+
+	return ViewFrustum::FromView( camera_->position, camera_->forward,
+								  camera_->fov, aspect, camera_->near, camera_->far );
+}
+
+/**
+ * Builds the frustum for a perspective view. The field of view is treated as
+ * vertical, which errs on the side of including too much should it not be.
+ * A view without a valid direction produces a frustum that includes everything.
+ */
+ViewFrustum ViewFrustum::FromView( const PLVector3 &position, const PLVector3 &forward,
+								   float fov, float aspect, float near, float far ) {
+	ViewFrustum frustum{};
+
+	float length = std::sqrt( forward.x * forward.x + forward.y * forward.y + forward.z * forward.z );
+	if ( !( length > 0.0001f ) ) {
+		return frustum;
+	}
+
+	PLVector3 f( forward.x / length, forward.y / length, forward.z / length );
+
+	// right is cross( forward, world up ), falling back to looking along z when facing straight up or down
+	PLVector3 r( -f.z, 0, f.x );
+	length = std::sqrt( r.x * r.x + r.z * r.z );
+	if ( length < 0.0001f ) {
+		r = PLVector3( 1, 0, 0 );
+	} else {
+		r = PLVector3( r.x / length, 0, r.z / length );
+	}
+
+	PLVector3 u(
+		r.y * f.z - r.z * f.y,
+		r.z * f.x - r.x * f.z,
+		r.x * f.y - r.y * f.x );
+
+	float tan_v = std::tan( plDegreesToRadians( fov ) / 2 );
+	float tan_h = tan_v * aspect;
+
+	auto make_plane = [ &position ]( float x, float y, float z ) {
+		float l = std::sqrt( x * x + y * y + z * z );
+		Plane plane;
+		plane.normal = PLVector3( x / l, y / l, z / l );
+		plane.distance = -( plane.normal.x * position.x + plane.normal.y * position.y + plane.normal.z * position.z );
+		return plane;
+	};
+
+	// left, right, bottom, top
+	frustum.planes[ 0 ] = make_plane( f.x * tan_h + r.x, f.y * tan_h + r.y, f.z * tan_h + r.z );
+	frustum.planes[ 1 ] = make_plane( f.x * tan_h - r.x, f.y * tan_h - r.y, f.z * tan_h - r.z );
+	frustum.planes[ 2 ] = make_plane( f.x * tan_v + u.x, f.y * tan_v + u.y, f.z * tan_v + u.z );
+	frustum.planes[ 3 ] = make_plane( f.x * tan_v - u.x, f.y * tan_v - u.y, f.z * tan_v - u.z );
+
+	// near and far
+	float depth = f.x * position.x + f.y * position.y + f.z * position.z;
+	frustum.planes[ 4 ].normal = f;
+	frustum.planes[ 4 ].distance = -( depth + near );
+	frustum.planes[ 5 ].normal = PLVector3( -f.x, -f.y, -f.z );
+	frustum.planes[ 5 ].distance = depth + far;
+
+	return frustum;
+}
+
+/**
+ * Conservative box test; only rejects the box if it's entirely behind one of the planes.
+ */
+bool ViewFrustum::IntersectsBox( const PLVector3 &mins, const PLVector3 &maxs ) const {
+	for ( const auto &plane : planes ) {
+		// test the corner furthest along the plane normal
+		float x = plane.normal.x >= 0 ? maxs.x : mins.x;
+		float y = plane.normal.y >= 0 ? maxs.y : mins.y;
+		float z = plane.normal.z >= 0 ? maxs.z : mins.z;
+		if ( plane.normal.x * x + plane.normal.y * y + plane.normal.z * z + plane.distance < 0 ) {
+			return false;
+		}
+	}
+
+	return true;
+}
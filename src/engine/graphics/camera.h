@@ -19,6 +19,24 @@
 
 #include <PL/platform_graphics_camera.h>
 
+/**
+ * Planes bounding everything the camera can see, each facing inwards.
+ * Built entirely on the CPU so it can be used for culling before anything
+ * is submitted, and without needing a context to test against.
+ */
+struct ViewFrustum {
+	struct Plane {
+		PLVector3 normal;
+		float distance;
+	};
+	Plane planes[ 6 ];
+
+	static ViewFrustum FromView( const PLVector3 &position, const PLVector3 &forward,
+								 float fov, float aspect, float near, float far );
+
+	bool IntersectsBox( const PLVector3 &mins, const PLVector3 &maxs ) const;
+};
+
 class Camera {
 public:
 	Camera( const PLVector3 &pos, const PLVector3 &angles );
@@ -34,6 +52,8 @@ public:
 
 	float GetFieldOfView() { return camera_->fov; }
 
+	ViewFrustum GetFrustum();
+
 	void SetViewport( const std::array<int, 2> &xy, const std::array<int, 2> &wh );
 
 	int GetViewportWidth() { return camera_->viewport.w; }
@@ -41,6 +41,7 @@ static std::vector<VideoPreset> vidPresets;
 
 static PLConsoleVariable *cv_display_show_camerapos;
 static PLConsoleVariable *cv_display_show_viewportinfo;
+static PLConsoleVariable *cv_display_show_drawstats;
 
 #if 0
 void PrintTextureCacheSizeCommand(unsigned int argc, char *argv[]) {
@@ -230,6 +231,8 @@ void Display_Initialize() {
 	cv_display_show_camerapos = plRegisterConsoleVariable( "display_show_camerapos", "0", pl_bool_var, nullptr, "" );
 	cv_display_show_viewportinfo =
 		plRegisterConsoleVariable( "display_show_viewportinfo", "0", pl_bool_var, nullptr, "" );
+	cv_display_show_drawstats =
+		plRegisterConsoleVariable( "display_show_drawstats", "0", pl_bool_var, nullptr, "" );
 
 	// check the command line for any arguments
 	const char *var;
@@ -398,6 +401,25 @@ static void DrawCameraInfoOverlay() {
 	Font_DrawBitmapString( g_fonts[ FONT_SMALL ], 20, y += 15, 0, 1.f, PL_COLOUR_WHITE, cam_pos );
 }
 
+static void DrawStatsOverlay() {
+	if ( !cv_display_show_drawstats->b_value ) {
+		return;
+	}
+
+	Font_DrawBitmapString( g_fonts[ FONT_CHARS2 ], 20, 120, 2, 1.f, PL_COLOUR_WHITE, "DRAW STATS" );
+	int y = 146;
+	char stat[64];
+	snprintf( stat, sizeof( stat ), "CHUNKS DRAWN  : %d/%d", g_state.gfx.num_chunks_drawn, g_state.gfx.num_chunks_total );
+	Font_DrawBitmapString( g_fonts[ FONT_SMALL ], 20, y, 0, 1.f, PL_COLOUR_WHITE, stat );
+	snprintf( stat, sizeof( stat ), "TERRAIN DRAWS : %d", g_state.gfx.num_terrain_draws );
+	Font_DrawBitmapString( g_fonts[ FONT_SMALL ], 20, y += 15, 0, 1.f, PL_COLOUR_WHITE, stat );
+	snprintf( stat, sizeof( stat ), "TERRAIN BUFFER: %uKB",
+			  static_cast<unsigned int>( plBytesToKilobytes( g_state.gfx.terrain_buffer_bytes ) ) );
+	Font_DrawBitmapString( g_fonts[ FONT_SMALL ], 20, y += 15, 0, 1.f, PL_COLOUR_WHITE, stat );
+	snprintf( stat, sizeof( stat ), "ACTORS DRAWN  : %d", g_state.gfx.num_actors_drawn );
+	Font_DrawBitmapString( g_fonts[ FONT_SMALL ], 20, y += 15, 0, 1.f, PL_COLOUR_WHITE, stat );
+}
+
 static void DrawDebugOverlay() {
 	if ( cv_debug_mode->i_value <= 0 ) {
 		return;
@@ -413,15 +435,7 @@ static void DrawDebugOverlay() {
 	DrawDisplayInfo();
 	DrawCameraInfoOverlay();
 
-#if 0
-	Font_DrawBitmapString(g_fonts[FONT_CHARS2], 20, 24, 2, 1.f, PL_COLOUR_WHITE, "DRAW STATS");
-	unsigned int y = 50;
-	char cam_pos[32];
-	snprintf(cam_pos, sizeof(cam_pos), "CHUNKS DRAWN : %d", g_state.gfx.num_chunks_drawn);
-	Font_DrawBitmapString(g_fonts[FONT_SMALL], 20, y, 0, 1.f, PL_COLOUR_WHITE, cam_pos);
-	snprintf(cam_pos, sizeof(cam_pos), "ACTORS DRAWN : %d", g_state.gfx.num_actors_drawn);
-	Font_DrawBitmapString(g_fonts[FONT_SMALL], 20, y += 15, 0, 1.f, PL_COLOUR_WHITE, cam_pos);
-#endif
+	DrawStatsOverlay();
 
 	if ( cv_debug_input->i_value > 0 ) {
 		switch ( cv_debug_input->i_value ) {
@@ -0,0 +1,144 @@
+/* OpenHoW
+ * Copyright (C) 2017-2020 Mark Sowden <markelswo@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#if defined( __SSE2__ ) || defined( _M_X64 )
+#   include <emmintrin.h>
+#   define MIPMAP_SIMD_SSE2
+#endif
+
+#include "../engine.h"
+
+#include "mipmap.h"
+
+unsigned int Mipmap_GetNumLevels( unsigned int width, unsigned int height ) {
+	unsigned int size = std::max( width, height );
+	unsigned int levels = 1;
+	while ( size > 1 ) {
+		size >>= 1;
+		levels++;
+	}
+
+	return levels;
+}
+
+static void DownsamplePixel( const uint8_t *src, unsigned int src_width, unsigned int src_height, unsigned int src_stride,
+							 unsigned int x, unsigned int y, uint8_t *out ) {
+	unsigned int x0 = std::min( x * 2, src_width - 1 ), x1 = std::min( x * 2 + 1, src_width - 1 );
+	unsigned int y0 = std::min( y * 2, src_height - 1 ), y1 = std::min( y * 2 + 1, src_height - 1 );
+	const uint8_t *a = src + ( x0 + y0 * src_stride ) * 4;
+	const uint8_t *b = src + ( x1 + y0 * src_stride ) * 4;
+	const uint8_t *c = src + ( x0 + y1 * src_stride ) * 4;
+	const uint8_t *d = src + ( x1 + y1 * src_stride ) * 4;
+	for ( unsigned int i = 0; i < 4; ++i ) {
+		out[ i ] = static_cast<uint8_t>(( a[ i ] + b[ i ] + c[ i ] + d[ i ] + 2 ) >> 2);
+	}
+}
+
+void Mipmap_Downsample( const uint8_t *src, unsigned int src_width, unsigned int src_height, unsigned int src_stride,
+						uint8_t *dst, unsigned int dst_width, unsigned int dst_height, unsigned int dst_stride ) {
+	for ( unsigned int y = 0; y < dst_height; ++y ) {
+		uint8_t *out = dst + y * dst_stride * 4;
+		unsigned int x = 0;
+
+#if defined( MIPMAP_SIMD_SSE2 )
+		// two pixels out of each pair of rows at a time, so long as the whole block is within the source
+		if ( y * 2 + 1 < src_height ) {
+			const uint8_t *row0 = src + ( y * 2 ) * src_stride * 4;
+			const uint8_t *row1 = row0 + src_stride * 4;
+			const __m128i zero = _mm_setzero_si128();
+			const __m128i round = _mm_set1_epi16( 2 );
+			for ( ; x + 1 < dst_width && x * 2 + 3 < src_width; x += 2 ) {
+				__m128i top = _mm_loadu_si128( reinterpret_cast<const __m128i *>( row0 + x * 8 ) );
+				__m128i bottom = _mm_loadu_si128( reinterpret_cast<const __m128i *>( row1 + x * 8 ) );
+				// columns 0 and 1, then 2 and 3, summed down the rows
+				__m128i left = _mm_add_epi16( _mm_unpacklo_epi8( top, zero ), _mm_unpacklo_epi8( bottom, zero ) );
+				__m128i right = _mm_add_epi16( _mm_unpackhi_epi8( top, zero ), _mm_unpackhi_epi8( bottom, zero ) );
+				left = _mm_add_epi16( left, _mm_srli_si128( left, 8 ) );
+				right = _mm_add_epi16( right, _mm_srli_si128( right, 8 ) );
+				__m128i sum = _mm_srli_epi16( _mm_add_epi16( _mm_unpacklo_epi64( left, right ), round ), 2 );
+				_mm_storel_epi64( reinterpret_cast<__m128i *>( out + x * 4 ), _mm_packus_epi16( sum, zero ) );
+			}
+		}
+#endif
+
+		for ( ; x < dst_width; ++x ) {
+			DownsamplePixel( src, src_width, src_height, src_stride, x, y, out + x * 4 );
+		}
+	}
+}
+
+void Mipmap_Extrude( uint8_t *pixels, unsigned int stride,
+					 unsigned int x, unsigned int y, unsigned int width, unsigned int height,
+					 unsigned int slot_x, unsigned int slot_y, unsigned int slot_width, unsigned int slot_height ) {
+	for ( unsigned int sy = slot_y; sy < slot_y + slot_height; ++sy ) {
+		unsigned int iy = std::min( std::max( sy, y ), y + height - 1 );
+		uint8_t *row = pixels + sy * stride * 4;
+		const uint8_t *src_row = pixels + iy * stride * 4;
+		for ( unsigned int sx = slot_x; sx < slot_x + slot_width; ++sx ) {
+			// the image itself is left alone
+			if ( sy == iy && sx == x ) {
+				sx += width - 1;
+				continue;
+			}
+
+			unsigned int ix = std::min( std::max( sx, x ), x + width - 1 );
+			memcpy( row + sx * 4, src_row + ix * 4, 4 );
+		}
+	}
+}
+
+void Mipmap_GenerateAtlas( uint8_t **levels, unsigned int num_levels, unsigned int width, unsigned int height,
+						   const std::vector<MipmapRegion> &regions, unsigned int gutter ) {
+	// the slots only line up exactly with the texels of the levels they're aligned to
+	unsigned int region_levels = 0;
+	while ( ( 2u << region_levels ) <= gutter ) {
+		region_levels++;
+	}
+
+	for ( const auto &region : regions ) {
+		Mipmap_Extrude( levels[ 0 ], width, region.x, region.y, region.width, region.height,
+						region.slot_x, region.slot_y, region.slot_width, region.slot_height );
+	}
+
+	for ( unsigned int level = 1; level < num_levels; ++level ) {
+		unsigned int src_width = std::max( width >> ( level - 1 ), 1u );
+		unsigned int src_height = std::max( height >> ( level - 1 ), 1u );
+		unsigned int dst_width = std::max( width >> level, 1u );
+		unsigned int dst_height = std::max( height >> level, 1u );
+		if ( level > region_levels ) {
+			Mipmap_Downsample( levels[ level - 1 ], src_width, src_height, src_width,
+							   levels[ level ], dst_width, dst_height, dst_width );
+			continue;
+		}
+
+		for ( const auto &region : regions ) {
+			unsigned int src_x = region.x >> ( level - 1 ), src_y = region.y >> ( level - 1 );
+			unsigned int src_region_width = ( region.width + ( 1u << ( level - 1 ) ) - 1 ) >> ( level - 1 );
+			unsigned int src_region_height = ( region.height + ( 1u << ( level - 1 ) ) - 1 ) >> ( level - 1 );
+			unsigned int dst_x = region.x >> level, dst_y = region.y >> level;
+			unsigned int dst_region_width = ( region.width + ( 1u << level ) - 1 ) >> level;
+			unsigned int dst_region_height = ( region.height + ( 1u << level ) - 1 ) >> level;
+			Mipmap_Downsample( levels[ level - 1 ] + ( src_x + src_y * src_width ) * 4,
+							   src_region_width, src_region_height, src_width,
+							   levels[ level ] + ( dst_x + dst_y * dst_width ) * 4,
+							   dst_region_width, dst_region_height, dst_width );
+			Mipmap_Extrude( levels[ level ], dst_width, dst_x, dst_y, dst_region_width, dst_region_height,
+							region.slot_x >> level, region.slot_y >> level,
+							region.slot_width >> level, region.slot_height >> level );
+		}
+	}
+}
@@ -0,0 +1,48 @@
+/* OpenHoW
+ * Copyright (C) 2017-2020 Mark Sowden <markelswo@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+/* Everything here works on plain RGBA8 pixel buffers, with no graphics
+ * state involved, so it's safe to run from any thread. Strides are in pixels. */
+
+// Number of levels in a full mip chain for an image of the given size, down to 1x1
+unsigned int Mipmap_GetNumLevels(unsigned int width, unsigned int height);
+
+// Fills each destination pixel with the average of the 2x2 block beneath it in the
+// source, repeating the last row or column of the source for any block that runs off it
+void Mipmap_Downsample(const uint8_t *src, unsigned int src_width, unsigned int src_height, unsigned int src_stride,
+                       uint8_t *dst, unsigned int dst_width, unsigned int dst_height, unsigned int dst_stride);
+
+// Copies the outermost pixels of the image at x, y out across the rest of the slot around it
+void Mipmap_Extrude(uint8_t *pixels, unsigned int stride,
+                    unsigned int x, unsigned int y, unsigned int width, unsigned int height,
+                    unsigned int slot_x, unsigned int slot_y, unsigned int slot_width, unsigned int slot_height);
+
+/* an image within an atlas, along with the slot around it which its gutter fills */
+struct MipmapRegion {
+  unsigned int x, y, width, height;
+  unsigned int slot_x, slot_y, slot_width, slot_height;
+};
+
+// Fills in the gutters and every level after the first for an atlas of the given size,
+// whose first level already holds its images. Each image is filtered on its own, with its
+// edges extruded across its slot, for as long as its gutter lasts; after that, the whole
+// level is filtered at once. The gutter must be a power of two, with every slot and the
+// atlas aligned to it.
+void Mipmap_GenerateAtlas(uint8_t **levels, unsigned int num_levels, unsigned int width, unsigned int height,
+                          const std::vector<MipmapRegion> &regions, unsigned int gutter);
@@ -15,110 +15,414 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <chrono>
+#include <climits>
+
+#include <sys/stat.h>
+
 #include "../engine.h"
 
+#include "../job_pool.h"
+#include "../../shared/dxt.h"
+
 #include "display.h"
+#include "mipmap.h"
 #include "texture_atlas.h"
 
 using namespace openhow;
 
-TextureAtlas::TextureAtlas( int w, int h ) : width_( w ), height_( h ) {
+static PLImage *DecodeImage( const char *path ) {
+	auto *img = static_cast<PLImage *>(u_alloc( 1, sizeof( PLImage ), true ));
+	if ( !plLoadImage( path, img ) ) {
+		u_free( img );
+		return nullptr;
+	}
+
+	plConvertPixelFormat( img, PL_IMAGEFORMAT_RGBA8 );
+	return img;
+}
+
+TextureAtlas::TextureAtlas( int w, int h, Packer packer, bool power_of_two, unsigned int gutter ) :
+	width_( w ), height_( h ), packer_( packer ), power_of_two_( power_of_two ), gutter_( gutter ) {
+	u_assert( ( gutter_ & ( gutter_ - 1 ) ) == 0, "Texture atlas gutter must be a power of two!\n" );
 	texture_ = Engine::Resource()->GetFallbackTexture();
 }
 
 TextureAtlas::~TextureAtlas() {
-	for ( auto &id : images_by_name_ ) {
-		PLImage *image = id.second;
-		plDestroyImage( image );
-		id.second = nullptr;
-	}
-
 	if ( texture_ != Engine::Resource()->GetFallbackTexture() ) {
 		// TODO: reintroduce once we have a wrapper around PLModel to hold this!
 		//plDestroyTexture(texture_);
 	}
 }
 
+/**
+ * Only finds the image, it's not actually loaded until the atlas is
+ * finalized, and not at all if the atlas can be loaded from the cache.
+ */
 bool TextureAtlas::AddImage( const std::string &path, bool absolute ) {
-	const auto image = images_by_name_.find( path );
-	if ( image != images_by_name_.end() ) {
+	if ( added_.find( path ) != added_.end() ) {
 		return true;
 	}
 
-	char full_path[PL_SYSTEM_MAX_PATH];
+	std::string full_path;
 	if ( absolute ) {
-		strncpy( full_path, path.c_str(), sizeof( full_path ) - 1 );
+		if ( !plFileExists( path.c_str() ) ) {
+			return false;
+		}
+		full_path = path;
 	} else {
-		snprintf( full_path, sizeof( full_path ) - 1, "%s", u_find2( path.c_str(), supported_image_formats, false ) );
+		const char *found = u_find2( path.c_str(), supported_image_formats, false );
+		if ( found == nullptr ) {
+			return false;
+		}
+		full_path = found;
 	}
 
-	auto *img = static_cast<PLImage *>(u_alloc( 1, sizeof( PLImage ), true ));
-	if ( !plLoadImage( full_path, img ) ) {
-		u_free( img );
-		return false;
+	added_.insert( path );
+	paths_.push_back( full_path );
+	return true;
+}
+
+unsigned int TextureAtlas::AddImages( const std::vector<std::string> &paths, bool absolute ) {
+	unsigned int num_added = 0;
+	for ( const auto &path : paths ) {
+		if ( !AddImage( path, absolute ) ) {
+			break;
+		}
+		num_added++;
 	}
 
-	plConvertPixelFormat( img, PL_IMAGEFORMAT_RGBA8 );
-	images_by_name_.emplace( path, img );
-	images_by_height_.emplace( img->height, img );
-	return true;
+	return num_added;
+}
+
+/**
+ * Keyed on everything that goes into building the atlas: the images,
+ * along with their sizes and modification times, and how they're packed.
+ */
+uint64_t TextureAtlas::GetCacheKey( bool compressed ) {
+	uint64_t key = U_HASH_SEED;
+	auto hash = [ &key ]( const void *data, size_t size ) {
+		key = u_hash( data, size, key );
+	};
+
+	uint32_t options[] = { TEXTURE_ATLAS_CACHE_VERSION, static_cast<uint32_t>(width_), static_cast<uint32_t>(height_),
+						   packer_, power_of_two_, gutter_, compressed };
+	hash( options, sizeof( options ) );
+	for ( const auto &path : paths_ ) {
+		hash( path.c_str(), path.size() + 1 );
+
+		struct stat attributes{};
+		if ( stat( path.c_str(), &attributes ) != 0 ) {
+			return 0;
+		}
+		int64_t stamp[] = { static_cast<int64_t>(attributes.st_size), static_cast<int64_t>(attributes.st_mtime) };
+		hash( stamp, sizeof( stamp ) );
+	}
+
+	return ( key != 0 ) ? key : 1;
 }
 
-void TextureAtlas::AddImages( const std::vector<std::string> &textures ) {
-	for ( const auto &path : textures ) {
-		AddImage( path );
+static std::string GetAtlasCachePath( uint64_t key ) {
+	std::string path = Engine::GetCacheDirectory( "atlases/" );
+	if ( path.empty() ) {
+		return "";
 	}
+
+	char name[32];
+	snprintf( name, sizeof( name ), "%016llx.atlas", static_cast<unsigned long long>(key) );
+	return path + name;
+}
+
+namespace {
+struct AtlasCacheHeader {
+	char magic[4];
+	uint32_t version;
+	uint64_t key;
+	uint32_t width, height;
+	uint32_t num_levels;
+	uint32_t num_textures;
+	uint32_t format; // DxtFormat, or zero if uncompressed
+};
+
+struct AtlasCacheIndex {
+	char name[64];
+	uint32_t x, y, w, h;
+};
+}
+
+static DxtFormat GetDxtFormat( const PLImage *image ) {
+	switch ( image->format ) {
+		case PL_IMAGEFORMAT_RGBA_DXT1: return DXT_FORMAT_BC1;
+		case PL_IMAGEFORMAT_RGBA_DXT5: return DXT_FORMAT_BC3;
+		default: return static_cast<DxtFormat>(0);
+	}
+}
+
+static size_t GetLevelSize( DxtFormat format, unsigned int width, unsigned int height, unsigned int level ) {
+	width = std::max( width >> level, 1u );
+	height = std::max( height >> level, 1u );
+	return ( format != 0 ) ? Dxt_GetLevelSize( format, width, height ) : width * height * 4;
+}
+
+/**
+ * Encodes every level of the atlas in place, as BC1 where nothing is partially
+ * transparent and otherwise BC3. With gutters of at least the block size, no
+ * block takes in pixels from two images until the smallest few levels.
+ */
+static void CompressImage( PLImage *image ) {
+	auto start = std::chrono::steady_clock::now();
+
+	DxtFormat format = Dxt_GetBestFormat( image->data[ 0 ], image->width, image->height );
+	for ( unsigned int i = 0; i < image->levels; ++i ) {
+		unsigned int w = std::max( image->width >> i, 1u ), h = std::max( image->height >> i, 1u );
+		auto *blocks = static_cast<uint8_t *>(u_alloc( GetLevelSize( format, image->width, image->height, i ), 1, true ));
+		Dxt_EncodeImage( format, image->data[ i ], w, h, blocks );
+		u_free( image->data[ i ] );
+		image->data[ i ] = blocks;
+	}
+
+	image->format = ( format == DXT_FORMAT_BC1 ) ? PL_IMAGEFORMAT_RGBA_DXT1 : PL_IMAGEFORMAT_RGBA_DXT5;
+	image->size = Dxt_GetLevelSize( format, image->width, image->height );
+
+	LogDebug( "Compressed %ux%u atlas as %s in %.2fms\n", image->width, image->height,
+			  ( format == DXT_FORMAT_BC1 ) ? "BC1" : "BC3",
+			  std::chrono::duration<double, std::milli>( std::chrono::steady_clock::now() - start ).count() );
+}
+
+void TextureAtlas::WriteCache( const std::string &path, uint64_t key, const PLImage *image ) {
+	for ( const auto &handle : handles_ ) {
+		if ( handle.first.size() >= sizeof( AtlasCacheIndex::name ) ) {
+			LogDebug( "Texture name \"%s\" is too long for the atlas cache, not writing \"%s\"\n",
+					  handle.first.c_str(), path.c_str() );
+			return;
+		}
+	}
+
+	FILE *fp = fopen( path.c_str(), "wb" );
+	if ( fp == nullptr ) {
+		LogWarn( "Failed to write atlas cache to \"%s\"!\n", path.c_str() );
+		return;
+	}
+
+	bool status = true;
+	auto write = [ fp, &status ]( const void *data, size_t size ) {
+		status = status && ( fwrite( data, 1, size, fp ) == size );
+	};
+
+	AtlasCacheHeader header{};
+	memcpy( header.magic, "HATL", sizeof( header.magic ) );
+	header.version = TEXTURE_ATLAS_CACHE_VERSION;
+	header.key = key;
+	header.width = image->width;
+	header.height = image->height;
+	header.num_levels = image->levels;
+	header.num_textures = static_cast<uint32_t>(textures_.size());
+	header.format = GetDxtFormat( image );
+	write( &header, sizeof( header ) );
+
+	// the handles are just the order the textures are in
+	std::vector<std::string> names( textures_.size() );
+	for ( const auto &handle : handles_ ) {
+		names[ handle.second ] = handle.first;
+	}
+	for ( unsigned int i = 0; i < textures_.size(); ++i ) {
+		AtlasCacheIndex index{};
+		strncpy( index.name, names[ i ].c_str(), sizeof( index.name ) - 1 );
+		index.x = textures_[ i ].x;
+		index.y = textures_[ i ].y;
+		index.w = textures_[ i ].w;
+		index.h = textures_[ i ].h;
+		write( &index, sizeof( index ) );
+	}
+
+	for ( unsigned int i = 0; i < image->levels; ++i ) {
+		write( image->data[ i ], GetLevelSize( static_cast<DxtFormat>(header.format), image->width, image->height, i ) );
+	}
+
+	fclose( fp );
+
+	if ( !status ) {
+		LogWarn( "Failed to write atlas cache to \"%s\"!\n", path.c_str() );
+		remove( path.c_str() );
+	}
+}
+
+/**
+ * Returns the atlas image held in the cache, filling in the textures as they
+ * were when it was written, or null if it's missing or doesn't match the key.
+ */
+PLImage *TextureAtlas::ReadCache( const std::string &path, uint64_t key ) {
+	FILE *fp = fopen( path.c_str(), "rb" );
+	if ( fp == nullptr ) {
+		return nullptr;
+	}
+
+	bool status = true;
+	auto read = [ fp, &status ]( void *data, size_t size ) {
+		status = status && ( fread( data, 1, size, fp ) == size );
+	};
+
+	AtlasCacheHeader header{};
+	read( &header, sizeof( header ) );
+	if ( !status || memcmp( header.magic, "HATL", sizeof( header.magic ) ) != 0 ||
+		header.version != TEXTURE_ATLAS_CACHE_VERSION || header.key != key ||
+		header.width == 0 || header.height == 0 || header.num_levels != Mipmap_GetNumLevels( header.width, header.height ) ||
+		( header.format != 0 && header.format != DXT_FORMAT_BC1 && header.format != DXT_FORMAT_BC3 ) ) {
+		fclose( fp );
+		LogInfo( "Atlas cache \"%s\" is out of date, ignoring\n", path.c_str() );
+		return nullptr;
+	}
+
+	std::vector<AtlasCacheIndex> indices( header.num_textures );
+	read( indices.data(), indices.size() * sizeof( AtlasCacheIndex ) );
+
+	PLImage *image = plCreateImage( nullptr, header.width, header.height, PL_COLOURFORMAT_RGBA, PL_IMAGEFORMAT_RGBA8 );
+	if ( image == nullptr ) {
+		fclose( fp );
+		return nullptr;
+	}
+
+	auto format = static_cast<DxtFormat>(header.format);
+	if ( format != 0 ) {
+		image->format = ( format == DXT_FORMAT_BC1 ) ? PL_IMAGEFORMAT_RGBA_DXT1 : PL_IMAGEFORMAT_RGBA_DXT5;
+		image->size = Dxt_GetLevelSize( format, header.width, header.height );
+	}
+
+	image->levels = header.num_levels;
+	image->data = ( uint8_t ** ) u_alloc( image->levels, sizeof( uint8_t * ), true );
+	for ( unsigned int i = 0; i < image->levels; ++i ) {
+		size_t level_size = GetLevelSize( format, header.width, header.height, i );
+		image->data[ i ] = ( uint8_t * ) u_alloc( level_size, sizeof( uint8_t ), true );
+		read( image->data[ i ], level_size );
+	}
+	fclose( fp );
+
+	if ( !status ) {
+		LogWarn( "Atlas cache \"%s\" is truncated, ignoring!\n", path.c_str() );
+		plDestroyImage( image );
+		return nullptr;
+	}
+
+	for ( const auto &index : indices ) {
+		handles_.emplace( std::string( index.name, strnlen( index.name, sizeof( index.name ) ) ),
+						  static_cast<int>(textures_.size()) );
+		textures_.push_back( Index{
+			.x = index.x,
+			.y = index.y,
+			.w = index.w,
+			.h = index.h,
+			.image = nullptr
+		} );
+	}
+
+	return image;
 }
 
 void TextureAtlas::Finalize() {
-	if ( images_by_height_.empty() ) {
+	if ( paths_.empty() ) {
 		LogWarn( "Failed to finalize texture atlas, no textures loaded!\n" );
 		return;
 	}
 
-	// Figure out how we'll organise the atlas
-	unsigned int w = width_, h = height_;
-	unsigned int max_h = 0;
-	unsigned int cur_y = 0, cur_x = 0;
-	for ( auto i = images_by_height_.rbegin(); i != images_by_height_.rend(); ++i ) {
-		PLImage *image = i->second;
-		if ( image->height > max_h ) {
-			max_h = image->height;
-		}
+	auto start = std::chrono::steady_clock::now();
+
+	// if nothing has changed since it was last built, just use that
+	// the atlas is only compressed where it can be uploaded as is, so each way is cached separately
+	bool compressed = cv_graphics_texture_compression->b_value && ResourceManager::IsTextureCompressionSupported();
+	uint64_t key = GetCacheKey( compressed );
+	std::string cache_path = ( key != 0 ) ? GetAtlasCachePath( key ) : "";
+	PLImage *cached = cache_path.empty() ? nullptr : ReadCache( cache_path, key );
+	if ( cached != nullptr ) {
+		paths_.clear();
+		added_.clear();
+		Upload( cached );
+		plDestroyImage( cached );
+
+		LogDebug( "Read atlas cache \"%s\" in %.2fms\n", cache_path.c_str(),
+				  std::chrono::duration<double, std::milli>( std::chrono::steady_clock::now() - start ).count() );
+		return;
+	}
 
-		if ( cur_x == 0 && image->width > w ) {
-			w = image->width;
-		} else if ( cur_x + image->width > w ) {
-			cur_y += max_h;
-			cur_x = max_h = 0;
+	// every image is independent, so they're decoded across the job pool
+	std::vector<PLImage *> images( paths_.size(), nullptr );
+	auto decode_image = [ this, &images ]( unsigned int i ) {
+		images[ i ] = DecodeImage( paths_[ i ].c_str() );
+	};
+
+	JobPool *jobs = Engine::Jobs();
+	if ( jobs != nullptr ) {
+		jobs->ParallelFor( images.size(), decode_image );
+	} else {
+		for ( unsigned int i = 0; i < images.size(); ++i ) {
+			decode_image( i );
 		}
+	}
 
-		if ( cur_y + image->height > h ) {
-			h = cur_y + image->height;
+	std::multimap<unsigned int, PLImage *> images_by_height;
+	for ( unsigned int i = 0; i < images.size(); ++i ) {
+		if ( images[ i ] == nullptr ) {
+			LogWarn( "Failed to load \"%s\" for texture atlas!\n%s\n", paths_[ i ].c_str(), plGetError() );
+			continue;
 		}
 
+		images_by_height.emplace( images[ i ]->height, images[ i ] );
+	}
+	paths_.clear();
+	added_.clear();
+
+	if ( images_by_height.empty() ) {
+		LogWarn( "Failed to finalize texture atlas, no textures loaded!\n" );
+		return;
+	}
+
+	// Tallest first, which is what both packers work best with
+	for ( auto i = images_by_height.rbegin(); i != images_by_height.rend(); ++i ) {
+		PLImage *image = i->second;
 		u_assert( image->path[ 0 ] != '\0', "Invalid image name!" );
 		const char *filename = plGetFileName( image->path );
 		const char *extension = plGetFileExtension( image->path );
 		std::string index_name = std::string( filename ).substr( 0, strlen( filename ) - ( strlen( extension ) + 1 ) );
-		textures_.emplace( index_name, Index{
-			.x = cur_x,
-			.y = cur_y,
+		handles_.emplace( index_name, static_cast<int>(textures_.size()) );
+		textures_.push_back( Index{
+			.x = 0,
+			.y = 0,
 			.w = image->width,
 			.h = image->height,
 			.image = image
 		} );
-
-		cur_x += image->width;
 	}
 
-	// Ensure power of two for final atlas
-	h = static_cast<unsigned int>(pow( 2, ceil( log( h ) / log( 2 ) ) ));
-	w = static_cast<unsigned int>(pow( 2, ceil( log( w ) / log( 2 ) ) ));
+	// Figure out how we'll organise the atlas, packing the slots each image and its gutter sits in;
+	// these are aligned to the gutter so that they still line up with the texels further down the mips
+	unsigned int align = std::max( gutter_, 1u );
+	auto align_size = [ align ]( unsigned int size ) {
+		return ( size + align - 1 ) & ~( align - 1 );
+	};
+	std::vector<Index> slots( textures_ );
+	for ( auto &slot : slots ) {
+		slot.w = align_size( slot.w + gutter_ * 2 );
+		slot.h = align_size( slot.h + gutter_ * 2 );
+	}
+	std::pair<unsigned int, unsigned int> size = Pack( packer_, slots, width_, height_, power_of_two_ );
+	unsigned int w = align_size( size.first ), h = align_size( size.second );
+
+	std::vector<MipmapRegion> regions( textures_.size() );
+	for ( unsigned int i = 0; i < textures_.size(); ++i ) {
+		textures_[ i ].x = slots[ i ].x + gutter_;
+		textures_[ i ].y = slots[ i ].y + gutter_;
+		regions[ i ] = MipmapRegion{
+			textures_[ i ].x, textures_[ i ].y, textures_[ i ].w, textures_[ i ].h,
+			slots[ i ].x, slots[ i ].y, slots[ i ].w, slots[ i ].h
+		};
+	}
 
-	// Image pointers will be freed when we're done with textures list
-	images_by_name_.clear();
-	images_by_height_.clear();
+	unsigned int used = 0;
+	for ( const auto &texture : textures_ ) {
+		used += texture.w * texture.h;
+	}
+	LogDebug( "Packed %u images into %ux%u atlas, %.1f%% used (%ukb wasted)\n",
+			  static_cast<unsigned int>(textures_.size()), w, h, ( used * 100.0 ) / ( w * h ),
+			  static_cast<unsigned int>( plBytesToKilobytes( ( w * h - used ) * 4 ) ) );
 
 	// Now create the atlas itself
 	PLImage *cache = plCreateImage( nullptr, w, h, PL_COLOURFORMAT_RGBA, PL_IMAGEFORMAT_RGBA8 );
@@ -126,14 +430,17 @@ void TextureAtlas::Finalize() {
 		Error( "Failed to generate image cache for texture atlas (%s)!\n", plGetError() );
 	}
 
-	// todo: generate mipmap levels
+	cache->levels = Mipmap_GetNumLevels( w, h );
 	cache->data = ( uint8_t ** ) u_alloc( cache->levels, sizeof( uint8_t * ), true );
-	cache->data[ 0 ] = ( uint8_t * ) u_alloc( cache->size, sizeof( uint8_t ), true );
+	for ( unsigned int i = 0; i < cache->levels; ++i ) {
+		unsigned int level_size = std::max( w >> i, 1u ) * std::max( h >> i, 1u ) * 4;
+		cache->data[ i ] = ( uint8_t * ) u_alloc( level_size, sizeof( uint8_t ), true );
+	}
 
 	//plReplaceImageColour(cache, {0, 0, 0, 0}, {0, 0, 0, 255});
 
 	for ( auto &tarr : textures_ ) {
-		Index *texture = &tarr.second;
+		Index *texture = &tarr;
 		uint8_t *pos = cache->data[ 0 ] + ( ( texture->y * cache->width ) + texture->x ) * 4;
 		uint8_t *src = texture->image->data[ 0 ];
 		for ( unsigned int y = 0; y < texture->h; ++y ) {
@@ -146,6 +453,11 @@ void TextureAtlas::Finalize() {
 		texture->image = nullptr;
 	}
 
+	auto mip_start = std::chrono::steady_clock::now();
+	Mipmap_GenerateAtlas( cache->data, cache->levels, w, h, regions, gutter_ );
+	LogDebug( "Generated %u atlas mip levels in %.2fms\n", cache->levels,
+			  std::chrono::duration<double, std::milli>( std::chrono::steady_clock::now() - mip_start ).count() );
+
 #ifdef _DEBUG
 	static unsigned int gen_id = 0;
 	if ( plCreatePath( "./debug/generated/" ) ) {
@@ -156,45 +468,276 @@ void TextureAtlas::Finalize() {
 	}
 #endif
 
+	if ( compressed ) {
+		CompressImage( cache );
+	}
+
+	if ( !cache_path.empty() ) {
+		WriteCache( cache_path, key, cache );
+	}
+
+	Upload( cache );
+	plFreeImage( cache );
+
+	LogDebug( "Built texture atlas in %.2fms\n",
+			  std::chrono::duration<double, std::milli>( std::chrono::steady_clock::now() - start ).count() );
+}
+
+void TextureAtlas::Upload( PLImage *image ) {
 	if ( ( texture_ = plCreateTexture() ) == nullptr ) {
 		Error( "Failed to generate atlas texture (%s)!\n", plGetError() );
 	}
 
 	texture_->filter = cv_graphics_texture_filter->b_value ?
 					   PL_TEXTURE_FILTER_MIPMAP_LINEAR : PL_TEXTURE_FILTER_MIPMAP_NEAREST_LINEAR;
-	if ( !plUploadTextureImage( texture_, cache ) ) {
+	if ( !plUploadTextureImage( texture_, image ) ) {
 		Error( "Failed to upload texture atlas (%s)!\n", plGetError() );
 	}
+}
 
-	plFreeImage( cache );
+std::pair<unsigned int, unsigned int> TextureAtlas::Pack( Packer packer, std::vector<Index> &textures,
+															 unsigned int min_w, unsigned int min_h, bool power_of_two ) {
+	std::pair<unsigned int, unsigned int> size = ( packer == PACKER_SKYLINE ) ?
+												 PackSkyline( textures, min_w, min_h ) :
+												 PackShelf( textures, min_w, min_h );
+	if ( power_of_two ) {
+		size.first = static_cast<unsigned int>(pow( 2, ceil( log( size.first ) / log( 2 ) ) ));
+		size.second = static_cast<unsigned int>(pow( 2, ceil( log( size.second ) / log( 2 ) ) ));
+	}
+
+	return size;
 }
 
-bool TextureAtlas::GetTextureCoords( const std::string &name, float *x, float *y, float *w, float *h ) {
-	auto index = textures_.find( name );
-	if ( index == textures_.end() ) {
+/**
+ * Lays the images out left to right in rows, starting a new row
+ * below the tallest image of the last once the current is full.
+ */
+std::pair<unsigned int, unsigned int> TextureAtlas::PackShelf( std::vector<Index> &textures,
+																  unsigned int min_w, unsigned int min_h ) {
+	unsigned int w = min_w, h = min_h;
+	unsigned int max_h = 0;
+	unsigned int cur_y = 0, cur_x = 0;
+	for ( auto &texture : textures ) {
+		if ( cur_x > 0 && cur_x + texture.w > w ) {
+			cur_y += max_h;
+			cur_x = max_h = 0;
+		}
+
+		// widen the atlas for anything that wouldn't otherwise fit
+		if ( texture.w > w ) {
+			w = texture.w;
+		}
+
+		if ( texture.h > max_h ) {
+			max_h = texture.h;
+		}
+
+		if ( cur_y + texture.h > h ) {
+			h = cur_y + texture.h;
+		}
+
+		texture.x = cur_x;
+		texture.y = cur_y;
+		cur_x += texture.w;
+	}
+
+	return std::make_pair( w, h );
+}
+
+/**
+ * Keeps track of the top edge of everything placed so far, dropping each image
+ * in at the lowest point along it that it fits, so that shorter images fill in
+ * the space beside taller ones rather than leaving a gap to the end of the row.
+ */
+std::pair<unsigned int, unsigned int> TextureAtlas::PackSkyline( std::vector<Index> &textures,
+																	unsigned int min_w, unsigned int min_h ) {
+	unsigned int w = min_w, h = min_h;
+	for ( const auto &texture : textures ) {
+		w = std::max( w, texture.w );
+	}
+
+	struct Node {
+		unsigned int x, y, w;
+	};
+	std::vector<Node> skyline;
+	skyline.push_back( Node{ 0, 0, w } );
+
+	for ( auto &texture : textures ) {
+		// lowest spot the image fits, leftmost if there's a tie
+		size_t best = 0;
+		unsigned int best_y = UINT_MAX;
+		for ( size_t i = 0; i < skyline.size() && skyline[ i ].x + texture.w <= w; ++i ) {
+			unsigned int y = 0;
+			for ( size_t j = i; j < skyline.size() && skyline[ j ].x < skyline[ i ].x + texture.w; ++j ) {
+				y = std::max( y, skyline[ j ].y );
+			}
+
+			if ( y < best_y ) {
+				best = i;
+				best_y = y;
+			}
+		}
+
+		texture.x = skyline[ best ].x;
+		texture.y = best_y;
+		h = std::max( h, texture.y + texture.h );
+
+		// raise the skyline over the image, trimming whatever it now covers
+		unsigned int end = texture.x + texture.w;
+		size_t last = best;
+		while ( last < skyline.size() && skyline[ last ].x + skyline[ last ].w <= end ) {
+			last++;
+		}
+		if ( last < skyline.size() && skyline[ last ].x < end ) {
+			skyline[ last ].w -= end - skyline[ last ].x;
+			skyline[ last ].x = end;
+		}
+		skyline.erase( skyline.begin() + best, skyline.begin() + last );
+		skyline.insert( skyline.begin() + best, Node{ texture.x, texture.y + texture.h, texture.w } );
+
+		for ( size_t i = 0; i + 1 < skyline.size(); ) {
+			if ( skyline[ i ].y == skyline[ i + 1 ].y ) {
+				skyline[ i ].w += skyline[ i + 1 ].w;
+				skyline.erase( skyline.begin() + i + 1 );
+			} else {
+				i++;
+			}
+		}
+	}
+
+	return std::make_pair( w, h );
+}
+
+static std::vector<std::string> benchmark_paths;
+static void AddBenchmarkPath( const char *path ) {
+	benchmark_paths.push_back( path );
+}
+
+/**
+ * Packs every image in the given directory, such as a map's tiles or a model's
+ * textures, with each packer both with and without rounding up to a power of
+ * two, comparing the size of the resulting atlas and how long packing takes.
+ * Usage: AtlasBenchmark <directory> [width] [iterations]
+ */
+void TextureAtlas::BenchmarkCommand( unsigned int argc, char **argv ) {
+	if ( argc < 2 ) {
+		LogWarn( "No directory specified, ignoring!\n" );
+		return;
+	}
+
+	unsigned int width = 512;
+	if ( argc > 2 ) {
+		width = strtoul( argv[ 2 ], nullptr, 10 );
+		if ( width == 0 ) {
+			LogWarn( "Invalid width, \"%s\", ignoring!\n", argv[ 2 ] );
+			return;
+		}
+	}
+
+	unsigned int num_iterations = 1000;
+	if ( argc > 3 ) {
+		num_iterations = strtoul( argv[ 3 ], nullptr, 10 );
+		if ( num_iterations == 0 ) {
+			LogWarn( "Invalid number of iterations, \"%s\", ignoring!\n", argv[ 3 ] );
+			return;
+		}
+	}
+
+	benchmark_paths.clear();
+	for ( const char **format = supported_image_formats; *format != nullptr; ++format ) {
+		plScanDirectory( argv[ 1 ], *format, AddBenchmarkPath, false );
+	}
+	std::sort( benchmark_paths.begin(), benchmark_paths.end() );
+
+	// only the sizes matter for packing
+	std::vector<Index> textures;
+	unsigned int used = 0;
+	for ( const auto &path : benchmark_paths ) {
+		PLImage image;
+		if ( !plLoadImage( path.c_str(), &image ) ) {
+			LogWarn( "Failed to load \"%s\", skipping!\n%s\n", path.c_str(), plGetError() );
+			continue;
+		}
+
+		textures.push_back( Index{ 0, 0, image.width, image.height, nullptr } );
+		used += image.width * image.height;
+		plFreeImage( &image );
+	}
+	benchmark_paths.clear();
+
+	if ( textures.empty() ) {
+		LogWarn( "No images found in \"%s\", ignoring!\n", argv[ 1 ] );
+		return;
+	}
+
+	std::stable_sort( textures.begin(), textures.end(), []( const Index &a, const Index &b ) {
+		return a.h > b.h;
+	} );
+
+	LogInfo( "Packing %u images from \"%s\", %ukb of pixels\n",
+			 static_cast<unsigned int>(textures.size()), argv[ 1 ],
+			 static_cast<unsigned int>( plBytesToKilobytes( used * 4 ) ) );
+
+	static const struct {
+		const char *name;
+		Packer packer;
+		bool power_of_two;
+	} configs[] = {
+		{ "shelf, pow2", PACKER_SHELF, true },
+		{ "shelf", PACKER_SHELF, false },
+		{ "skyline, pow2", PACKER_SKYLINE, true },
+		{ "skyline", PACKER_SKYLINE, false },
+	};
+	for ( const auto &config : configs ) {
+		std::pair<unsigned int, unsigned int> size;
+		auto start = std::chrono::steady_clock::now();
+		for ( unsigned int i = 0; i < num_iterations; ++i ) {
+			size = Pack( config.packer, textures, width, 8, config.power_of_two );
+		}
+		double ms = std::chrono::duration<double, std::milli>( std::chrono::steady_clock::now() - start ).count();
+
+		unsigned int total = size.first * size.second;
+		LogInfo( "%-14s %ux%u, %ukb, %.1f%% used, %.3fus per pack\n", config.name, size.first, size.second,
+				 static_cast<unsigned int>( plBytesToKilobytes( total * 4 ) ), ( used * 100.0 ) / total, ( ms * 1000.0 ) / num_iterations );
+	}
+}
+
+int TextureAtlas::GetHandle( const std::string &name ) {
+	auto handle = handles_.find( name );
+	if ( handle == handles_.end() ) {
+		return -1;
+	}
+
+	return handle->second;
+}
+
+bool TextureAtlas::GetTextureCoords( int handle, float *x, float *y, float *w, float *h ) {
+	if ( handle < 0 || static_cast<unsigned int>(handle) >= textures_.size() ) {
 		*x = *y = 0;
 		*w = *h = 1.0f;
 		return false;
 	}
 
-	// HACK: work around texture leaking until we have a better solution!
-	int shift = 0;
-	if ( texture_->filter == PL_TEXTURE_FILTER_MIPMAP_LINEAR ) {
-		shift = 1;
-	}
-
-	*x = static_cast<float>(index->second.x + shift) / static_cast<float>(texture_->w);
-	*y = static_cast<float>(index->second.y + shift) / static_cast<float>(texture_->h);
-	*w = static_cast<float>(index->second.w - shift * 2) / static_cast<float>(texture_->w);
-	*h = static_cast<float>(index->second.h - shift * 2) / static_cast<float>(texture_->h);
+	const Index &index = textures_[ handle ];
+	*x = static_cast<float>(index.x) / static_cast<float>(texture_->w);
+	*y = static_cast<float>(index.y) / static_cast<float>(texture_->h);
+	*w = static_cast<float>(index.w) / static_cast<float>(texture_->w);
+	*h = static_cast<float>(index.h) / static_cast<float>(texture_->h);
 	return true;
 }
 
-std::pair<unsigned int, unsigned int> TextureAtlas::GetTextureSize( const std::string &name ) {
-	auto index = textures_.find( name );
-	if ( index == textures_.end() ) {
+bool TextureAtlas::GetTextureCoords( const std::string &name, float *x, float *y, float *w, float *h ) {
+	return GetTextureCoords( GetHandle( name ), x, y, w, h );
+}
+
+std::pair<unsigned int, unsigned int> TextureAtlas::GetTextureSize( int handle ) {
+	if ( handle < 0 || static_cast<unsigned int>(handle) >= textures_.size() ) {
 		return std::make_pair( texture_->w, texture_->h );
 	}
 
-	return std::make_pair( index->second.w, index->second.h );
+	return std::make_pair( textures_[ handle ].w, textures_[ handle ].h );
+}
+
+std::pair<unsigned int, unsigned int> TextureAtlas::GetTextureSize( const std::string &name ) {
+	return GetTextureSize( GetHandle( name ) );
 }
@@ -17,21 +17,45 @@
 
 #pragma once
 
+#include <map>
+#include <set>
+
+/* bump whenever the layout of the atlas cache changes */
+#define TEXTURE_ATLAS_CACHE_VERSION 2
+
 class TextureAtlas {
  public:
-  TextureAtlas(int w, int h);
+  enum Packer {
+    PACKER_SHELF,   // rows of images sorted by height, fine for images that are all the same size
+    PACKER_SKYLINE, // fills in the gaps left by shorter images, better for mixed sizes
+  };
+
+  // The atlas starts out at w by h, growing as needed to fit everything added to it.
+  // Each image is surrounded by a gutter of its edge pixels, which must be a power of two,
+  // so that it doesn't bleed into its neighbours when filtered or mipmapped.
+  TextureAtlas(int w, int h, Packer packer = PACKER_SHELF, bool power_of_two = true, unsigned int gutter = 4);
   ~TextureAtlas();
 
+  // Handles are only valid once the atlas has been finalized, -1 if the name isn't in it
+  int GetHandle(const std::string &name);
+
+  bool GetTextureCoords(int handle, float *x, float *y, float *w, float *h);
   bool GetTextureCoords(const std::string &name, float *x, float *y, float *w, float *h);
+  std::pair<unsigned int, unsigned int> GetTextureSize(int handle);
   std::pair<unsigned int, unsigned int> GetTextureSize(const std::string &name);
 
   bool AddImage(const std::string &path, bool absolute = false);
-  void AddImages(const std::vector<std::string> &textures);
+  // Adds the images in order up to the first that can't be found, returning how many are now in the atlas
+  unsigned int AddImages(const std::vector<std::string> &paths, bool absolute = false);
 
+  // Loads and packs everything that has been added, unless an identical atlas has been cached.
+  // The atlas is block compressed, along with its mips, wherever the driver supports it.
   void Finalize();
 
   PLTexture *GetTexture() { return texture_; }
 
+  static void BenchmarkCommand(unsigned int argc, char **argv);
+
  protected:
  private:
   struct Index {
@@ -39,12 +63,29 @@ class TextureAtlas {
     PLImage *image;
   };
 
+  // Positions the given images, returning the size of the atlas needed to hold them
+  static std::pair<unsigned int, unsigned int> Pack(Packer packer, std::vector<Index> &textures,
+                                                    unsigned int min_w, unsigned int min_h, bool power_of_two);
+  static std::pair<unsigned int, unsigned int> PackShelf(std::vector<Index> &textures,
+                                                         unsigned int min_w, unsigned int min_h);
+  static std::pair<unsigned int, unsigned int> PackSkyline(std::vector<Index> &textures,
+                                                           unsigned int min_w, unsigned int min_h);
+
+  uint64_t GetCacheKey(bool compressed);
+  void WriteCache(const std::string &path, uint64_t key, const PLImage *image);
+  PLImage *ReadCache(const std::string &path, uint64_t key);
+  void Upload(PLImage *image);
+
   int width_{512};
   int height_{8};
+  Packer packer_{PACKER_SHELF};
+  bool power_of_two_{true};
+  unsigned int gutter_{4};
 
-  std::map<std::string, Index> textures_;
-  std::map<std::string, PLImage *> images_by_name_;
-  std::multimap<unsigned int, PLImage *> images_by_height_;
+  std::vector<Index> textures_;
+  std::map<std::string, int> handles_;
+  std::set<std::string> added_;   // as given to AddImage
+  std::vector<std::string> paths_; // full paths of the images to load, in the order they were added
 
   PLTexture *texture_{nullptr};
 };
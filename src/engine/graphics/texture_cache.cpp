@@ -0,0 +1,290 @@
+/* OpenHoW
+ * Copyright (C) 2017-2020 Mark Sowden <markelswo@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <atomic>
+#include <ctime>
+#include <mutex>
+
+#include <sys/stat.h>
+#if defined( _WIN32 )
+#include <sys/utime.h>
+#else
+#include <utime.h>
+#endif
+
+#include "../engine.h"
+
+#include "texture_cache.h"
+
+namespace {
+struct TextureCacheHeader {
+	char magic[4];
+	uint32_t version;
+	uint64_t key;
+	uint32_t width, height;
+	uint32_t format, colour_format;
+	uint32_t size;
+};
+
+struct TextureCacheEntry {
+	size_t size;
+	time_t last_used;
+};
+}
+
+/* everything that's in the cache directory, which is only
+ * scanned the first time anything looks at the cache */
+static std::mutex cache_mutex;
+static std::map<uint64_t, TextureCacheEntry> cache_entries;
+static size_t cache_size = 0;
+static bool cache_scanned = false;
+
+static const std::string &GetTextureCacheDirectory() {
+	// only worked out once, whichever thread gets here first
+	static const std::string directory = openhow::Engine::GetCacheDirectory( "textures/" );
+	return directory;
+}
+
+static std::string GetCachePath( const std::string &directory, uint64_t key ) {
+	char name[32];
+	snprintf( name, sizeof( name ), "%016llx.tex", static_cast<unsigned long long>(key) );
+	return directory + name;
+}
+
+static void AddCacheEntry( const char *path ) {
+	unsigned long long key;
+	const char *name = strrchr( path, '/' );
+	if ( sscanf( ( name != nullptr ) ? name + 1 : path, "%16llx.tex", &key ) != 1 ) {
+		return;
+	}
+
+	struct stat attributes{};
+	if ( stat( path, &attributes ) != 0 ) {
+		return;
+	}
+
+	TextureCacheEntry entry{ static_cast<size_t>(attributes.st_size), attributes.st_mtime };
+	if ( cache_entries.insert( std::make_pair( static_cast<uint64_t>(key), entry ) ).second ) {
+		cache_size += entry.size;
+	}
+}
+
+// must be called with the mutex held
+static void ScanCache( const std::string &directory ) {
+	if ( cache_scanned ) {
+		return;
+	}
+
+	cache_scanned = true;
+	plScanDirectory( directory.c_str(), "tex", AddCacheEntry, false );
+}
+
+// must be called with the mutex held
+static void RemoveCacheEntry( const std::string &directory, uint64_t key ) {
+	plDeleteFile( GetCachePath( directory, key ).c_str() );
+
+	auto entry = cache_entries.find( key );
+	if ( entry != cache_entries.end() ) {
+		cache_size -= entry->second.size;
+		cache_entries.erase( entry );
+	}
+}
+
+// must be called with the mutex held
+static void TrimCache( const std::string &directory, size_t max_bytes ) {
+	while ( cache_size > max_bytes && !cache_entries.empty() ) {
+		auto oldest = cache_entries.begin();
+		for ( auto i = cache_entries.begin(); i != cache_entries.end(); ++i ) {
+			if ( i->second.last_used < oldest->second.last_used ) {
+				oldest = i;
+			}
+		}
+
+		RemoveCacheEntry( directory, oldest->first );
+	}
+}
+
+uint64_t TextureCache_GetKey( const char *path ) {
+	PLFile *fh = plOpenFile( path, false );
+	if ( fh == nullptr ) {
+		return 0;
+	}
+
+	std::vector<uint8_t> buffer( plGetFileSize( fh ) );
+	size_t length = plReadFile( fh, buffer.data(), sizeof( uint8_t ), buffer.size() );
+	plCloseFile( fh );
+	if ( length != buffer.size() ) {
+		return 0;
+	}
+
+	uint32_t version = TEXTURE_CACHE_VERSION;
+	uint64_t key = u_hash( &version, sizeof( version ), U_HASH_SEED );
+	key = u_hash( buffer.data(), length, key );
+
+	return ( key != 0 ) ? key : 1;
+}
+
+/**
+ * The pixels follow straight on from the header, exactly as they're
+ * uploaded, so they're read directly into place without any conversion.
+ */
+bool TextureCache_Read( uint64_t key, PLImage *image ) {
+	const std::string &directory = GetTextureCacheDirectory();
+	if ( directory.empty() ) {
+		return false;
+	}
+
+	std::string path = GetCachePath( directory, key );
+	FILE *fp = fopen( path.c_str(), "rb" );
+	if ( fp == nullptr ) {
+		return false;
+	}
+
+	TextureCacheHeader header{};
+	if ( fread( &header, sizeof( header ), 1, fp ) != 1 || memcmp( header.magic, "HTXC", sizeof( header.magic ) ) != 0 ||
+		header.version != TEXTURE_CACHE_VERSION || header.key != key || header.size == 0 ) {
+		fclose( fp );
+		LogDebug( "Texture cache \"%s\" is out of date, removing\n", path.c_str() );
+		std::lock_guard<std::mutex> lock( cache_mutex );
+		ScanCache( directory );
+		RemoveCacheEntry( directory, key );
+		return false;
+	}
+
+	memset( image, 0, sizeof( PLImage ) );
+	image->width = header.width;
+	image->height = header.height;
+	image->format = static_cast<PLImageFormat>(header.format);
+	image->colour_format = static_cast<PLColourFormat>(header.colour_format);
+	image->size = header.size;
+	image->levels = 1;
+	image->data = static_cast<uint8_t **>(u_alloc( 1, sizeof( uint8_t * ), true ));
+	image->data[ 0 ] = static_cast<uint8_t *>(u_alloc( header.size, sizeof( uint8_t ), true ));
+	bool status = ( fread( image->data[ 0 ], header.size, 1, fp ) == 1 );
+	fclose( fp );
+
+	std::lock_guard<std::mutex> lock( cache_mutex );
+	ScanCache( directory );
+	if ( !status ) {
+		plFreeImage( image );
+		LogDebug( "Texture cache \"%s\" is truncated, removing\n", path.c_str() );
+		RemoveCacheEntry( directory, key );
+		return false;
+	}
+
+	auto entry = cache_entries.find( key );
+	if ( entry != cache_entries.end() ) {
+		entry->second.last_used = time( nullptr );
+	}
+
+	// the modification time is all that's left to go on after a restart, so keep it in step
+	utime( path.c_str(), nullptr );
+
+	return true;
+}
+
+/**
+ * Written out under a temporary name first, so nothing else
+ * can see it until it's complete, however many are writing at once.
+ */
+void TextureCache_Write( uint64_t key, const PLImage *image, size_t max_bytes ) {
+	if ( image->levels != 1 || image->size == 0 || sizeof( TextureCacheHeader ) + image->size > max_bytes ) {
+		return;
+	}
+
+	const std::string &directory = GetTextureCacheDirectory();
+	if ( directory.empty() ) {
+		return;
+	}
+
+	static std::atomic<unsigned int> num_writes( 0 );
+	std::string path = GetCachePath( directory, key );
+	std::string temp_path = path + "." + std::to_string( num_writes++ );
+	FILE *fp = fopen( temp_path.c_str(), "wb" );
+	if ( fp == nullptr ) {
+		LogWarn( "Failed to write texture cache to \"%s\"!\n", path.c_str() );
+		return;
+	}
+
+	TextureCacheHeader header{};
+	memcpy( header.magic, "HTXC", sizeof( header.magic ) );
+	header.version = TEXTURE_CACHE_VERSION;
+	header.key = key;
+	header.width = image->width;
+	header.height = image->height;
+	header.format = image->format;
+	header.colour_format = image->colour_format;
+	header.size = image->size;
+	bool status = ( fwrite( &header, sizeof( header ), 1, fp ) == 1 ) &&
+		( fwrite( image->data[ 0 ], image->size, 1, fp ) == 1 );
+	fclose( fp );
+
+	std::lock_guard<std::mutex> lock( cache_mutex );
+	ScanCache( directory );
+
+	// someone else may have just got there first with the same image
+	if ( !status || cache_entries.find( key ) != cache_entries.end() ) {
+		remove( temp_path.c_str() );
+		return;
+	}
+
+	remove( path.c_str() );
+	if ( rename( temp_path.c_str(), path.c_str() ) != 0 ) {
+		LogWarn( "Failed to write texture cache to \"%s\"!\n", path.c_str() );
+		remove( temp_path.c_str() );
+		return;
+	}
+
+	TextureCacheEntry entry{ sizeof( header ) + image->size, time( nullptr ) };
+	cache_entries.insert( std::make_pair( key, entry ) );
+	cache_size += entry.size;
+
+	TrimCache( directory, max_bytes );
+}
+
+void TextureCache_Trim( size_t max_bytes ) {
+	const std::string &directory = GetTextureCacheDirectory();
+	if ( directory.empty() ) {
+		return;
+	}
+
+	std::lock_guard<std::mutex> lock( cache_mutex );
+	ScanCache( directory );
+	TrimCache( directory, max_bytes );
+}
+
+size_t TextureCache_GetSize() {
+	const std::string &directory = GetTextureCacheDirectory();
+	if ( directory.empty() ) {
+		return 0;
+	}
+
+	std::lock_guard<std::mutex> lock( cache_mutex );
+	ScanCache( directory );
+	return cache_size;
+}
+
+unsigned int TextureCache_GetNumEntries() {
+	const std::string &directory = GetTextureCacheDirectory();
+	if ( directory.empty() ) {
+		return 0;
+	}
+
+	std::lock_guard<std::mutex> lock( cache_mutex );
+	ScanCache( directory );
+	return static_cast<unsigned int>(cache_entries.size());
+}
@@ -0,0 +1,41 @@
+/* OpenHoW
+ * Copyright (C) 2017-2020 Mark Sowden <markelswo@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+/* An on-disk cache of decoded images, ready to be uploaded exactly as they are,
+ * each filed under a hash of the contents of the file it was decoded from, so
+ * the same image under any path, or in any package, only needs decoding once.
+ * Everything here is safe to call from any thread. */
+
+/* bump whenever the layout of the cache changes */
+#define TEXTURE_CACHE_VERSION 1
+
+// Hash of the file's contents, or 0 if it couldn't be read
+uint64_t TextureCache_GetKey(const char *path);
+
+// Fills in the image from the cache, returning false if nothing's cached under the key
+bool TextureCache_Read(uint64_t key, PLImage *image);
+// Writes the image out under the key, then drops whatever was used least recently,
+// until the whole cache fits within max_bytes. Only images with a single level are cached.
+void TextureCache_Write(uint64_t key, const PLImage *image, size_t max_bytes);
+
+// Drops whatever was used least recently, until the whole cache fits within max_bytes
+void TextureCache_Trim(size_t max_bytes);
+
+size_t TextureCache_GetSize();
+unsigned int TextureCache_GetNumEntries();
@@ -0,0 +1,132 @@
+/* OpenHoW
+ * Copyright (C) 2017-2020 Mark Sowden <markelswo@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "engine.h"
+#include "job_pool.h"
+
+JobPool::JobPool( unsigned int num_workers ) {
+	for ( unsigned int i = 0; i < num_workers; ++i ) {
+		workers_.emplace_back( &JobPool::WorkerThread, this );
+	}
+
+	LogInfo( "Started %u job workers\n", num_workers );
+}
+
+JobPool::~JobPool() {
+	{
+		std::lock_guard<std::mutex> lock( mutex_ );
+		shutdown_ = true;
+	}
+	work_condition_.notify_all();
+
+	for ( auto &worker : workers_ ) {
+		worker.join();
+	}
+}
+
+/**
+ * Calls func for every index from 0 to count, spread across the workers, and
+ * blocks until every call has returned. The calling thread also takes jobs.
+ * Each index is only ever passed to one call, but the order isn't defined, so
+ * anything that needs to be deterministic should only write to its own index.
+ * Must only be called from the main thread.
+ */
+void JobPool::ParallelFor( unsigned int count, const std::function<void( unsigned int )> &func ) {
+	if ( workers_.empty() || count <= 1 ) {
+		for ( unsigned int i = 0; i < count; ++i ) {
+			func( i );
+		}
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock( mutex_ );
+		func_ = &func;
+		count_ = count;
+		next_ = 0;
+		generation_++;
+	}
+	work_condition_.notify_all();
+
+	RunJobs( func, count );
+
+	// workers busy with background tasks never join, so only wait on those that did
+	std::unique_lock<std::mutex> lock( mutex_ );
+	done_condition_.wait( lock, [ this ] { return num_active_ == 0; } );
+	func_ = nullptr;
+}
+
+/**
+ * Queues up the task to be run on the next free worker, returning straight away.
+ * Tasks run in the order they were submitted, but may overlap, and must not touch
+ * the graphics context or call ParallelFor. Anything still queued at shutdown is
+ * dropped. Without any workers, the task is run immediately instead.
+ */
+void JobPool::Submit( std::function<void()> task ) {
+	if ( workers_.empty() ) {
+		task();
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock( mutex_ );
+		tasks_.push_back( std::move( task ) );
+	}
+	work_condition_.notify_one();
+}
+
+void JobPool::RunJobs( const std::function<void( unsigned int )> &func, unsigned int count ) {
+	for ( unsigned int i = next_++; i < count; i = next_++ ) {
+		func( i );
+	}
+}
+
+void JobPool::WorkerThread() {
+	unsigned int generation = 0;
+	for ( ;; ) {
+		std::unique_lock<std::mutex> lock( mutex_ );
+		work_condition_.wait( lock, [ this, generation ] {
+			return shutdown_ || ( func_ != nullptr && generation_ != generation ) || !tasks_.empty();
+		} );
+		if ( shutdown_ ) {
+			return;
+		}
+
+		// batches take priority, since the main thread is waiting on them
+		if ( func_ != nullptr && generation_ != generation ) {
+			generation = generation_;
+			const std::function<void( unsigned int )> *func = func_;
+			unsigned int count = count_;
+			num_active_++;
+			lock.unlock();
+
+			RunJobs( *func, count );
+
+			lock.lock();
+			if ( --num_active_ == 0 ) {
+				done_condition_.notify_one();
+			}
+			continue;
+		}
+
+		std::function<void()> task = std::move( tasks_.front() );
+		tasks_.pop_front();
+		lock.unlock();
+
+		task();
+	}
+}
@@ -0,0 +1,67 @@
+/* OpenHoW
+ * Copyright (C) 2017-2020 Mark Sowden <markelswo@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * A small pool of worker threads for splitting up CPU-side work, such as
+ * generating terrain meshes. Jobs must not touch the graphics context,
+ * anything uploading to the GPU still needs to happen on the main thread.
+ *
+ * Alongside those batches, single tasks can be queued up to run in the
+ * background, such as loading resources, which workers pick up whenever
+ * they aren't needed for a batch.
+ */
+class JobPool {
+public:
+	explicit JobPool( unsigned int num_workers );
+	~JobPool();
+
+	unsigned int GetNumWorkers() const { return static_cast<unsigned int>( workers_.size() ); }
+
+	void ParallelFor( unsigned int count, const std::function<void( unsigned int )> &func );
+	void Submit( std::function<void()> task );
+
+private:
+	void WorkerThread();
+	void RunJobs( const std::function<void( unsigned int )> &func, unsigned int count );
+
+	std::vector<std::thread> workers_;
+
+	std::mutex mutex_;
+	std::condition_variable work_condition_;
+	std::condition_variable done_condition_;
+
+	// current batch, only changed while no workers are running it
+	const std::function<void( unsigned int )> *func_{ nullptr };
+	unsigned int count_{ 0 };
+	unsigned int generation_{ 0 };
+	unsigned int num_active_{ 0 };
+	std::atomic<unsigned int> next_{ 0 };
+
+	std::deque<std::function<void()>> tasks_;
+
+	bool shutdown_{ false };
+};
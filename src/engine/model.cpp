@@ -106,7 +106,8 @@ TextureAtlas *Model_GenerateTextureAtlas( const FacHandle *facHandle, const std:
 		return nullptr;
 	}
 
-	TextureAtlas *atlas = new TextureAtlas( 128, 128 );
+	// model textures come in all sorts of sizes
+	TextureAtlas *atlas = new TextureAtlas( 128, 128, TextureAtlas::PACKER_SKYLINE, false );
 
 	for ( unsigned int i = 0; i < facHandle->texture_table_size; ++i ) {
 		if ( facHandle->texture_table[ i ].name[ 0 ] == '\0' ) {
@@ -126,25 +127,43 @@ TextureAtlas *Model_GenerateTextureAtlas( const FacHandle *facHandle, const std:
 	return atlas;
 }
 
-PLModel *Model_LoadVtxFile( const char *path ) {
-	VtxHandle *vtx = Vtx_LoadFile( path );
-	if ( vtx == nullptr ) {
+static void Model_GetFacPath( const char *path, char *fac_path ) {
+	strncpy( fac_path, path, strlen( path ) - 3 );
+	fac_path[ strlen( path ) - 3 ] = '\0';
+	strcat( fac_path, "fac" );
+}
+
+/**
+ * Reads in the vertices and faces of a Vtx model, without touching the
+ * graphics context, so this is safe to call from any thread.
+ */
+bool Model_LoadVtxData( const char *path, VtxHandle **vtx, FacHandle **fac ) {
+	if ( ( *vtx = Vtx_LoadFile( path ) ) == nullptr ) {
 		LogWarn( "Failed to load Vtx, \"%s\"!\n", path );
-		return nullptr;
+		return false;
 	}
 
 	/* now we load in all the faces */
 	char fac_path[PL_SYSTEM_MAX_PATH];
-	strncpy( fac_path, path, strlen( path ) - 3 );
-	fac_path[ strlen( path ) - 3 ] = '\0';
-	strcat( fac_path, "fac" );
-	FacHandle *fac = Fac_LoadFile( fac_path );
-	if ( fac == nullptr ) {
-		Vtx_DestroyHandle( vtx );
+	Model_GetFacPath( path, fac_path );
+	if ( ( *fac = Fac_LoadFile( fac_path ) ) == nullptr ) {
+		Vtx_DestroyHandle( *vtx );
+		*vtx = nullptr;
 		LogWarn( "Failed to load Fac, \"%s\"!\n", path );
-		return nullptr;
+		return false;
 	}
 
+	return true;
+}
+
+/**
+ * Builds the model, along with its texture atlas, out of the data read in by
+ * Model_LoadVtxData, which is destroyed afterwards. Main thread only.
+ */
+PLModel *Model_CreateVtxModel( const char *path, VtxHandle *vtx, FacHandle *fac ) {
+	char fac_path[PL_SYSTEM_MAX_PATH];
+	Model_GetFacPath( path, fac_path );
+
 	const char *filename = plGetFileName( path );
 	// skydome is a special case, since we don't care about textures...
 	if ( pl_strcasecmp( filename, "skydome.vtx" ) == 0 || pl_strcasecmp( filename, "skydomeu.vtx" ) == 0 ) {
@@ -246,6 +265,9 @@ PLModel *Model_LoadVtxFile( const char *path ) {
 
 	delete textureAtlas;
 
+	Vtx_DestroyHandle( vtx );
+	Fac_DestroyHandle( fac );
+
 	std::list<PLMesh *> meshes( &mesh, &mesh + 1 );
 	Mesh_GenerateFragmentedMeshNormals( meshes );
 
@@ -268,6 +290,16 @@ PLModel *Model_LoadVtxFile( const char *path ) {
 	return model;
 }
 
+PLModel *Model_LoadVtxFile( const char *path ) {
+	VtxHandle *vtx;
+	FacHandle *fac;
+	if ( !Model_LoadVtxData( path, &vtx, &fac ) ) {
+		return nullptr;
+	}
+
+	return Model_CreateVtxModel( path, vtx, fac );
+}
+
 PLModel *Model_LoadMinFile( const char *path ) {
 	u_assert( 0, "TODO" );
 	return nullptr;
@@ -0,0 +1,673 @@
+/* OpenHoW
+ * Copyright (C) 2017-2020 Mark Sowden <markelswo@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iterator>
+
+#include "engine.h"
+#include "paged_terrain.h"
+#include "Map.h"
+
+#include "graphics/camera.h"
+#include "graphics/shaders.h"
+#include "graphics/texture_atlas.h"
+
+/* at most this many chunks are uploaded each frame, so that a burst of
+ * page-ins is spread out over a few frames rather than causing a hitch */
+#define PAGED_TERRAIN_UPLOADS_PER_FRAME 4
+
+PagedTerrain::PagedTerrain( const std::string& path, const std::string& tileset ) {
+	atlas_ = Terrain::CreateTileAtlas( tileset );
+	Terrain::GenerateTextureCoords( atlas_, texture_coords_ );
+
+	file_ = plOpenFile( path.c_str(), false );
+	if ( file_ == nullptr ) {
+		LogWarn( "Failed to open tile data, \"%s\", aborting\n", path.c_str() );
+		return;
+	}
+
+	// the grid is always square, so its size falls out of the number of chunks
+	size_t num_chunks = plGetFileSize( file_ ) / TERRAIN_PMG_CHUNK_BYTES;
+	row_chunks_ = static_cast<unsigned int>(std::sqrt( static_cast<double>(num_chunks) ));
+	if ( row_chunks_ == 0 ) {
+		LogWarn( "No chunks in \"%s\", aborting!\n", path.c_str() );
+		plCloseFile( file_ );
+		file_ = nullptr;
+		return;
+	} else if ( row_chunks_ * row_chunks_ != num_chunks ) {
+		LogWarn( "Ignoring %u chunks beyond the %ux%u grid in \"%s\"!\n",
+				 static_cast<unsigned int>(num_chunks - row_chunks_ * row_chunks_), row_chunks_, row_chunks_, path.c_str() );
+	}
+
+	chunk_bytes_ = TERRAIN_CHUNK_TILES * ( 4 * sizeof( PLVertex ) + 6 * sizeof( unsigned int ) );
+
+	// The ground is read in for the whole grid up front, a row of chunks at a time,
+	// so that anything off in the distance, away from the camera, still has something
+	// to stand on. It's only a few bytes per tile, it's the meshes that take up the room.
+	row_tiles_ = row_chunks_ * TERRAIN_CHUNK_ROW_TILES;
+	unsigned int row_vertices = row_tiles_ + 1;
+	heights_.resize( row_vertices * row_vertices, 0 );
+	surfaces_.resize( row_tiles_ * row_tiles_, Terrain::Tile::SURFACE_MUD );
+	behaviours_.resize( row_tiles_ * row_tiles_, Terrain::Tile::BEHAVIOUR_NONE );
+
+	std::vector<uint8_t> row( row_chunks_ * TERRAIN_PMG_CHUNK_BYTES );
+	Terrain::PmgChunk chunk{};
+	for ( unsigned int chunk_y = 0; chunk_y < row_chunks_; ++chunk_y ) {
+		if ( !plFileSeek( file_, chunk_y * row.size(), PL_SEEK_SET ) ||
+			plReadFile( file_, row.data(), row.size(), 1 ) != 1 ) {
+			LogWarn( "Failed to read row %u of \"%s\", the rest is flattened!\n", chunk_y, path.c_str() );
+			break;
+		}
+
+		for ( unsigned int chunk_x = 0; chunk_x < row_chunks_; ++chunk_x ) {
+			Terrain::DecodePmgChunk( &row[ chunk_x * TERRAIN_PMG_CHUNK_BYTES ], chunk );
+
+			// vertices along the edges are shared with the neighbouring chunks
+			for ( unsigned int y = 0; y < TERRAIN_CHUNK_ROW_VERTICES; ++y ) {
+				unsigned int idx = ( chunk_x * TERRAIN_CHUNK_ROW_TILES ) +
+					( chunk_y * TERRAIN_CHUNK_ROW_TILES + y ) * row_vertices;
+				memcpy( &heights_[ idx ], &chunk.heights[ y * TERRAIN_CHUNK_ROW_VERTICES ],
+						TERRAIN_CHUNK_ROW_VERTICES * sizeof( float ) );
+			}
+
+			for ( unsigned int y = 0; y < TERRAIN_CHUNK_ROW_TILES; ++y ) {
+				unsigned int idx = ( chunk_x * TERRAIN_CHUNK_ROW_TILES ) +
+					( chunk_y * TERRAIN_CHUNK_ROW_TILES + y ) * row_tiles_;
+				memcpy( &surfaces_[ idx ], &chunk.surfaces[ y * TERRAIN_CHUNK_ROW_TILES ], TERRAIN_CHUNK_ROW_TILES );
+				memcpy( &behaviours_[ idx ], &chunk.behaviours[ y * TERRAIN_CHUNK_ROW_TILES ], TERRAIN_CHUNK_ROW_TILES );
+			}
+		}
+	}
+
+	auto extents = std::minmax_element( heights_.begin(), heights_.end() );
+	min_height_ = *extents.first;
+	max_height_ = *extents.second;
+
+	loader_ = std::thread( &PagedTerrain::LoaderThread, this );
+
+	LogInfo( "Paging in %ux%u chunks from \"%s\"\n", row_chunks_, row_chunks_, path.c_str() );
+}
+
+PagedTerrain::~PagedTerrain() {
+	if ( loader_.joinable() ) {
+		{
+			std::lock_guard<std::mutex> lock( mutex_ );
+			shutdown_ = true;
+		}
+		condition_.notify_all();
+		loader_.join();
+	}
+
+	if ( file_ != nullptr ) {
+		plCloseFile( file_ );
+	}
+
+	for ( auto& chunk : resident_ ) {
+		plDestroyModel( chunk.second.model );
+	}
+
+	delete atlas_;
+}
+
+bool PagedTerrain::IsPagedPmg( const std::string& path ) {
+	PLFile* fh = plOpenFile( path.c_str(), false );
+	if ( fh == nullptr ) {
+		return false;
+	}
+
+	size_t length = plGetFileSize( fh );
+	plCloseFile( fh );
+	return length >= ( TERRAIN_CHUNK_ROW + 1 ) * ( TERRAIN_CHUNK_ROW + 1 ) * TERRAIN_PMG_CHUNK_BYTES;
+}
+
+const PagedTerrain::Chunk* PagedTerrain::GetChunk( const PLVector2& pos ) const {
+	float width = static_cast<float>(row_chunks_) * TERRAIN_CHUNK_PIXEL_WIDTH;
+	// written this way around so NaN is also rejected
+	if ( !( pos.x >= 0 && pos.x < width && pos.y >= 0 && pos.y < width ) ) {
+		return nullptr;
+	}
+
+	unsigned int idx = static_cast<unsigned int>(pos.x / TERRAIN_CHUNK_PIXEL_WIDTH) +
+		static_cast<unsigned int>(pos.y / TERRAIN_CHUNK_PIXEL_WIDTH) * row_chunks_;
+	auto chunk = resident_.find( idx );
+	if ( chunk == resident_.end() ) {
+		return nullptr;
+	}
+
+	return &chunk->second;
+}
+
+bool PagedTerrain::IsResident( const PLVector2& pos ) const {
+	return GetChunk( pos ) != nullptr;
+}
+
+/**
+ * Same as Terrain::GetHeight, anywhere off the grid has a height of 0.
+ */
+float PagedTerrain::GetHeight( const PLVector2& pos ) const {
+	float width = GetPixelWidth();
+	// written this way around so NaN is also rejected
+	if ( !( pos.x >= 0 && pos.x < width && pos.y >= 0 && pos.y < width ) ) {
+		return 0;
+	}
+
+	float x = pos.x / TERRAIN_TILE_PIXEL_WIDTH;
+	float y = pos.y / TERRAIN_TILE_PIXEL_WIDTH;
+	auto tile_x = std::min( static_cast<unsigned int>(x), row_tiles_ - 1 );
+	auto tile_y = std::min( static_cast<unsigned int>(y), row_tiles_ - 1 );
+	x -= tile_x;
+	y -= tile_y;
+
+	unsigned int row_vertices = row_tiles_ + 1;
+	const float* h = &heights_[ tile_x + tile_y * row_vertices ];
+	float top = h[ 0 ] + ( ( h[ 1 ] - h[ 0 ] ) * x );
+	float bottom = h[ row_vertices ] + ( ( h[ row_vertices + 1 ] - h[ row_vertices ] ) * x );
+	return top + ( ( bottom - top ) * y );
+}
+
+bool PagedTerrain::GetTileIndex( const PLVector2& pos, unsigned int* idx ) const {
+	float width = GetPixelWidth();
+	if ( !( pos.x >= 0 && pos.x < width && pos.y >= 0 && pos.y < width ) ) {
+		return false;
+	}
+
+	auto tile_x = std::min( static_cast<unsigned int>(pos.x / TERRAIN_TILE_PIXEL_WIDTH), row_tiles_ - 1 );
+	auto tile_y = std::min( static_cast<unsigned int>(pos.y / TERRAIN_TILE_PIXEL_WIDTH), row_tiles_ - 1 );
+	*idx = tile_x + tile_y * row_tiles_;
+	return true;
+}
+
+Terrain::Tile::Surface PagedTerrain::GetSurface( const PLVector2& pos ) const {
+	unsigned int idx;
+	if ( !GetTileIndex( pos, &idx ) ) {
+		return Terrain::Tile::SURFACE_MUD;
+	}
+
+	return static_cast<Terrain::Tile::Surface>(surfaces_[ idx ]);
+}
+
+Terrain::Tile::Behaviour PagedTerrain::GetBehaviour( const PLVector2& pos ) const {
+	unsigned int idx;
+	if ( !GetTileIndex( pos, &idx ) ) {
+		return Terrain::Tile::BEHAVIOUR_NONE;
+	}
+
+	return static_cast<Terrain::Tile::Behaviour>(behaviours_[ idx ]);
+}
+
+/**
+ * Marches along the ray a quarter of a tile at a time, then narrows down on where
+ * it crossed the surface, rather than walking a height pyramid as Terrain does.
+ * Anything off the grid is skipped over.
+ */
+bool PagedTerrain::Raycast( const PLVector3& origin, const PLVector3& direction, float max_distance,
+							PLVector3* hit, float* distance ) const {
+	if ( !( max_distance > 0 ) ) {
+		return false;
+	}
+
+	float width = GetPixelWidth();
+	auto below = [ this, &origin, &direction, width ]( float t ) {
+		PLVector3 point = origin + direction * t;
+		if ( !( point.x >= 0 && point.x < width && point.z >= 0 && point.z < width ) ) {
+			return false;
+		}
+
+		return point.y <= GetHeight( PLVector2( point.x, point.z ) );
+	};
+
+	const float step = TERRAIN_TILE_PIXEL_WIDTH / 4.0f;
+	float last_t = 0;
+	for ( float t = 0;; t = std::min( t + step, max_distance ) ) {
+		if ( below( t ) ) {
+			float low = last_t, high = t;
+			for ( unsigned int i = 0; i < 8 && high > low; ++i ) {
+				float middle = ( low + high ) / 2;
+				if ( below( middle ) ) {
+					high = middle;
+				} else {
+					low = middle;
+				}
+			}
+
+			if ( hit != nullptr ) {
+				*hit = origin + direction * high;
+			}
+			if ( distance != nullptr ) {
+				*distance = high;
+			}
+			return true;
+		}
+
+		if ( t >= max_distance ) {
+			return false;
+		}
+		last_t = t;
+	}
+}
+
+unsigned int PagedTerrain::GetDistance( unsigned int idx, unsigned int chunk_x, unsigned int chunk_y ) const {
+	unsigned int x = idx % row_chunks_;
+	unsigned int y = idx / row_chunks_;
+	return std::max( ( x > chunk_x ) ? x - chunk_x : chunk_x - x, ( y > chunk_y ) ? y - chunk_y : chunk_y - y );
+}
+
+/**
+ * Uploads whatever the loader has finished, drops anything that's fallen out of
+ * range or over budget and then queues up anything missing, nearest first.
+ */
+void PagedTerrain::Update( const PLVector3& viewpoint ) {
+	if ( !IsValid() ) {
+		return;
+	}
+
+	float max_position = static_cast<float>(row_chunks_ - 1);
+	auto chunk_x = static_cast<unsigned int>(std::min( std::max( viewpoint.x / TERRAIN_CHUNK_PIXEL_WIDTH, 0.0f ), max_position ));
+	auto chunk_y = static_cast<unsigned int>(std::min( std::max( viewpoint.z / TERRAIN_CHUNK_PIXEL_WIDTH, 0.0f ), max_position ));
+	auto radius = static_cast<unsigned int>(std::max( cv_graphics_terrain_page_radius->i_value, 1 ));
+	size_t budget = static_cast<size_t>(std::max( cv_graphics_terrain_page_budget->i_value, 0 )) * 1024;
+
+	std::vector<Page> pages;
+	{
+		std::lock_guard<std::mutex> lock( mutex_ );
+		unsigned int num_pages = std::min( ( unsigned int ) pages_.size(), ( unsigned int ) PAGED_TERRAIN_UPLOADS_PER_FRAME );
+		std::move( pages_.begin(), pages_.begin() + num_pages, std::back_inserter( pages ) );
+		pages_.erase( pages_.begin(), pages_.begin() + num_pages );
+	}
+
+	for ( auto& page : pages ) {
+		loading_.erase( page.idx );
+		if ( GetDistance( page.idx, chunk_x, chunk_y ) <= radius ) {
+			PageIn( page );
+		}
+	}
+
+	// Chunks are given an extra chunk of leeway before being dropped,
+	// so moving back and forth across a boundary doesn't thrash them
+	std::vector<unsigned int> evict;
+	for ( const auto& chunk : resident_ ) {
+		if ( GetDistance( chunk.first, chunk_x, chunk_y ) > radius + 1 ) {
+			evict.push_back( chunk.first );
+		}
+	}
+	for ( unsigned int idx : evict ) {
+		PageOut( idx );
+	}
+
+	// and then the furthest out, if the budget has shrunk
+	if ( GetResidentBytes() > budget ) {
+		evict.clear();
+		for ( const auto& chunk : resident_ ) {
+			evict.push_back( chunk.first );
+		}
+		std::sort( evict.begin(), evict.end(), [ this, chunk_x, chunk_y ]( unsigned int a, unsigned int b ) {
+			return GetDistance( a, chunk_x, chunk_y ) > GetDistance( b, chunk_x, chunk_y );
+		} );
+		for ( unsigned int i = 0; i < evict.size() && GetResidentBytes() > budget; ++i ) {
+			PageOut( evict[ i ] );
+		}
+	}
+
+	std::vector<unsigned int> wanted;
+	unsigned int min_x = ( chunk_x > radius ) ? chunk_x - radius : 0;
+	unsigned int min_y = ( chunk_y > radius ) ? chunk_y - radius : 0;
+	unsigned int max_x = std::min( chunk_x + radius, row_chunks_ - 1 );
+	unsigned int max_y = std::min( chunk_y + radius, row_chunks_ - 1 );
+	for ( unsigned int y = min_y; y <= max_y; ++y ) {
+		for ( unsigned int x = min_x; x <= max_x; ++x ) {
+			unsigned int idx = x + y * row_chunks_;
+			if ( resident_.find( idx ) == resident_.end() && loading_.find( idx ) == loading_.end() ) {
+				wanted.push_back( idx );
+			}
+		}
+	}
+
+	auto nearest = [ this, chunk_x, chunk_y ]( unsigned int a, unsigned int b ) {
+		unsigned int distance_a = GetDistance( a, chunk_x, chunk_y );
+		unsigned int distance_b = GetDistance( b, chunk_x, chunk_y );
+		return ( distance_a != distance_b ) ? distance_a < distance_b : a < b;
+	};
+	std::sort( wanted.begin(), wanted.end(), nearest );
+
+	bool queued = false;
+	{
+		std::lock_guard<std::mutex> lock( mutex_ );
+
+		// anything queued that's since fallen out of range is no longer needed
+		for ( auto i = requests_.begin(); i != requests_.end(); ) {
+			if ( GetDistance( *i, chunk_x, chunk_y ) > radius ) {
+				loading_.erase( *i );
+				i = requests_.erase( i );
+			} else {
+				++i;
+			}
+		}
+
+		size_t committed = ( resident_.size() + loading_.size() ) * chunk_bytes_;
+		for ( unsigned int idx : wanted ) {
+			if ( committed + chunk_bytes_ > budget ) {
+				break;
+			}
+
+			requests_.push_back( idx );
+			loading_.insert( idx );
+			committed += chunk_bytes_;
+			queued = true;
+		}
+
+		std::sort( requests_.begin(), requests_.end(), nearest );
+	}
+
+	if ( queued ) {
+		condition_.notify_one();
+	}
+}
+
+void PagedTerrain::PageIn( Page& page ) {
+	static std::vector<unsigned int> indices;
+	if ( indices.empty() ) {
+		for ( unsigned int i = 0; i < TERRAIN_CHUNK_TILES; ++i ) {
+			// corners are top left, top right, bottom left and then bottom right
+			unsigned int tile_indices[] = { 0, 2, 1, 1, 2, 3 };
+			for ( unsigned int index : tile_indices ) {
+				indices.push_back( i * 4 + index );
+			}
+		}
+	}
+
+	PLMesh* mesh = plCreateMeshInit( PL_MESH_TRIANGLES, PL_DRAW_STATIC,
+									 indices.size() / 3, page.vertices.size(), ( void* ) indices.data(), nullptr );
+	if ( mesh == nullptr ) {
+		LogWarn( "Unable to create paged chunk mesh (%s)!\n", plGetError() );
+		return;
+	}
+
+	memcpy( mesh->vertices, page.vertices.data(), page.vertices.size() * sizeof( PLVertex ) );
+	mesh->texture = atlas_->GetTexture();
+	plUploadMesh( mesh );
+
+	Chunk chunk;
+	if ( ( chunk.model = plCreateBasicStaticModel( mesh ) ) == nullptr ) {
+		LogWarn( "Failed to create paged chunk model (%s)!\n", plGetError() );
+		plDestroyMesh( mesh );
+		return;
+	}
+
+	chunk.bounds_min = page.bounds_min;
+	chunk.bounds_max = page.bounds_max;
+	resident_.emplace( page.idx, chunk );
+	num_paged_in_++;
+}
+
+void PagedTerrain::PageOut( unsigned int idx ) {
+	auto chunk = resident_.find( idx );
+	if ( chunk == resident_.end() ) {
+		return;
+	}
+
+	plDestroyModel( chunk->second.model );
+	resident_.erase( chunk );
+	num_paged_out_++;
+}
+
+void PagedTerrain::LoaderThread() {
+	for ( ;; ) {
+		unsigned int idx;
+		{
+			std::unique_lock<std::mutex> lock( mutex_ );
+			condition_.wait( lock, [ this ] { return shutdown_ || !requests_.empty(); } );
+			if ( shutdown_ ) {
+				return;
+			}
+
+			idx = requests_.front();
+			requests_.pop_front();
+		}
+
+		Page page;
+		GeneratePage( idx, page );
+
+		std::lock_guard<std::mutex> lock( mutex_ );
+		pages_.push_back( std::move( page ) );
+	}
+}
+
+bool PagedTerrain::ReadChunk( unsigned int chunk_x, unsigned int chunk_y, Terrain::PmgChunk& chunk ) {
+	uint8_t record[TERRAIN_PMG_CHUNK_BYTES];
+	if ( !plFileSeek( file_, ( chunk_x + chunk_y * row_chunks_ ) * TERRAIN_PMG_CHUNK_BYTES, PL_SEEK_SET ) ||
+		plReadFile( file_, record, sizeof( record ), 1 ) != 1 ) {
+		// a chunk that can't be read is left plain, rather than with anything half read
+		chunk = Terrain::PmgChunk();
+		std::fill( std::begin( chunk.shading ), std::end( chunk.shading ), 255 );
+		return false;
+	}
+
+	Terrain::DecodePmgChunk( record, chunk );
+	return true;
+}
+
+/**
+ * Generates the vertices for the chunk. The heights, including those of the
+ * neighbouring chunks needed for the normals along its edges, come from the
+ * grid, so only the chunk's own textures and shading are read in. This runs
+ * on the loader thread, so mustn't touch anything but the page, the file and
+ * the grid.
+ */
+bool PagedTerrain::GeneratePage( unsigned int idx, Page& page ) {
+	unsigned int chunk_x = idx % row_chunks_;
+	unsigned int chunk_y = idx / row_chunks_;
+	page.idx = idx;
+
+	Terrain::PmgChunk chunk;
+	bool status = ReadChunk( chunk_x, chunk_y, chunk );
+	if ( !status ) {
+		LogWarn( "Failed to read chunk %u %u, left untextured!\n", chunk_x, chunk_y );
+	}
+
+	unsigned int base_x = chunk_x * TERRAIN_CHUNK_ROW_TILES;
+	unsigned int base_y = chunk_y * TERRAIN_CHUNK_ROW_TILES;
+	unsigned int row_vertices = row_tiles_ + 1;
+	auto position = [ this, row_vertices ]( unsigned int x, unsigned int y ) {
+		return PLVector3(
+			static_cast<float>(x * TERRAIN_TILE_PIXEL_WIDTH ),
+			heights_[ x + y * row_vertices ],
+			static_cast<float>(y * TERRAIN_TILE_PIXEL_WIDTH ) );
+	};
+
+	PLVector3 normals[TERRAIN_CHUNK_VERTICES];
+	for ( unsigned int i = 0; i < TERRAIN_CHUNK_VERTICES; ++i ) {
+		normals[ i ] = Terrain::GenerateVertexNormal( heights_.data(), row_tiles_,
+			base_x + i % TERRAIN_CHUNK_ROW_VERTICES, base_y + i / TERRAIN_CHUNK_ROW_VERTICES );
+	}
+
+	float min = heights_[ base_x + base_y * row_vertices ];
+	float max = min;
+	for ( unsigned int i = 0; i < TERRAIN_CHUNK_VERTICES; ++i ) {
+		float height = position( base_x + i % TERRAIN_CHUNK_ROW_VERTICES, base_y + i / TERRAIN_CHUNK_ROW_VERTICES ).y;
+		min = std::min( min, height );
+		max = std::max( max, height );
+	}
+	page.bounds_min = PLVector3( static_cast<float>(chunk_x * TERRAIN_CHUNK_PIXEL_WIDTH), min,
+								 static_cast<float>(chunk_y * TERRAIN_CHUNK_PIXEL_WIDTH) );
+	page.bounds_max = PLVector3( static_cast<float>(( chunk_x + 1 ) * TERRAIN_CHUNK_PIXEL_WIDTH), max,
+								 static_cast<float>(( chunk_y + 1 ) * TERRAIN_CHUNK_PIXEL_WIDTH) );
+
+	// four vertices per tile, so each tile can have its own texture coords
+	page.vertices.resize( TERRAIN_CHUNK_TILES * 4 );
+	for ( unsigned int i = 0; i < TERRAIN_CHUNK_TILES; ++i ) {
+		float s[4], t[4];
+		Terrain::GenerateTileCoords( texture_coords_[ chunk.textures[ i ] ], chunk.rotations[ i ], s, t );
+
+		for ( unsigned int corner = 0; corner < 4; ++corner ) {
+			unsigned int vertex_idx = ( i % TERRAIN_CHUNK_ROW_TILES + ( corner & 1U ) ) +
+				( i / TERRAIN_CHUNK_ROW_TILES + ( corner >> 1U ) ) * TERRAIN_CHUNK_ROW_VERTICES;
+			uint8_t shading = chunk.shading[ vertex_idx ];
+
+			PLVertex* vertex = &page.vertices[ i * 4 + corner ];
+			vertex->position = position(
+				base_x + vertex_idx % TERRAIN_CHUNK_ROW_VERTICES, base_y + vertex_idx / TERRAIN_CHUNK_ROW_VERTICES );
+			vertex->normal = normals[ vertex_idx ];
+			vertex->st[ 0 ] = PLVector2( s[ corner ], t[ corner ] );
+			vertex->colour = PLColour( shading, shading, shading );
+		}
+	}
+
+	return status;
+}
+
+void PagedTerrain::Draw() {
+	Shaders_SetProgramByName( cv_graphics_debug_normals->b_value ? "debug_normals" : "generic_textured_lit" );
+
+	ViewFrustum frustum = openhow::Engine::Game()->GetCamera()->GetFrustum();
+
+	g_state.gfx.num_chunks_drawn = 0;
+	g_state.gfx.num_chunks_total = row_chunks_ * row_chunks_;
+	g_state.gfx.num_terrain_draws = 0;
+	g_state.gfx.terrain_buffer_bytes = static_cast<unsigned int>(GetResidentBytes());
+	for ( const auto& chunk : resident_ ) {
+		if ( cv_graphics_cull->b_value && !frustum.IntersectsBox( chunk.second.bounds_min, chunk.second.bounds_max ) ) {
+			continue;
+		}
+
+		g_state.gfx.num_chunks_drawn++;
+		g_state.gfx.num_terrain_draws++;
+		plDrawModel( chunk.second.model );
+	}
+}
+
+/**
+ * Generates a large map and then flies across it from corner to corner,
+ * paging chunks in and out as the game would but without drawing anything.
+ * Reports how long each frame's Update took on the main thread, and how often
+ * the chunk beneath the camera hadn't been paged in yet.
+ * Usage: PagedTerrainBenchmark [chunks per row] [frames]
+ */
+void PagedTerrain::BenchmarkCommand( unsigned int argc, char** argv ) {
+	unsigned int row_chunks = 64;
+	unsigned int num_frames = 900;
+	if ( argc > 1 ) {
+		row_chunks = strtoul( argv[ 1 ], nullptr, 10 );
+	}
+	if ( argc > 2 ) {
+		num_frames = strtoul( argv[ 2 ], nullptr, 10 );
+	}
+	if ( row_chunks == 0 || num_frames == 0 ) {
+		LogWarn( "Invalid arguments, ignoring!\n" );
+		return;
+	}
+
+	std::string path = openhow::Engine::GetCacheDirectory();
+	if ( path.empty() ) {
+		return;
+	}
+	path += "paged_benchmark.pmg";
+
+	FILE* fp = fopen( path.c_str(), "wb" );
+	if ( fp == nullptr ) {
+		LogWarn( "Failed to write \"%s\"!\n", path.c_str() );
+		return;
+	}
+
+	// rolling hills, worked out from the position of each vertex so the seams line up
+	std::vector<uint8_t> record( TERRAIN_PMG_CHUNK_BYTES );
+	for ( unsigned int chunk_y = 0; chunk_y < row_chunks; ++chunk_y ) {
+		for ( unsigned int chunk_x = 0; chunk_x < row_chunks; ++chunk_x ) {
+			std::fill( record.begin(), record.end(), 0 );
+
+			uint8_t* vertex = &record[ 8 ];
+			for ( unsigned int i = 0; i < TERRAIN_CHUNK_VERTICES; ++i, vertex += 4 ) {
+				float x = static_cast<float>(chunk_x * TERRAIN_CHUNK_ROW_TILES + i % TERRAIN_CHUNK_ROW_VERTICES);
+				float y = static_cast<float>(chunk_y * TERRAIN_CHUNK_ROW_TILES + i / TERRAIN_CHUNK_ROW_VERTICES);
+				auto height = static_cast<int16_t>(std::sin( x * 0.05f ) * std::cos( y * 0.07f ) * 1024.0f);
+				vertex[ 0 ] = static_cast<uint8_t>(height & 0xFF);
+				vertex[ 1 ] = static_cast<uint8_t>(( height >> 8 ) & 0xFF);
+				vertex[ 2 ] = 255;
+			}
+
+			uint8_t* tile = &record[ 8 + TERRAIN_CHUNK_VERTICES * 4 + 4 ];
+			for ( unsigned int i = 0; i < TERRAIN_CHUNK_TILES; ++i, tile += 16 ) {
+				tile[ 6 ] = Terrain::Tile::SURFACE_GRASS;
+				tile[ 11 ] = static_cast<uint8_t>(( chunk_x + chunk_y + i ) % 8);
+			}
+
+			fwrite( record.data(), 1, record.size(), fp );
+		}
+	}
+	fclose( fp );
+
+	std::string tileset;
+	Map* map = openhow::Engine::Game()->GetCurrentMap();
+	if ( map != nullptr ) {
+		tileset = map->GetManifest()->tile_directory.empty() ?
+				  "maps/" + map->GetManifest()->filename + "/tiles/" : map->GetManifest()->tile_directory;
+	}
+
+	{
+		PagedTerrain terrain( path, tileset );
+		if ( !terrain.IsValid() ) {
+			remove( path.c_str() );
+			return;
+		}
+
+		// anything taking more than a quarter of a 60fps frame counts as a hitch
+		const std::chrono::microseconds frame_time( 16667 );
+		const double hitch_ms = 4.0;
+
+		std::vector<double> times( num_frames );
+		unsigned int num_missing = 0;
+		unsigned int max_resident = 0;
+		float width = static_cast<float>(row_chunks * TERRAIN_CHUNK_PIXEL_WIDTH);
+		auto next_frame = std::chrono::steady_clock::now();
+		for ( unsigned int i = 0; i < num_frames; ++i ) {
+			float progress = static_cast<float>(i) / num_frames;
+			PLVector3 viewpoint( width * progress, 2048.0f, width * progress );
+
+			auto start = std::chrono::steady_clock::now();
+			terrain.Update( viewpoint );
+			times[ i ] = std::chrono::duration<double, std::milli>( std::chrono::steady_clock::now() - start ).count();
+
+			if ( !terrain.IsResident( PLVector2( viewpoint.x, viewpoint.z ) ) ) {
+				num_missing++;
+			}
+			max_resident = std::max( max_resident, terrain.GetNumResident() );
+
+			next_frame += frame_time;
+			std::this_thread::sleep_until( next_frame );
+		}
+
+		double total_ms = 0;
+		unsigned int num_hitches = 0;
+		for ( double ms : times ) {
+			total_ms += ms;
+			if ( ms > hitch_ms ) {
+				num_hitches++;
+			}
+		}
+		std::sort( times.begin(), times.end() );
+
+		LogInfo( "Paged %ux%u chunks over %u frames, %u in and %u out (at most %u resident, %ukb)\n",
+				 row_chunks, row_chunks, num_frames, terrain.num_paged_in_, terrain.num_paged_out_,
+				 max_resident, static_cast<unsigned int>( plBytesToKilobytes( max_resident * terrain.chunk_bytes_ ) ) );
+		LogInfo( "Update: %.3fms average, %.3fms 99th percentile, %.3fms worst, %u hitches over %.1fms\n",
+				 total_ms / num_frames, times[ ( num_frames * 99 ) / 100 ], times.back(), num_hitches, hitch_ms );
+		LogInfo( "Chunk beneath the camera was missing for %u frames\n", num_missing );
+	}
+
+	remove( path.c_str() );
+}
@@ -0,0 +1,123 @@
+/* OpenHoW
+ * Copyright (C) 2017-2020 Mark Sowden <markelswo@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "terrain.h"
+
+class TextureAtlas;
+
+/* Terrain for maps beyond the usual 16x16 chunks. The size of the grid comes
+ * from the pmg itself. The ground itself is kept for the whole grid, so it can
+ * be queried anywhere, but only the chunks around the camera have meshes. Those
+ * are read in and generated on a background thread, so all that's left for the
+ * main thread is uploading them. */
+class PagedTerrain {
+ public:
+  PagedTerrain(const std::string& path, const std::string& tileset);
+  ~PagedTerrain();
+
+  bool IsValid() const { return row_chunks_ > 0; }
+  unsigned int GetRowChunks() const { return row_chunks_; }
+  unsigned int GetNumResident() const { return static_cast<unsigned int>(resident_.size()); }
+  size_t GetResidentBytes() const { return resident_.size() * chunk_bytes_; }
+
+  float GetPixelWidth() const { return static_cast<float>(row_chunks_) * TERRAIN_CHUNK_PIXEL_WIDTH; }
+  // Across the whole grid, paged in or not.
+  float GetMaxHeight() const { return max_height_; }
+  float GetMinHeight() const { return min_height_; }
+
+  // Whether the chunk's mesh is paged in, the queries below work anywhere on the grid.
+  bool IsResident(const PLVector2& pos) const;
+  float GetHeight(const PLVector2& pos) const;
+  Terrain::Tile::Surface GetSurface(const PLVector2& pos) const;
+  Terrain::Tile::Behaviour GetBehaviour(const PLVector2& pos) const;
+  bool Raycast(const PLVector3& origin, const PLVector3& direction, float max_distance,
+               PLVector3* hit = nullptr, float* distance = nullptr) const;
+
+  // Pages chunks in and out around the given point, expected to be called every frame.
+  void Update(const PLVector3& viewpoint);
+  void Draw();
+
+  // Whether the given pmg has more chunks than Terrain can hold.
+  static bool IsPagedPmg(const std::string& path);
+
+  static void BenchmarkCommand(unsigned int argc, char** argv);
+
+ protected:
+ private:
+  /* a chunk generated by the loader, waiting to be uploaded */
+  struct Page {
+    unsigned int idx{0};
+    PLVector3 bounds_min;
+    PLVector3 bounds_max;
+    std::vector<PLVertex> vertices;
+  };
+
+  struct Chunk {
+    PLModel* model{nullptr};
+    PLVector3 bounds_min;
+    PLVector3 bounds_max;
+  };
+
+  void LoaderThread();
+  bool GeneratePage(unsigned int idx, Page& page);
+  bool ReadChunk(unsigned int chunk_x, unsigned int chunk_y, Terrain::PmgChunk& chunk);
+
+  void PageIn(Page& page);
+  void PageOut(unsigned int idx);
+  unsigned int GetDistance(unsigned int idx, unsigned int chunk_x, unsigned int chunk_y) const;
+  const Chunk* GetChunk(const PLVector2& pos) const;
+  bool GetTileIndex(const PLVector2& pos, unsigned int* idx) const;
+
+  unsigned int row_chunks_{0};
+  unsigned int row_tiles_{0};
+  size_t chunk_bytes_{0};
+  float max_height_{0};
+  float min_height_{0};
+
+  /* laid out the same as Terrain's storage, only over the whole grid,
+   * and left alone once loaded so the loader can read from it freely */
+  std::vector<float> heights_;     // row_tiles_ + 1 vertices along each side
+  std::vector<uint8_t> surfaces_;  // row_tiles_ along each side
+  std::vector<uint8_t> behaviours_;
+
+  TextureAtlas* atlas_{nullptr};
+  Terrain::TextureCoords texture_coords_[256];
+
+  std::unordered_map<unsigned int, Chunk> resident_;
+  std::unordered_set<unsigned int> loading_; // handed to the loader, not yet resident
+
+  PLFile* file_{nullptr}; // only touched by the loader once it's running
+
+  std::thread loader_;
+  std::mutex mutex_;
+  std::condition_variable condition_;
+  std::deque<unsigned int> requests_; // nearest first
+  std::vector<Page> pages_;           // ready to be uploaded
+  bool shutdown_{false};
+
+  unsigned int num_paged_in_{0};
+  unsigned int num_paged_out_{0};
+};
@@ -15,19 +15,26 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+
 #include "engine.h"
 #include "resource_manager.h"
 #include "graphics/shaders.h"
+#include "graphics/texture_cache.h"
+#include "loaders/loaders.h"
 
-using namespace openhow;
+#include "../shared/dxt.h"
 
-/* todo:
- *  allow resources to be cached into collections (e.g. Clear("GameTextures"))
- */
+using namespace openhow;
 
 PLModel* LoadObjModel( const char* path ); // see loaders/obj.cpp
 PLModel* Model_LoadVtxFile( const char* path );
 PLModel* Model_LoadMinFile( const char* path );
+bool Model_LoadVtxData( const char* path, VtxHandle** vtx, FacHandle** fac );
+PLModel* Model_CreateVtxModel( const char* path, VtxHandle* vtx, FacHandle* fac );
 
 ResourceManager::ResourceManager() {
 	plRegisterModelLoader( "obj", LoadObjModel );
@@ -36,11 +43,42 @@ ResourceManager::ResourceManager() {
 
 	plRegisterConsoleCommand( "ListCachedResources",
 							  &ResourceManager::ListCachedResources,
-							  "List all cached resources." );
-	plRegisterConsoleCommand( "ClearModels", &ResourceManager::ClearModelsCommand, "Clears all cached models." );
+							  "List all cached resources, along with their memory and load times. "
+							  "Usage: ListCachedResources [memory|time|hits]" );
+	plRegisterConsoleCommand( "DumpResourceStats",
+							  &ResourceManager::DumpResourceStatsCommand,
+							  "Writes out all cached resources, along with their memory and load times, as Json. "
+							  "Usage: DumpResourceStats [path]" );
+	plRegisterConsoleCommand( "ClearModels", &ResourceManager::ClearModelsCommand, "Clears all unreferenced cached models." );
 	plRegisterConsoleCommand( "ClearTextures",
 							  &ResourceManager::ClearTexturesCommand,
-							  "Clears all cached textures." );
+							  "Clears all unreferenced cached textures." );
+	plRegisterConsoleCommand( "TextureCompressionBenchmark",
+							  &ResourceManager::TextureCompressionBenchmarkCommand,
+							  "Compresses an image as BC1 and BC3, reporting speed and quality. "
+							  "Usage: TextureCompressionBenchmark <image> [iterations]" );
+	plRegisterConsoleCommand( "ListResourceGroups",
+							  &ResourceManager::ListResourceGroupsCommand,
+							  "List all resource groups, along with how much they take up." );
+	plRegisterConsoleCommand( "ReleaseResourceGroup",
+							  &ResourceManager::ReleaseResourceGroupCommand,
+							  "Releases the given resource group. Usage: ReleaseResourceGroup <group>" );
+	plRegisterConsoleCommand( "PreloadManifestReport",
+							  &ResourceManager::PreloadManifestReportCommand,
+							  "Reports how much of what the current map has asked for was in its preload manifest." );
+	plRegisterConsoleCommand( "RegeneratePreloadManifest",
+							  &ResourceManager::RegeneratePreloadManifestCommand,
+							  "Replaces the current map's preload manifest with just what's asked for this time "
+							  "it's played, once it ends." );
+	plRegisterConsoleCommand( "ClearTextureCache",
+							  &ResourceManager::ClearTextureCacheCommand,
+							  "Removes decoded textures from the disk cache, least recently used first, "
+							  "until it fits within the given size, or all of them if none is given. "
+							  "Usage: ClearTextureCache [megabytes]" );
+	plRegisterConsoleCommand( "TextureCacheBenchmark",
+							  &ResourceManager::TextureCacheBenchmarkCommand,
+							  "Times reading in every image with the texture cache cold versus warm, emptying it first. "
+							  "Usage: TextureCacheBenchmark [directory]" );
 }
 
 ResourceManager::~ResourceManager() {
@@ -75,10 +113,403 @@ PLModel* ResourceManager::GetCachedModel( const std::string& path ) {
 	return nullptr;
 }
 
+/**
+ * Takes a reference on whatever's cached under the path,
+ * caching the given texture there first if nothing is yet.
+ */
+PLTexture* ResourceManager::CacheTexture( const std::string& path, PLTexture* texture_ptr, bool persist,
+										  const ResourceLoadTimes* times ) {
+	auto i = textures_.insert( std::make_pair( path, TextureHandle( texture_ptr, persist ) ) );
+	TextureHandle& handle = i.first->second;
+	handle.ref_count++;
+	handle.last_used = ++use_counter_;
+	handle.last_used_tick = g_state.sim_ticks;
+	handle.persist |= persist;
+	if ( !i.second ) {
+		handle.hit_count++;
+	} else if ( times != nullptr ) {
+		handle.load_times = *times;
+	}
+
+	// the fallback stands in under any number of paths, so there's no telling which is meant
+	if ( !current_group_.empty() && handle.texture_ptr != fallback_texture_ &&
+		groups_[ current_group_ ].textures.insert( path ).second ) {
+		handle.ref_count++;
+	}
+
+	// nor is it counted against the budget
+	if ( i.second && texture_ptr != fallback_texture_ ) {
+		texture_entries_[ texture_ptr ] = i.first;
+		handle.gpu_bytes = texture_ptr->size;
+		gpu_bytes_ += handle.gpu_bytes;
+		EvictToBudget();
+	}
+
+	return handle.texture_ptr;
+}
+
+static size_t GetModelSize( const PLModel* model ) {
+	size_t bytes = 0;
+	for ( unsigned int i = 0; i < model->num_levels; ++i ) {
+		for ( unsigned int j = 0; j < model->levels[ i ].num_meshes; ++j ) {
+			const PLMesh* mesh = model->levels[ i ].meshes[ j ];
+			bytes += mesh->num_verts * sizeof( PLVertex ) + mesh->num_indices * sizeof( *mesh->indices );
+		}
+	}
+
+	return bytes;
+}
+
+PLModel* ResourceManager::CacheModel( const std::string& path, PLModel* model_ptr, bool persist,
+									  const ResourceLoadTimes* times ) {
+	auto i = models_.insert( std::make_pair( path, ModelHandle( model_ptr, persist ) ) );
+	ModelHandle& handle = i.first->second;
+	handle.ref_count++;
+	handle.last_used = ++use_counter_;
+	handle.last_used_tick = g_state.sim_ticks;
+	handle.persist |= persist;
+	if ( !i.second ) {
+		handle.hit_count++;
+	} else if ( times != nullptr ) {
+		handle.load_times = *times;
+	}
+
+	if ( !current_group_.empty() && handle.model_ptr != fallback_model_ &&
+		groups_[ current_group_ ].models.insert( path ).second ) {
+		handle.ref_count++;
+	}
+
+	// meshes keep hold of their vertices after uploading them, so they take up the same on both
+	if ( i.second && model_ptr != fallback_model_ ) {
+		model_entries_[ model_ptr ] = i.first;
+		handle.cpu_bytes = handle.gpu_bytes = GetModelSize( model_ptr );
+		cpu_bytes_ += handle.cpu_bytes;
+		gpu_bytes_ += handle.gpu_bytes;
+		EvictToBudget();
+	}
+
+	return handle.model_ptr;
+}
+
+void ResourceManager::Release( PLTexture* texture ) {
+	if ( texture == nullptr || texture == fallback_texture_ ) {
+		return;
+	}
+
+	auto entry = texture_entries_.find( texture );
+	if ( entry == texture_entries_.end() ) {
+		return;
+	}
+
+	auto i = entry->second;
+	u_assert( i->second.ref_count > 0, "Texture \"%s\" released more times than it was loaded!\n", i->first.c_str() );
+	if ( i->second.ref_count > 0 && --i->second.ref_count == 0 ) {
+		i->second.last_used = ++use_counter_;
+		EvictToBudget();
+	}
+}
+
+void ResourceManager::Release( PLModel* model ) {
+	if ( model == nullptr || model == fallback_model_ ) {
+		return;
+	}
+
+	auto entry = model_entries_.find( model );
+	if ( entry == model_entries_.end() ) {
+		return;
+	}
+
+	auto i = entry->second;
+	u_assert( i->second.ref_count > 0, "Model \"%s\" released more times than it was loaded!\n", i->first.c_str() );
+	if ( i->second.ref_count > 0 && --i->second.ref_count == 0 ) {
+		i->second.last_used = ++use_counter_;
+		EvictToBudget();
+	}
+}
+
+/**
+ * Drops the entry from the cache, along with everything kept about it
+ * elsewhere, leaving destroying whatever it held up to the caller.
+ */
+ResourceManager::TextureMap::iterator ResourceManager::UncacheTexture( TextureMap::iterator texture ) {
+	if ( texture->second.texture_ptr != fallback_texture_ ) {
+		texture_entries_.erase( texture->second.texture_ptr );
+	}
+	cpu_bytes_ -= texture->second.cpu_bytes;
+	gpu_bytes_ -= texture->second.gpu_bytes;
+	return textures_.erase( texture );
+}
+
+ResourceManager::ModelMap::iterator ResourceManager::UncacheModel( ModelMap::iterator model ) {
+	if ( model->second.model_ptr != fallback_model_ ) {
+		model_entries_.erase( model->second.model_ptr );
+	}
+	cpu_bytes_ -= model->second.cpu_bytes;
+	gpu_bytes_ -= model->second.gpu_bytes;
+	return models_.erase( model );
+}
+
+size_t ResourceManager::GetCPUBytes() const {
+	return cpu_bytes_;
+}
+
+size_t ResourceManager::GetGPUBytes() const {
+	return gpu_bytes_;
+}
+
+/**
+ * Destroys whichever unreferenced, non-persistent, resource was used least
+ * recently, until everything cached fits within the budget again.
+ */
+void ResourceManager::EvictToBudget() {
+	size_t budget = static_cast<size_t>( std::max( cv_graphics_resource_budget->i_value, 0 ) ) * 1024;
+	size_t total = GetCPUBytes() + GetGPUBytes();
+	while ( total > budget ) {
+		auto texture = textures_.end();
+		for ( auto i = textures_.begin(); i != textures_.end(); ++i ) {
+			if ( i->second.ref_count > 0 || i->second.persist || i->second.texture_ptr == fallback_texture_ ) {
+				continue;
+			}
+
+			if ( texture == textures_.end() || i->second.last_used < texture->second.last_used ) {
+				texture = i;
+			}
+		}
+
+		auto model = models_.end();
+		for ( auto i = models_.begin(); i != models_.end(); ++i ) {
+			if ( i->second.ref_count > 0 || i->second.persist || i->second.model_ptr == fallback_model_ ) {
+				continue;
+			}
+
+			if ( model == models_.end() || i->second.last_used < model->second.last_used ) {
+				model = i;
+			}
+		}
+
+		if ( texture != textures_.end() &&
+			( model == models_.end() || texture->second.last_used < model->second.last_used ) ) {
+			LogDebug( "Evicting texture \"%s\" (%ukb)\n", texture->first.c_str(),
+					  static_cast<unsigned int>( plBytesToKilobytes( texture->second.gpu_bytes ) ) );
+			total -= texture->second.gpu_bytes;
+			plDestroyTexture( texture->second.texture_ptr );
+			UncacheTexture( texture );
+		} else if ( model != models_.end() ) {
+			size_t bytes = model->second.cpu_bytes + model->second.gpu_bytes;
+			LogDebug( "Evicting model \"%s\" (%ukb)\n", model->first.c_str(),
+					  static_cast<unsigned int>( plBytesToKilobytes( bytes ) ) );
+			total -= bytes;
+			plDestroyModel( model->second.model_ptr );
+			UncacheModel( model );
+		} else {
+			// everything left is still in use
+			break;
+		}
+	}
+}
+
+bool ResourceManager::IsTextureCompressionSupported() {
+	static const bool is_s3tc_supported = System_IsGLExtensionSupported( "GL_EXT_texture_compression_s3tc" );
+	return is_s3tc_supported;
+}
+
+/**
+ * Adds however long it's around for onto one of the load times, or
+ * does nothing at all without any, so it costs nothing while disabled.
+ */
+class ScopedLoadTimer {
+public:
+	ScopedLoadTimer( ResourceLoadTimes* times, double ResourceLoadTimes::* stage ) : times_( times ), stage_( stage ) {
+		if ( times_ != nullptr ) {
+			start_ = std::chrono::steady_clock::now();
+		}
+	}
+	~ScopedLoadTimer() {
+		if ( times_ != nullptr ) {
+			times_->*stage_ += std::chrono::duration<double, std::milli>( std::chrono::steady_clock::now() - start_ ).count();
+		}
+	}
+
+private:
+	ResourceLoadTimes* times_;
+	double ResourceLoadTimes::* stage_;
+	std::chrono::steady_clock::time_point start_;
+};
+
+// main thread only, as it's down to a cvar
+static ResourceLoadTimes* GetLoadTimes( ResourceLoadTimes* times ) {
+	return cv_debug_resource_stats->b_value ? times : nullptr;
+}
+
+/**
+ * Reads in a block compressed image written out by the extractor. Where the driver
+ * can't take the blocks as they are, they're decoded back out to RGBA8 instead, so
+ * the textures still work without S3TC. Safe to call from any thread.
+ */
+static bool LoadCompressedImage( const char* path, bool decode, ResourceLoadTimes* times, PLImage* image ) {
+	DxtHandle* handle;
+	{
+		ScopedLoadTimer timer( times, &ResourceLoadTimes::io );
+		if ( ( handle = Dxt_LoadFile( path ) ) == nullptr ) {
+			return false;
+		}
+	}
+
+	memset( image, 0, sizeof( PLImage ) );
+	image->width = handle->width;
+	image->height = handle->height;
+	image->levels = handle->num_levels;
+	image->colour_format = PL_COLOURFORMAT_RGBA;
+	strncpy( image->path, path, sizeof( image->path ) - 1 );
+
+	// the image takes over the levels, so they're free'd along with it
+	ScopedLoadTimer timer( times, &ResourceLoadTimes::decode );
+	image->data = static_cast<uint8_t**>( u_alloc( handle->num_levels, sizeof( uint8_t* ), true ) );
+	for ( unsigned int i = 0; i < handle->num_levels; ++i ) {
+		if ( !decode ) {
+			image->data[ i ] = handle->levels[ i ];
+			handle->levels[ i ] = nullptr;
+			continue;
+		}
+
+		unsigned int w = std::max( handle->width >> i, 1u ), h = std::max( handle->height >> i, 1u );
+		image->data[ i ] = static_cast<uint8_t*>( u_alloc( w * h, 4, true ) );
+		Dxt_DecodeImage( handle->format, handle->levels[ i ], w, h, image->data[ i ] );
+	}
+
+	if ( decode ) {
+		image->format = PL_IMAGEFORMAT_RGBA8;
+		image->size = handle->width * handle->height * 4;
+	} else {
+		image->format = ( handle->format == DXT_FORMAT_BC1 ) ? PL_IMAGEFORMAT_RGBA_DXT1 : PL_IMAGEFORMAT_RGBA_DXT5;
+		image->size = Dxt_GetLevelSize( handle->format, handle->width, handle->height );
+	}
+
+	Dxt_DestroyHandle( handle );
+
+	return true;
+}
+
+// main thread only, as it's down to a cvar
+static size_t GetTextureCacheSize() {
+	return static_cast<size_t>( std::max( cv_graphics_texture_cache_size->i_value, 0 ) ) * 1024 * 1024;
+}
+
+/**
+ * Reads in the image at the given path, which must have an extension,
+ * ready to be uploaded. Anything decoded is kept in the texture cache, unless
+ * cache_size is 0, so it's not decoded again. Safe to call from any thread.
+ */
+static bool ReadTextureImage( const std::string& path, bool decode, size_t cache_size, ResourceLoadTimes* times,
+							  PLImage* image ) {
+	const char* ext = plGetFileExtension( path.c_str() );
+	if ( pl_strncasecmp( ext, "dxt", 3 ) == 0 ) {
+		return LoadCompressedImage( path.c_str(), decode, times, image );
+	}
+
+	uint64_t key = 0;
+	if ( cache_size > 0 ) {
+		ScopedLoadTimer timer( times, &ResourceLoadTimes::io );
+		key = TextureCache_GetKey( path.c_str() );
+		if ( key != 0 && TextureCache_Read( key, image ) ) {
+			strncpy( image->path, path.c_str(), sizeof( image->path ) - 1 );
+			return true;
+		}
+	}
+
+	{
+		// the platform library reads the file in as it decodes it, so that's counted here too
+		ScopedLoadTimer timer( times, &ResourceLoadTimes::decode );
+		if ( !plLoadImage( path.c_str(), image ) ) {
+			return false;
+		}
+
+		// pixel format of TIM will be changed before uploading
+		if ( pl_strncasecmp( ext, "tim", 3 ) == 0 ) {
+			plConvertPixelFormat( image, PL_IMAGEFORMAT_RGBA8 );
+		}
+	}
+
+	if ( key != 0 ) {
+		ScopedLoadTimer timer( times, &ResourceLoadTimes::io );
+		TextureCache_Write( key, image, cache_size );
+	}
+
+	return true;
+}
+
+static PLTexture* CreateTextureFromImage( const PLImage* image, PLTextureFilter filter, ResourceLoadTimes* times ) {
+	ScopedLoadTimer timer( times, &ResourceLoadTimes::upload );
+	PLTexture* texture = plCreateTexture();
+	if ( texture == nullptr ) {
+		return nullptr;
+	}
+
+	texture->filter = filter;
+	if ( !plUploadTextureImage( texture, image ) ) {
+		plDestroyTexture( texture );
+		return nullptr;
+	}
+
+	return texture;
+}
+
+/**
+ * Same as u_find2, for anything off the main thread, since that hands back a shared buffer.
+ * Block compressed copies written out by the extractor take priority, where wanted.
+ */
+static std::string FindResourcePath( const std::string& path, const char** preference, bool compressed = false ) {
+	if ( !plIsEmptyString( plGetFileExtension( path.c_str() ) ) ) {
+		return plFileExists( path.c_str() ) ? path : "";
+	}
+
+	if ( compressed && plFileExists( ( path + ".dxt" ).c_str() ) ) {
+		return path + ".dxt";
+	}
+
+	for ( ; *preference != nullptr; ++preference ) {
+		std::string fp = path + "." + *preference;
+		if ( plFileExists( fp.c_str() ) ) {
+			return fp;
+		}
+	}
+
+	return "";
+}
+
 PLTexture* ResourceManager::LoadTexture( const std::string& path, PLTextureFilter filter, bool persist,
 										 bool abort_on_fail ) {
+	if ( !session_map_.empty() ) {
+		session_requests_.textures.insert( std::make_pair( path, filter ) );
+	}
+
+	ResourceLoadTimes load_times;
+	ResourceLoadTimes* times = GetLoadTimes( &load_times );
+
 	const char* ext = plGetFileExtension( path.c_str() );
 	if ( plIsEmptyString( ext ) ) {
+		// block compressed copies written out by the extractor take priority
+		if ( cv_graphics_texture_compression->b_value ) {
+			std::string dxt_path = path + ".dxt";
+			if ( plFileExists( dxt_path.c_str() ) ) {
+				PLTexture* texture = GetCachedTexture( dxt_path );
+				if ( texture != nullptr ) {
+					return CacheTexture( dxt_path, texture, persist );
+				}
+
+				PLImage image;
+				if ( LoadCompressedImage( dxt_path.c_str(), !IsTextureCompressionSupported(), times, &image ) ) {
+					texture = CreateTextureFromImage( &image, filter, times );
+					plFreeImage( &image );
+					if ( texture != nullptr ) {
+						return CacheTexture( dxt_path, texture, persist, times );
+					}
+				}
+
+				LogWarn( "Failed to load \"%s\", falling back to uncompressed image!\n", dxt_path.c_str() );
+			}
+		}
+
 		const char* fp = u_find2( path.c_str(), supported_image_formats, abort_on_fail );
 		if ( fp == nullptr ) {
 			return CacheTexture( path, GetFallbackTexture(), persist );
@@ -86,42 +517,40 @@ PLTexture* ResourceManager::LoadTexture( const std::string& path, PLTextureFilte
 
 		PLTexture* texture = GetCachedTexture( fp );
 		if ( texture != nullptr ) {
-			return texture;
+			return CacheTexture( fp, texture, persist );
 		}
 
-		texture = plLoadTextureFromImage( fp, filter );
-		if ( texture != nullptr ) {
-			return CacheTexture( fp, texture, persist );;
+		// u_find2's buffer may be reused by anything loaded from here
+		std::string image_path = fp;
+		PLImage image;
+		if ( ReadTextureImage( image_path, !IsTextureCompressionSupported(), GetTextureCacheSize(), times, &image ) ) {
+			texture = CreateTextureFromImage( &image, filter, times );
+			plFreeImage( &image );
+			if ( texture != nullptr ) {
+				return CacheTexture( image_path, texture, persist, times );
+			}
 		}
 
 		if ( abort_on_fail ) {
-			Error( "Failed to load texture, \"%s\" (%s)!\n", fp, plGetError() );
+			Error( "Failed to load texture, \"%s\" (%s)!\n", image_path.c_str(), plGetError() );
 		}
 
 		LogWarn( "%s, aborting!\n", plGetError() );
-		return CacheTexture( fp, GetFallbackTexture(), persist );
+		return CacheTexture( image_path, GetFallbackTexture(), persist );
 	}
 
 	PLTexture* texture = GetCachedTexture( path );
 	if ( texture != nullptr ) {
-		return texture;
+		return CacheTexture( path, texture, persist );
 	}
 
 	PLImage img;
-	if ( plLoadImage( path.c_str(), &img ) ) {
-		// pixel format of TIM will be changed before uploading
-		if ( pl_strncasecmp( ext, "tim", 3 ) == 0 ) {
-			plConvertPixelFormat( &img, PL_IMAGEFORMAT_RGBA8 );
-		}
-
-		texture = plCreateTexture();
+	if ( ReadTextureImage( path, !IsTextureCompressionSupported(), GetTextureCacheSize(), times, &img ) ) {
+		texture = CreateTextureFromImage( &img, filter, times );
+		plFreeImage( &img );
 		if ( texture != nullptr ) {
-			texture->filter = filter;
-			if ( plUploadTextureImage( texture, &img ) ) {
-				return CacheTexture( path, texture, persist );
-			}
+			return CacheTexture( path, texture, persist, times );
 		}
-		plDestroyTexture( texture );
 	}
 
 	if ( abort_on_fail ) {
@@ -129,12 +558,15 @@ PLTexture* ResourceManager::LoadTexture( const std::string& path, PLTextureFilte
 	}
 
 	LogWarn( "Failed to load texture, \"%s\" (%s)!\n", path.c_str(), plGetError() );
-	plFreeImage( &img );
 
 	return CacheTexture( path, GetFallbackTexture(), persist );
 }
 
 PLModel* ResourceManager::LoadModel( const std::string& path, bool persist, bool abort_on_fail ) {
+	if ( !session_map_.empty() ) {
+		session_requests_.models.insert( path );
+	}
+
 	const char* fp = u_find2( path.c_str(), supported_model_formats, abort_on_fail );
 	if ( fp == nullptr ) {
 		return CacheModel( path, GetFallbackModel(), persist );
@@ -142,10 +574,15 @@ PLModel* ResourceManager::LoadModel( const std::string& path, bool persist, bool
 
 	PLModel* model = GetCachedModel( fp );
 	if ( model != nullptr ) {
-		return model;
+		return CacheModel( fp, model, persist );
 	}
 
-	model = plLoadModel( fp );
+	ResourceLoadTimes load_times;
+	ResourceLoadTimes* times = GetLoadTimes( &load_times );
+	{
+		ScopedLoadTimer timer( times, &ResourceLoadTimes::upload );
+		model = plLoadModel( fp );
+	}
 	if ( model == nullptr ) {
 		if ( abort_on_fail ) {
 			Error( "Failed to load model, \"%s\" (%s)!\n", fp, plGetError() );
@@ -155,129 +592,1217 @@ PLModel* ResourceManager::LoadModel( const std::string& path, bool persist, bool
 		return CacheModel( fp, GetFallbackModel(), persist );
 	}
 
-	return CacheModel( fp, model, persist );
+	return CacheModel( fp, model, persist, times );
 }
 
-PLTexture* ResourceManager::GetFallbackTexture() {
-	if ( fallback_texture_ != nullptr ) {
-		return fallback_texture_;
+/************************************************************/
+/* Async Loading */
+
+/**
+ * Everything from file I/O through to decoding happens on a worker, which fills
+ * in the second half of this before flagging it as ready; the upload is left for
+ * the main thread to pick up within its budget in ProcessPendingLoads.
+ */
+struct ResourceManager::PendingLoad {
+	// always created on the main thread, so it's safe to check the cvar here
+	PendingLoad( const std::string& path, bool persist ) :
+		path( path ), persist( persist ), record_times( cv_debug_resource_stats->b_value ) {}
+	~PendingLoad() {
+		if ( has_image ) {
+			plFreeImage( &image );
+		}
+		Vtx_DestroyHandle( vtx );
+		Fac_DestroyHandle( fac );
 	}
 
-	PLColour pbuffer[] = {
-		{ 255, 255, 0, 255 }, { 0, 255, 255, 255 },
-		{ 0, 255, 255, 255 }, { 255, 255, 0, 255 } };
-	PLImage* image = plCreateImage( ( uint8_t* ) pbuffer, 2, 2, PL_COLOURFORMAT_RGBA, PL_IMAGEFORMAT_RGBA8 );
-	if ( image != nullptr ) {
-		fallback_texture_ = plCreateTexture();
-		fallback_texture_->flags &= PL_TEXTURE_FLAG_NOMIPS;
-		if ( !plUploadTextureImage( fallback_texture_, image ) ) {
-			Error( "Failed to upload default texture (%s)!\n", plGetError() );
+	std::string path;
+	bool persist;
+	PLTextureFilter filter{ PL_TEXTURE_FILTER_MIPMAP_NEAREST };
+	AsyncTexture texture;
+	AsyncModel model;
+	// in place of a handle, for anything being preloaded into a group
+	std::string group;
+	bool is_model{ false };
+
+	std::atomic<bool> ready{ false };
+	std::string fp; // empty if nothing was found
+	PLImage image;
+	bool has_image{ false };
+	VtxHandle* vtx{ nullptr };
+	FacHandle* fac{ nullptr };
+
+	bool record_times;
+	ResourceLoadTimes load_times;
+	ResourceLoadTimes* GetTimes() { return record_times ? &load_times : nullptr; }
+
+	void ReadTexture( bool decode, size_t cache_size ) {
+		if ( !fp.empty() ) {
+			has_image = ReadTextureImage( fp, decode, cache_size, GetTimes(), &image );
 		}
-		plFreeImage( image );
-	} else {
-		Error( "Failed to generate default texture (%s)!\n", plGetError() );
 	}
 
-	return fallback_texture_;
-}
+	// only Vtx can be read in ahead of time, anything else is loaded whole on upload
+	void ReadModel() {
+		if ( !fp.empty() && pl_strncasecmp( plGetFileExtension( fp.c_str() ), "vtx", 3 ) == 0 ) {
+			ScopedLoadTimer timer( GetTimes(), &ResourceLoadTimes::io );
+			Model_LoadVtxData( fp.c_str(), &vtx, &fac );
+		}
+	}
+};
 
-PLModel* ResourceManager::GetFallbackModel() {
-	if ( fallback_model_ != nullptr ) {
-		return fallback_model_;
+AsyncTexture ResourceManager::LoadTextureAsync( const std::string& path, PLTextureFilter filter, bool persist ) {
+	if ( !session_map_.empty() ) {
+		session_requests_.textures.insert( std::make_pair( path, filter ) );
 	}
 
-	PLMesh* mesh = plCreateMesh( PL_MESH_LINES, PL_DRAW_DYNAMIC, 0, 6 );
-	plSetMeshVertexPosition( mesh, 0, PLVector3( 0, 20, 0 ) );
-	plSetMeshVertexPosition( mesh, 1, PLVector3( 0, -20, 0 ) );
-	plSetMeshVertexPosition( mesh, 2, PLVector3( 20, 0, 0 ) );
-	plSetMeshVertexPosition( mesh, 3, PLVector3( -20, 0, 0 ) );
-	plSetMeshVertexPosition( mesh, 4, PLVector3( 0, 0, 20 ) );
-	plSetMeshVertexPosition( mesh, 5, PLVector3( 0, 0, -20 ) );
-	plSetMeshUniformColour( mesh, PLColour( 255, 0, 0, 255 ) );
+	auto pending = pending_textures_.find( path );
+	if ( pending != pending_textures_.end() ) {
+		return pending->second;
+	}
 
-	ShaderProgram* shaderProgram = Shaders_GetProgram( "generic_untextured" );
-	if ( shaderProgram == nullptr ) {
-		Error( "Failed to get default shader program, \"generic_untextured\"!\n" );
+	AsyncTexture handle = std::make_shared<AsyncResource<PLTexture>>( this, GetFallbackTexture() );
+	std::shared_ptr<PendingLoad> load = std::make_shared<PendingLoad>( path, persist );
+	load->filter = filter;
+	load->texture = handle;
+	load->fp = FindResourcePath( path, supported_image_formats, cv_graphics_texture_compression->b_value );
+
+	// anything that's either cached already or missing is handed back ready
+	if ( load->fp.empty() || textures_.find( load->fp ) != textures_.end() ) {
+		FinishLoad( load.get() );
+		return handle;
 	}
 
-	// todo: kill this api, if we rebuild shader cache we'll die
-	plSetMeshShaderProgram( mesh, shaderProgram->GetInternalProgram() );
-	plUploadMesh( mesh );
+	pending_loads_.push_back( load );
+	pending_textures_.insert( std::make_pair( path, handle ) );
+	num_loads_queued_++;
 
-	return ( fallback_model_ = plCreateBasicStaticModel( mesh ) );
+	// cvars and the driver are only looked at from here
+	bool decode = !IsTextureCompressionSupported();
+	size_t cache_size = GetTextureCacheSize();
+	Engine::Jobs()->Submit( [ load, decode, cache_size ]() {
+		load->ReadTexture( decode, cache_size );
+		load->ready = true;
+	} );
+
+	return handle;
 }
 
-void ResourceManager::ClearTextures( bool force ) {
-	if ( textures_.empty() ) {
-		return;
+AsyncModel ResourceManager::LoadModelAsync( const std::string& path, bool persist ) {
+	if ( !session_map_.empty() ) {
+		session_requests_.models.insert( path );
 	}
 
-	for ( auto& i : textures_ ) {
-		if ( ( i.second.persist && !force )
-			|| ( fallback_texture_ != nullptr && i.second.texture_ptr == fallback_texture_ ) ) {
-			continue;
-		}
+	auto pending = pending_models_.find( path );
+	if ( pending != pending_models_.end() ) {
+		return pending->second;
+	}
 
-		plDestroyTexture( i.second.texture_ptr );
+	AsyncModel handle = std::make_shared<AsyncResource<PLModel>>( this, GetFallbackModel() );
+	std::shared_ptr<PendingLoad> load = std::make_shared<PendingLoad>( path, persist );
+	load->model = handle;
+	load->is_model = true;
+	load->fp = FindResourcePath( path, supported_model_formats );
+
+	if ( load->fp.empty() || models_.find( load->fp ) != models_.end() ) {
+		FinishLoad( load.get() );
+		return handle;
 	}
 
-	if ( force ) {
-		textures_.clear();
+	pending_loads_.push_back( load );
+	pending_models_.insert( std::make_pair( path, handle ) );
+	num_loads_queued_++;
+
+	Engine::Jobs()->Submit( [ load ]() {
+		load->ReadModel();
+		load->ready = true;
+	} );
+
+	return handle;
+}
+
+/**
+ * Uploads whatever was read in for the load, if it's not already cached,
+ * handing back the cached resource with a reference taken on it.
+ */
+PLTexture* ResourceManager::FinishTextureLoad( PendingLoad* load ) {
+	if ( load->fp.empty() ) {
+		LogWarn( "Failed to find \"%s\"!\n", load->path.c_str() );
+		return CacheTexture( load->path, GetFallbackTexture(), load->persist );
+	}
+
+	PLTexture* texture = GetCachedTexture( load->fp );
+	if ( texture == nullptr && load->has_image ) {
+		texture = CreateTextureFromImage( &load->image, load->filter, load->GetTimes() );
+		if ( texture == nullptr ) {
+			LogWarn( "Failed to load texture, \"%s\" (%s)!\n", load->fp.c_str(), plGetError() );
+		}
 	}
+
+	return CacheTexture( load->fp, texture != nullptr ? texture : GetFallbackTexture(), load->persist,
+						 load->GetTimes() );
 }
 
-void ResourceManager::ClearModels( bool force ) {
-	if ( models_.empty() ) {
-		return;
+PLModel* ResourceManager::FinishModelLoad( PendingLoad* load ) {
+	if ( load->fp.empty() ) {
+		LogWarn( "Failed to find \"%s\"!\n", load->path.c_str() );
+		return CacheModel( load->path, GetFallbackModel(), load->persist );
 	}
 
-	for ( auto i = models_.begin(); i != models_.end(); ) {
-		if ( ( i->second.persist && !force )
-			|| ( fallback_model_ != nullptr && i->second.model_ptr == fallback_model_ ) ) {
-			++i;
-			continue;
+	PLModel* model = GetCachedModel( load->fp );
+	if ( model == nullptr ) {
+		ScopedLoadTimer timer( load->GetTimes(), &ResourceLoadTimes::upload );
+		if ( load->vtx != nullptr ) {
+			model = Model_CreateVtxModel( load->fp.c_str(), load->vtx, load->fac );
+			load->vtx = nullptr;
+			load->fac = nullptr;
+		} else if ( pl_strncasecmp( plGetFileExtension( load->fp.c_str() ), "vtx", 3 ) != 0 ) {
+			model = plLoadModel( load->fp.c_str() );
 		}
 
-		plDestroyModel( i->second.model_ptr );
-		i = models_.erase(i);
+		if ( model == nullptr ) {
+			LogWarn( "Failed to load model, \"%s\" (%s)!\n", load->fp.c_str(), plGetError() );
+		}
 	}
+
+	return CacheModel( load->fp, model != nullptr ? model : GetFallbackModel(), load->persist, load->GetTimes() );
 }
 
-void ResourceManager::ClearAll() {
-	ClearModels();
-	ClearTextures();
+void ResourceManager::FinishLoad( PendingLoad* load ) {
+	if ( !load->group.empty() ) {
+		if ( load->is_model ) {
+			FinishModelLoad( load );
+		} else {
+			FinishTextureLoad( load );
+		}
+		AdoptIntoGroup( load->group, load );
+		return;
+	}
+
+	// the handle holds onto its own reference from here
+	if ( load->texture != nullptr ) {
+		pending_textures_.erase( load->path );
+		load->texture->resource_ = FinishTextureLoad( load );
+		load->texture->ready_ = true;
+		return;
+	}
+
+	pending_models_.erase( load->path );
+	load->model->resource_ = FinishModelLoad( load );
+	load->model->ready_ = true;
 }
 
-void ResourceManager::ListCachedResources( unsigned int argc, char** argv ) {
-	u_unused( argc );
-	u_unused( argv );
+/**
+ * Uploads whatever the workers have finished with, in the order it was asked
+ * for, until the frame's budget runs out. At least one is always uploaded, so
+ * the queue keeps moving however large each resource is.
+ */
+void ResourceManager::ProcessPendingLoads() {
+	auto start = std::chrono::steady_clock::now();
+	double budget = cv_graphics_upload_budget->f_value;
+	for ( auto i = pending_loads_.begin(); i != pending_loads_.end(); ) {
+		if ( !( *i )->ready ) {
+			++i;
+			continue;
+		}
 
-	LogInfo( "Printing cache...\n" );
+		FinishLoad( i->get() );
+		i = pending_loads_.erase( i );
+		num_loads_finished_++;
 
-	for ( auto const& i : Engine::Resource()->models_ ) {
-		LogInfo( " model %s / %s : name(%s)\n", i.first.c_str(), i.second.persist ? "true" : "false",
-				 i.second.model_ptr->name );
+		if ( std::chrono::duration<double, std::milli>( std::chrono::steady_clock::now() - start ).count() >= budget ) {
+			break;
+		}
 	}
 
-	unsigned int tsize = 0;
-	for ( auto const& i : Engine::Resource()->textures_ ) {
-		LogInfo( " texture %s / %s : name(%s)\n", i.first.c_str(), i.second.persist ? "true" : "false",
-				 i.second.texture_ptr->name );
-		tsize += i.second.texture_ptr->size;
+	if ( pending_loads_.empty() ) {
+		num_loads_queued_ = num_loads_finished_ = 0;
 	}
-	LogInfo( "Texture Memory: %dkb\n", plBytesToKilobytes( tsize ) );
 }
 
-void ResourceManager::ClearTexturesCommand( unsigned int argc, char** argv ) {
-	u_unused( argc );
-	u_unused( argv );
+uint8_t ResourceManager::GetLoadProgress() const {
+	if ( num_loads_queued_ == 0 ) {
+		return 100;
+	}
 
-	Engine::Resource()->ClearTextures();
+	return static_cast<uint8_t>( ( num_loads_finished_ * 100 ) / num_loads_queued_ );
 }
 
-void ResourceManager::ClearModelsCommand( unsigned int argc, char** argv ) {
-	u_unused( argc );
-	u_unused( argv );
+/************************************************************/
+/* Resource Groups */
+
+void ResourceManager::AddToGroup( const std::string& group, PLTexture* texture ) {
+	// the fallback stands in under any number of paths, so there's no telling which is meant
+	if ( texture == nullptr || texture == fallback_texture_ ) {
+		return;
+	}
+
+	for ( auto& i : textures_ ) {
+		if ( i.second.texture_ptr != texture ) {
+			continue;
+		}
+
+		if ( groups_[ group ].textures.insert( i.first ).second ) {
+			i.second.ref_count++;
+			i.second.last_used = ++use_counter_;
+		}
+		return;
+	}
+
+	LogWarn( "Texture \"%s\" isn't cached, so can't be added to group \"%s\"!\n", texture->name, group.c_str() );
+}
+
+void ResourceManager::AddToGroup( const std::string& group, PLModel* model ) {
+	if ( model == nullptr || model == fallback_model_ ) {
+		return;
+	}
+
+	for ( auto& i : models_ ) {
+		if ( i.second.model_ptr != model ) {
+			continue;
+		}
+
+		if ( groups_[ group ].models.insert( i.first ).second ) {
+			i.second.ref_count++;
+			i.second.last_used = ++use_counter_;
+		}
+		return;
+	}
+
+	LogWarn( "Model \"%s\" isn't cached, so can't be added to group \"%s\"!\n", model->name, group.c_str() );
+}
+
+/**
+ * Everything loaded from here until EndGroup, by whichever means, is also added
+ * into the group, such as everything loaded in for the map that's being played.
+ */
+void ResourceManager::BeginGroup( const std::string& group ) {
+	u_assert( current_group_.empty(), "Began group \"%s\" while still in \"%s\"!\n", group.c_str(), current_group_.c_str() );
+	current_group_ = group;
+}
+
+void ResourceManager::EndGroup() {
+	current_group_.clear();
+}
+
+/**
+ * Loads everything given into the group. Whatever isn't cached yet is read in
+ * across the workers all at once, rather than one file after another, and then
+ * uploaded here in the order given, so this blocks until everything is loaded.
+ */
+void ResourceManager::PreloadGroup( const std::string& group,
+									const std::vector<std::string>& textures, const std::vector<std::string>& models,
+									PLTextureFilter filter ) {
+	bool compressed = cv_graphics_texture_compression->b_value;
+	bool decode = !IsTextureCompressionSupported();
+	size_t cache_size = GetTextureCacheSize();
+
+	// textures first, followed by the models
+	std::vector<std::unique_ptr<PendingLoad>> loads;
+	loads.reserve( textures.size() + models.size() );
+	for ( const auto& path : textures ) {
+		loads.emplace_back( new PendingLoad( path, false ) );
+		loads.back()->filter = filter;
+		loads.back()->fp = FindResourcePath( path, supported_image_formats, compressed );
+	}
+	for ( const auto& path : models ) {
+		loads.emplace_back( new PendingLoad( path, false ) );
+		loads.back()->is_model = true;
+		loads.back()->fp = FindResourcePath( path, supported_model_formats );
+	}
+
+	std::vector<char> needs_read( loads.size(), 0 );
+	for ( size_t i = 0; i < loads.size(); ++i ) {
+		const std::string& fp = loads[ i ]->fp;
+		if ( fp.empty() ) {
+			continue;
+		}
+
+		needs_read[ i ] = loads[ i ]->is_model ? ( models_.find( fp ) == models_.end() )
+											   : ( textures_.find( fp ) == textures_.end() );
+	}
+
+	auto start = std::chrono::steady_clock::now();
+	auto read = [ &loads, &needs_read, decode, cache_size ]( unsigned int i ) {
+		if ( !needs_read[ i ] ) {
+			return;
+		}
+
+		if ( loads[ i ]->is_model ) {
+			loads[ i ]->ReadModel();
+		} else {
+			loads[ i ]->ReadTexture( decode, cache_size );
+		}
+	};
+	Engine::Jobs()->ParallelFor( static_cast<unsigned int>( loads.size() ), read );
+	double read_ms = std::chrono::duration<double, std::milli>( std::chrono::steady_clock::now() - start ).count();
+
+	for ( const auto& load : loads ) {
+		if ( load->is_model ) {
+			FinishModelLoad( load.get() );
+		} else {
+			FinishTextureLoad( load.get() );
+		}
+		AdoptIntoGroup( group, load.get() );
+	}
+
+	LogInfo( "Preloaded %u textures and %u models into \"%s\" (%u read in %.2fms, %.2fms total)\n",
+			 static_cast<unsigned int>( textures.size() ), static_cast<unsigned int>( models.size() ), group.c_str(),
+			 static_cast<unsigned int>( std::count( needs_read.begin(), needs_read.end(), 1 ) ), read_ms,
+			 std::chrono::duration<double, std::milli>( std::chrono::steady_clock::now() - start ).count() );
+}
+
+/**
+ * Same as PreloadGroup, only anything that isn't cached yet is read in on the workers in
+ * the background and uploaded through ProcessPendingLoads, joining the group as it does.
+ */
+void ResourceManager::PreloadGroupAsync( const std::string& group,
+										 const std::vector<std::string>& textures, const std::vector<std::string>& models,
+										 PLTextureFilter filter ) {
+	bool compressed = cv_graphics_texture_compression->b_value;
+	bool decode = !IsTextureCompressionSupported();
+	size_t cache_size = GetTextureCacheSize();
+
+	std::vector<std::shared_ptr<PendingLoad>> loads;
+	for ( const auto& path : textures ) {
+		std::shared_ptr<PendingLoad> load = std::make_shared<PendingLoad>( path, false );
+		load->group = group;
+		load->filter = filter;
+		load->fp = FindResourcePath( path, supported_image_formats, compressed );
+		loads.push_back( load );
+	}
+	for ( const auto& path : models ) {
+		std::shared_ptr<PendingLoad> load = std::make_shared<PendingLoad>( path, false );
+		load->group = group;
+		load->is_model = true;
+		load->fp = FindResourcePath( path, supported_model_formats );
+		loads.push_back( load );
+	}
+
+	for ( const auto& load : loads ) {
+		// nothing to wait on for anything that's either cached already or missing
+		bool cached = load->is_model ? ( models_.find( load->fp ) != models_.end() )
+									 : ( textures_.find( load->fp ) != textures_.end() );
+		if ( cached || load->fp.empty() ) {
+			FinishLoad( load.get() );
+			continue;
+		}
+
+		pending_loads_.push_back( load );
+		num_loads_queued_++;
+
+		Engine::Jobs()->Submit( [ load, decode, cache_size ]() {
+			if ( load->is_model ) {
+				load->ReadModel();
+			} else {
+				load->ReadTexture( decode, cache_size );
+			}
+			load->ready = true;
+		} );
+	}
+}
+
+/**
+ * Hands the reference taken by a finished load over to the
+ * group, unless the group already holds one of its own.
+ */
+void ResourceManager::AdoptIntoGroup( const std::string& group, PendingLoad* load ) {
+	ResourceGroup& members = groups_[ group ];
+	const std::string& key = load->fp.empty() ? load->path : load->fp;
+	if ( load->is_model ) {
+		if ( !members.models.insert( key ).second ) {
+			models_.find( key )->second.ref_count--;
+		}
+	} else if ( !members.textures.insert( key ).second ) {
+		textures_.find( key )->second.ref_count--;
+	}
+}
+
+/**
+ * Drops the group's reference on everything within it, destroying
+ * anything that's left unreferenced and isn't persistent straight away.
+ */
+void ResourceManager::ReleaseGroup( const std::string& group ) {
+	// anything still on its way in for the group is no longer wanted
+	for ( auto i = pending_loads_.begin(); i != pending_loads_.end(); ) {
+		if ( ( *i )->group != group ) {
+			++i;
+			continue;
+		}
+
+		i = pending_loads_.erase( i );
+		num_loads_queued_--;
+	}
+
+	auto members = groups_.find( group );
+	if ( members == groups_.end() ) {
+		return;
+	}
+
+	for ( const auto& path : members->second.textures ) {
+		auto i = textures_.find( path );
+		u_assert( i != textures_.end(), "Texture \"%s\" in group \"%s\" isn't cached!\n", path.c_str(), group.c_str() );
+		if ( i == textures_.end() || ( i->second.ref_count > 0 && --i->second.ref_count > 0 ) || i->second.persist ) {
+			continue;
+		}
+
+		if ( i->second.texture_ptr != fallback_texture_ ) {
+			plDestroyTexture( i->second.texture_ptr );
+		}
+		UncacheTexture( i );
+	}
+
+	for ( const auto& path : members->second.models ) {
+		auto i = models_.find( path );
+		u_assert( i != models_.end(), "Model \"%s\" in group \"%s\" isn't cached!\n", path.c_str(), group.c_str() );
+		if ( i == models_.end() || ( i->second.ref_count > 0 && --i->second.ref_count > 0 ) || i->second.persist ) {
+			continue;
+		}
+
+		if ( i->second.model_ptr != fallback_model_ ) {
+			plDestroyModel( i->second.model_ptr );
+		}
+		UncacheModel( i );
+	}
+
+	groups_.erase( members );
+}
+
+/************************************************************/
+/* Preload Manifests */
+
+#define PRELOAD_MANIFEST_VERSION 1
+
+static std::string GetPreloadManifestPath( const std::string& map ) {
+	std::string path = Engine::GetCacheDirectory( "maps/" );
+	if ( path.empty() ) {
+		return "";
+	}
+
+	return path + map + ".preload";
+}
+
+/**
+ * Manifests are plain text, with a version line followed by a line
+ * for each resource, giving its type, then its filter for textures,
+ * followed by the path it was asked for under.
+ */
+bool ResourceManager::ReadPreloadManifest( const std::string& path, PreloadManifest* manifest ) {
+	std::ifstream input( path );
+	if ( !input.is_open() ) {
+		return false;
+	}
+
+	std::string line;
+	unsigned int version = 0;
+	if ( !std::getline( input, line ) || sscanf( line.c_str(), "version %u", &version ) != 1 ||
+		version != PRELOAD_MANIFEST_VERSION ) {
+		LogWarn( "Unexpected version in \"%s\", ignoring!\n", path.c_str() );
+		return false;
+	}
+
+	while ( std::getline( input, line ) ) {
+		std::istringstream stream( line );
+		std::string type, resource;
+		stream >> type;
+		if ( type == "texture" ) {
+			int filter;
+			if ( stream >> filter && std::getline( stream >> std::ws, resource ) ) {
+				manifest->textures.insert( std::make_pair( resource, static_cast<PLTextureFilter>( filter ) ) );
+				continue;
+			}
+		} else if ( std::getline( stream >> std::ws, resource ) ) {
+			if ( type == "model" ) {
+				manifest->models.insert( resource );
+				continue;
+			} else if ( type == "sample" ) {
+				manifest->samples.insert( resource );
+				continue;
+			}
+		}
+
+		if ( !line.empty() ) {
+			LogWarn( "Invalid line in \"%s\", \"%s\", ignoring!\n", path.c_str(), line.c_str() );
+		}
+	}
+
+	return true;
+}
+
+bool ResourceManager::WritePreloadManifest( const std::string& path, const PreloadManifest& manifest ) {
+	std::ofstream output( path );
+	if ( !output.is_open() ) {
+		LogWarn( "Failed to write to \"%s\"!\n", path.c_str() );
+		return false;
+	}
+
+	output << "version " << PRELOAD_MANIFEST_VERSION << "\n";
+	for ( const auto& i : manifest.textures ) {
+		output << "texture " << static_cast<int>( i.second ) << " " << i.first << "\n";
+	}
+	for ( const auto& i : manifest.models ) {
+		output << "model " << i << "\n";
+	}
+	for ( const auto& i : manifest.samples ) {
+		output << "sample " << i << "\n";
+	}
+
+	return output.good();
+}
+
+/**
+ * Starts recording everything asked for while the map is played, and gets everything
+ * it's been recorded using before loading in the background, under the "map" group,
+ * so it's read in alongside the terrain rather than as each actor spawns in.
+ */
+void ResourceManager::BeginMapSession( const std::string& map ) {
+	EndMapSession();
+
+	if ( cv_game_preload_manifests->i_value <= 0 ) {
+		return;
+	}
+
+	std::string path = GetPreloadManifestPath( map );
+	session_has_manifest_ = !path.empty() && ReadPreloadManifest( path, &session_manifest_ );
+	if ( session_has_manifest_ ) {
+		// split up by filter, as each preload only takes the one
+		std::map<PLTextureFilter, std::vector<std::string>> textures;
+		for ( const auto& i : session_manifest_.textures ) {
+			textures[ i.second ].push_back( i.first );
+		}
+
+		std::vector<std::string> models( session_manifest_.models.begin(), session_manifest_.models.end() );
+		PreloadGroupAsync( "map", {}, models );
+		for ( const auto& i : textures ) {
+			PreloadGroupAsync( "map", i.second, {}, i.first );
+		}
+
+		// samples can only be loaded here, so they're left until everything else is on its way
+		for ( const auto& i : session_manifest_.samples ) {
+			Engine::Audio()->CacheSample( i, false );
+		}
+
+		LogInfo( "Preloading %u textures, %u models and %u samples for \"%s\"\n",
+				 static_cast<unsigned int>( session_manifest_.textures.size() ),
+				 static_cast<unsigned int>( session_manifest_.models.size() ),
+				 static_cast<unsigned int>( session_manifest_.samples.size() ), map.c_str() );
+	}
+
+	// only now, so none of the preloading is recorded
+	session_map_ = map;
+}
+
+/**
+ * Reports how well the manifest covered what was asked for, then writes it back
+ * out if there wasn't one yet, it's been asked to be regenerated, or everything
+ * played is being recorded.
+ */
+void ResourceManager::EndMapSession() {
+	if ( session_map_.empty() ) {
+		return;
+	}
+
+	ReportPreloadManifest();
+
+	if ( !session_has_manifest_ || session_regenerate_ || cv_game_preload_manifests->i_value >= 2 ) {
+		PreloadManifest manifest = session_requests_;
+		if ( !session_regenerate_ ) {
+			manifest.textures.insert( session_manifest_.textures.begin(), session_manifest_.textures.end() );
+			manifest.models.insert( session_manifest_.models.begin(), session_manifest_.models.end() );
+			manifest.samples.insert( session_manifest_.samples.begin(), session_manifest_.samples.end() );
+		}
+
+		std::string path = GetPreloadManifestPath( session_map_ );
+		if ( !path.empty() && WritePreloadManifest( path, manifest ) ) {
+			LogInfo( "Wrote \"%s\"\n", path.c_str() );
+		}
+	}
+
+	session_map_.clear();
+	session_has_manifest_ = false;
+	session_regenerate_ = false;
+	session_manifest_ = PreloadManifest();
+	session_requests_ = PreloadManifest();
+}
+
+void ResourceManager::RecordSampleRequest( const std::string& path ) {
+	if ( !session_map_.empty() ) {
+		session_requests_.samples.insert( path );
+	}
+}
+
+static const std::string& GetManifestPath( const std::string& path ) {
+	return path;
+}
+
+static const std::string& GetManifestPath( const std::pair<const std::string, PLTextureFilter>& texture ) {
+	return texture.first;
+}
+
+template<typename T>
+static void ReportManifestHits( const char* type, const T& manifest, const T& requests ) {
+	unsigned int num_hits = 0;
+	for ( const auto& i : requests ) {
+		const std::string& path = GetManifestPath( i );
+		if ( manifest.find( path ) != manifest.end() ) {
+			num_hits++;
+		} else {
+			LogDebug( " missed %s %s\n", type, path.c_str() );
+		}
+	}
+
+	unsigned int num_requests = static_cast<unsigned int>( requests.size() );
+	LogInfo( " %ss : requested(%u) hit(%u, %.1f%%) missed(%u) unused(%u)\n", type, num_requests, num_hits,
+			 ( num_requests > 0 ) ? ( num_hits * 100.0 ) / num_requests : 100.0, num_requests - num_hits,
+			 static_cast<unsigned int>( manifest.size() ) - num_hits );
+}
+
+void ResourceManager::ReportPreloadManifest() const {
+	LogInfo( "Preload manifest for \"%s\"%s:\n", session_map_.c_str(),
+			 session_has_manifest_ ? "" : " (none yet, recording)" );
+	ReportManifestHits( "texture", session_manifest_.textures, session_requests_.textures );
+	ReportManifestHits( "model", session_manifest_.models, session_requests_.models );
+	ReportManifestHits( "sample", session_manifest_.samples, session_requests_.samples );
+}
+
+/************************************************************/
+
+PLTexture* ResourceManager::GetFallbackTexture() {
+	if ( fallback_texture_ != nullptr ) {
+		return fallback_texture_;
+	}
+
+	PLColour pbuffer[] = {
+		{ 255, 255, 0, 255 }, { 0, 255, 255, 255 },
+		{ 0, 255, 255, 255 }, { 255, 255, 0, 255 } };
+	PLImage* image = plCreateImage( ( uint8_t* ) pbuffer, 2, 2, PL_COLOURFORMAT_RGBA, PL_IMAGEFORMAT_RGBA8 );
+	if ( image != nullptr ) {
+		fallback_texture_ = plCreateTexture();
+		fallback_texture_->flags &= PL_TEXTURE_FLAG_NOMIPS;
+		if ( !plUploadTextureImage( fallback_texture_, image ) ) {
+			Error( "Failed to upload default texture (%s)!\n", plGetError() );
+		}
+		plFreeImage( image );
+	} else {
+		Error( "Failed to generate default texture (%s)!\n", plGetError() );
+	}
+
+	return fallback_texture_;
+}
+
+PLModel* ResourceManager::GetFallbackModel() {
+	if ( fallback_model_ != nullptr ) {
+		return fallback_model_;
+	}
+
+	PLMesh* mesh = plCreateMesh( PL_MESH_LINES, PL_DRAW_DYNAMIC, 0, 6 );
+	plSetMeshVertexPosition( mesh, 0, PLVector3( 0, 20, 0 ) );
+	plSetMeshVertexPosition( mesh, 1, PLVector3( 0, -20, 0 ) );
+	plSetMeshVertexPosition( mesh, 2, PLVector3( 20, 0, 0 ) );
+	plSetMeshVertexPosition( mesh, 3, PLVector3( -20, 0, 0 ) );
+	plSetMeshVertexPosition( mesh, 4, PLVector3( 0, 0, 20 ) );
+	plSetMeshVertexPosition( mesh, 5, PLVector3( 0, 0, -20 ) );
+	plSetMeshUniformColour( mesh, PLColour( 255, 0, 0, 255 ) );
+
+	ShaderProgram* shaderProgram = Shaders_GetProgram( "generic_untextured" );
+	if ( shaderProgram == nullptr ) {
+		Error( "Failed to get default shader program, \"generic_untextured\"!\n" );
+	}
+
+	// todo: kill this api, if we rebuild shader cache we'll die
+	plSetMeshShaderProgram( mesh, shaderProgram->GetInternalProgram() );
+	plUploadMesh( mesh );
+
+	return ( fallback_model_ = plCreateBasicStaticModel( mesh ) );
+}
+
+/**
+ * Destroys every cached texture that isn't persistent or still referenced,
+ * same as eviction would, unless forced to destroy absolutely everything.
+ */
+void ResourceManager::ClearTextures( bool force ) {
+	if ( textures_.empty() ) {
+		return;
+	}
+
+	for ( auto i = textures_.begin(); i != textures_.end(); ) {
+		if ( ( !force && ( i->second.persist || i->second.ref_count > 0 ) )
+			|| ( fallback_texture_ != nullptr && i->second.texture_ptr == fallback_texture_ ) ) {
+			++i;
+			continue;
+		}
+
+		plDestroyTexture( i->second.texture_ptr );
+		i = UncacheTexture( i );
+	}
+
+	if ( force ) {
+		textures_.clear();
+	}
+
+	// and anything destroyed is no longer a part of any group
+	for ( auto& group : groups_ ) {
+		for ( auto i = group.second.textures.begin(); i != group.second.textures.end(); ) {
+			i = ( textures_.find( *i ) == textures_.end() ) ? group.second.textures.erase( i ) : std::next( i );
+		}
+	}
+}
+
+void ResourceManager::ClearModels( bool force ) {
+	if ( models_.empty() ) {
+		return;
+	}
+
+	for ( auto i = models_.begin(); i != models_.end(); ) {
+		if ( ( !force && ( i->second.persist || i->second.ref_count > 0 ) )
+			|| ( fallback_model_ != nullptr && i->second.model_ptr == fallback_model_ ) ) {
+			++i;
+			continue;
+		}
+
+		plDestroyModel( i->second.model_ptr );
+		i = UncacheModel( i );
+	}
+
+	for ( auto& group : groups_ ) {
+		for ( auto i = group.second.models.begin(); i != group.second.models.end(); ) {
+			i = ( models_.find( *i ) == models_.end() ) ? group.second.models.erase( i ) : std::next( i );
+		}
+	}
+}
+
+void ResourceManager::ClearAll() {
+	ClearModels();
+	ClearTextures();
+}
+
+std::vector<ResourceManager::ResourceStats> ResourceManager::GetResourceStats() const {
+	std::vector<ResourceStats> stats;
+	stats.reserve( textures_.size() + models_.size() );
+	for ( const auto& i : textures_ ) {
+		stats.push_back( { "texture", i.first, i.second.texture_ptr->name, i.second.persist, i.second.ref_count,
+						   i.second.cpu_bytes, i.second.gpu_bytes, i.second.hit_count, i.second.last_used_tick,
+						   i.second.load_times } );
+	}
+	for ( const auto& i : models_ ) {
+		stats.push_back( { "model", i.first, i.second.model_ptr->name, i.second.persist, i.second.ref_count,
+						   i.second.cpu_bytes, i.second.gpu_bytes, i.second.hit_count, i.second.last_used_tick,
+						   i.second.load_times } );
+	}
+
+	return stats;
+}
+
+static double GetTotalLoadTime( const ResourceLoadTimes& times ) {
+	return times.io + times.decode + times.upload;
+}
+
+/**
+ * Lists everything cached, optionally sorted so whatever takes up the most
+ * memory, took longest to load, or is loaded most often comes first.
+ * Usage: ListCachedResources [memory|time|hits]
+ */
+void ResourceManager::ListCachedResources( unsigned int argc, char** argv ) {
+	std::vector<ResourceStats> stats = Engine::Resource()->GetResourceStats();
+	if ( argc > 1 ) {
+		std::function<bool( const ResourceStats&, const ResourceStats& )> compare;
+		if ( pl_strcasecmp( argv[ 1 ], "memory" ) == 0 ) {
+			compare = []( const ResourceStats& a, const ResourceStats& b ) {
+				return ( a.cpu_bytes + a.gpu_bytes ) > ( b.cpu_bytes + b.gpu_bytes );
+			};
+		} else if ( pl_strcasecmp( argv[ 1 ], "time" ) == 0 ) {
+			compare = []( const ResourceStats& a, const ResourceStats& b ) {
+				return GetTotalLoadTime( a.load_times ) > GetTotalLoadTime( b.load_times );
+			};
+		} else if ( pl_strcasecmp( argv[ 1 ], "hits" ) == 0 ) {
+			compare = []( const ResourceStats& a, const ResourceStats& b ) {
+				return a.hit_count > b.hit_count;
+			};
+		} else {
+			LogWarn( "Unknown sort, \"%s\", ignoring!\n", argv[ 1 ] );
+			return;
+		}
+		std::stable_sort( stats.begin(), stats.end(), compare );
+	}
+
+	LogInfo( "Printing cache...\n" );
+
+	for ( const auto& i : stats ) {
+		LogInfo( " %s %s / %s : name(%s) refs(%u) cpu(%ukb) gpu(%ukb) hits(%u) tick(%u)"
+				 " io(%.2fms) decode(%.2fms) upload(%.2fms)\n",
+				 i.type, i.path.c_str(), i.persist ? "true" : "false", i.name, i.ref_count,
+				 static_cast<unsigned int>( plBytesToKilobytes( i.cpu_bytes ) ),
+				 static_cast<unsigned int>( plBytesToKilobytes( i.gpu_bytes ) ),
+				 i.hit_count, i.last_used_tick, i.load_times.io, i.load_times.decode, i.load_times.upload );
+	}
+
+	LogInfo( "Total: %ukb CPU, %ukb GPU, of %dkb budget\n",
+			 static_cast<unsigned int>( plBytesToKilobytes( Engine::Resource()->GetCPUBytes() ) ),
+			 static_cast<unsigned int>( plBytesToKilobytes( Engine::Resource()->GetGPUBytes() ) ),
+			 cv_graphics_resource_budget->i_value );
+	if ( !cv_debug_resource_stats->b_value ) {
+		LogInfo( "Load times are only recorded while debug_resource_stats is enabled\n" );
+	}
+}
+
+static std::string EscapeJsonString( const std::string& string ) {
+	std::string escaped;
+	for ( char c : string ) {
+		if ( c == '"' || c == '\\' ) {
+			escaped += '\\';
+		}
+		escaped += c;
+	}
+	return escaped;
+}
+
+/**
+ * Writes out everything ListCachedResources does as Json, to the given
+ * path, or resource_stats.json in the app data directory if none is given.
+ * Usage: DumpResourceStats [path]
+ */
+void ResourceManager::DumpResourceStatsCommand( unsigned int argc, char** argv ) {
+	std::string path;
+	if ( argc > 1 ) {
+		path = argv[ 1 ];
+	} else {
+		path = Engine::GetAppDataDirectory();
+		if ( path.empty() ) {
+			return;
+		}
+		path += "resource_stats.json";
+	}
+
+	std::ofstream output( path );
+	if ( !output.is_open() ) {
+		LogWarn( "Failed to write to \"%s\"!\n", path.c_str() );
+		return;
+	}
+
+	ResourceManager* manager = Engine::Resource();
+	output << "{";
+	output << R"("tick":)" << g_state.sim_ticks << ",";
+	output << R"("recordingTimes":)" << ( cv_debug_resource_stats->b_value ? "true" : "false" ) << ",";
+	output << R"("cpuBytes":)" << manager->GetCPUBytes() << ",";
+	output << R"("gpuBytes":)" << manager->GetGPUBytes() << ",";
+	output << R"("budgetBytes":)" << static_cast<int64_t>( cv_graphics_resource_budget->i_value ) * 1024 << ",";
+	output << R"("resources":[)";
+	std::vector<ResourceStats> stats = manager->GetResourceStats();
+	for ( size_t i = 0; i < stats.size(); ++i ) {
+		const ResourceStats& resource = stats[ i ];
+		output << "{";
+		output << R"("type":")" << resource.type << "\",";
+		output << R"("path":")" << EscapeJsonString( resource.path ) << "\",";
+		output << R"("name":")" << EscapeJsonString( resource.name ) << "\",";
+		output << R"("persist":)" << ( resource.persist ? "true" : "false" ) << ",";
+		output << R"("refs":)" << resource.ref_count << ",";
+		output << R"("cpuBytes":)" << resource.cpu_bytes << ",";
+		output << R"("gpuBytes":)" << resource.gpu_bytes << ",";
+		output << R"("hits":)" << resource.hit_count << ",";
+		output << R"("lastUsedTick":)" << resource.last_used_tick << ",";
+		output << R"("ioMs":)" << resource.load_times.io << ",";
+		output << R"("decodeMs":)" << resource.load_times.decode << ",";
+		output << R"("uploadMs":)" << resource.load_times.upload;
+		output << "}";
+		if ( i != stats.size() - 1 ) {
+			output << ",";
+		}
+	}
+	output << "]}";
+	output.close();
+
+	LogInfo( "Wrote \"%s\"!\n", path.c_str() );
+}
+
+void ResourceManager::ListResourceGroupsCommand( unsigned int argc, char** argv ) {
+	u_unused( argc );
+	u_unused( argv );
+
+	ResourceManager* manager = Engine::Resource();
+	for ( const auto& group : manager->groups_ ) {
+		size_t cpu_bytes = 0, gpu_bytes = 0;
+		for ( const auto& path : group.second.textures ) {
+			auto i = manager->textures_.find( path );
+			if ( i != manager->textures_.end() ) {
+				gpu_bytes += i->second.gpu_bytes;
+			}
+		}
+		for ( const auto& path : group.second.models ) {
+			auto i = manager->models_.find( path );
+			if ( i != manager->models_.end() ) {
+				cpu_bytes += i->second.cpu_bytes;
+				gpu_bytes += i->second.gpu_bytes;
+			}
+		}
+
+		LogInfo( " group %s : textures(%u) models(%u) cpu(%ukb) gpu(%ukb)\n", group.first.c_str(),
+				 static_cast<unsigned int>( group.second.textures.size() ),
+				 static_cast<unsigned int>( group.second.models.size() ),
+				 static_cast<unsigned int>( plBytesToKilobytes( cpu_bytes ) ),
+				 static_cast<unsigned int>( plBytesToKilobytes( gpu_bytes ) ) );
+	}
+	LogInfo( "%u groups\n", static_cast<unsigned int>( manager->groups_.size() ) );
+}
+
+void ResourceManager::ReleaseResourceGroupCommand( unsigned int argc, char** argv ) {
+	if ( argc < 2 ) {
+		LogWarn( "No group specified, ignoring!\n" );
+		return;
+	}
+
+	if ( Engine::Resource()->groups_.find( argv[ 1 ] ) == Engine::Resource()->groups_.end() ) {
+		LogWarn( "No such group, \"%s\", ignoring!\n", argv[ 1 ] );
+		return;
+	}
+
+	Engine::Resource()->ReleaseGroup( argv[ 1 ] );
+}
+
+void ResourceManager::PreloadManifestReportCommand( unsigned int argc, char** argv ) {
+	u_unused( argc );
+	u_unused( argv );
+
+	if ( Engine::Resource()->session_map_.empty() ) {
+		LogWarn( "No map is being recorded, ignoring!\n" );
+		return;
+	}
+
+	Engine::Resource()->ReportPreloadManifest();
+}
+
+void ResourceManager::RegeneratePreloadManifestCommand( unsigned int argc, char** argv ) {
+	u_unused( argc );
+	u_unused( argv );
+
+	ResourceManager* manager = Engine::Resource();
+	if ( manager->session_map_.empty() ) {
+		LogWarn( "No map is being recorded, ignoring!\n" );
+		return;
+	}
+
+	manager->session_regenerate_ = true;
+	LogInfo( "Preload manifest for \"%s\" will be regenerated once it ends\n", manager->session_map_.c_str() );
+}
+
+void ResourceManager::ClearTextureCacheCommand( unsigned int argc, char** argv ) {
+	size_t max_bytes = 0;
+	if ( argc > 1 ) {
+		char* end;
+		unsigned long megabytes = strtoul( argv[ 1 ], &end, 10 );
+		if ( end == argv[ 1 ] || *end != '\0' ) {
+			LogWarn( "Invalid size, \"%s\", ignoring!\n", argv[ 1 ] );
+			return;
+		}
+		max_bytes = static_cast<size_t>( megabytes ) * 1024 * 1024;
+	}
+
+	size_t old_size = TextureCache_GetSize();
+	TextureCache_Trim( max_bytes );
+	LogInfo( "Texture cache is now %ukb, from %ukb, across %u images\n",
+			 static_cast<unsigned int>( plBytesToKilobytes( TextureCache_GetSize() ) ),
+			 static_cast<unsigned int>( plBytesToKilobytes( old_size ) ), TextureCache_GetNumEntries() );
+}
+
+static std::vector<std::string> benchmark_images;
+static void AddBenchmarkImage( const char* path ) {
+	const char* ext = plGetFileExtension( path );
+	for ( const char** format = supported_image_formats; *format != nullptr; ++format ) {
+		if ( pl_strcasecmp( ext, *format ) == 0 ) {
+			benchmark_images.push_back( path );
+			return;
+		}
+	}
+}
+
+/**
+ * Reads in every image under the given directory three times over: first decoding each
+ * without the texture cache, then again with it emptied, filling it in, and then once
+ * more, entirely from it. Uploading is left out, as it's the same either way.
+ * Usage: TextureCacheBenchmark [directory]
+ */
+void ResourceManager::TextureCacheBenchmarkCommand( unsigned int argc, char** argv ) {
+	size_t cache_size = GetTextureCacheSize();
+	if ( cache_size == 0 ) {
+		LogWarn( "Texture cache is disabled, ignoring!\n" );
+		return;
+	}
+
+	benchmark_images.clear();
+	plScanDirectory( ( argc > 1 ) ? argv[ 1 ] : ".", nullptr, AddBenchmarkImage, true );
+	if ( benchmark_images.empty() ) {
+		LogWarn( "No images found, ignoring!\n" );
+		return;
+	}
+
+	auto run = []( size_t cache_size, unsigned int* num_failed ) {
+		*num_failed = 0;
+		auto start = std::chrono::steady_clock::now();
+		for ( const auto& path : benchmark_images ) {
+			PLImage image;
+			if ( !ReadTextureImage( path, false, cache_size, nullptr, &image ) ) {
+				( *num_failed )++;
+				continue;
+			}
+			plFreeImage( &image );
+		}
+		return std::chrono::duration<double, std::milli>( std::chrono::steady_clock::now() - start ).count();
+	};
+
+	unsigned int num_failed;
+	double uncached_ms = run( 0, &num_failed );
+	TextureCache_Trim( 0 );
+	double cold_ms = run( cache_size, &num_failed );
+	double warm_ms = run( cache_size, &num_failed );
+
+	unsigned int num_images = static_cast<unsigned int>( benchmark_images.size() );
+	LogInfo( "Read %u images (%u failed)\n", num_images, num_failed );
+	LogInfo( "uncached %.2fms (%.3fms each), cold %.2fms (%.3fms each), warm %.2fms (%.3fms each)\n",
+			 uncached_ms, uncached_ms / num_images, cold_ms, cold_ms / num_images, warm_ms, warm_ms / num_images );
+	LogInfo( "warm is %.1fx faster than uncached, cache holds %u images in %ukb\n",
+			 ( warm_ms > 0.0 ) ? uncached_ms / warm_ms : 0.0, TextureCache_GetNumEntries(),
+			 static_cast<unsigned int>( plBytesToKilobytes( TextureCache_GetSize() ) ) );
+
+	benchmark_images.clear();
+}
+
+void ResourceManager::ClearTexturesCommand( unsigned int argc, char** argv ) {
+	u_unused( argc );
+	u_unused( argv );
+
+	Engine::Resource()->ClearTextures();
+}
+
+void ResourceManager::ClearModelsCommand( unsigned int argc, char** argv ) {
+	u_unused( argc );
+	u_unused( argv );
 
 	Engine::Resource()->ClearModels();
 }
+
+/**
+ * Encodes the given image as both BC1 and BC3, and decodes it back again, entirely
+ * on the CPU, reporting how long each takes along with the error introduced, then
+ * checks the container survives being written out and read back in unchanged.
+ * Usage: TextureCompressionBenchmark <image> [iterations]
+ */
+void ResourceManager::TextureCompressionBenchmarkCommand( unsigned int argc, char** argv ) {
+	if ( argc < 2 ) {
+		LogWarn( "No image specified, ignoring!\n" );
+		return;
+	}
+
+	unsigned int num_iterations = 10;
+	if ( argc > 2 ) {
+		num_iterations = strtoul( argv[ 2 ], nullptr, 10 );
+		if ( num_iterations == 0 ) {
+			LogWarn( "Invalid number of iterations, \"%s\", ignoring!\n", argv[ 2 ] );
+			return;
+		}
+	}
+
+	PLImage image;
+	if ( !plLoadImage( argv[ 1 ], &image ) ) {
+		LogWarn( "Failed to load \"%s\", ignoring!\n%s\n", argv[ 1 ], plGetError() );
+		return;
+	}
+
+	if ( image.format != PL_IMAGEFORMAT_RGBA8 && !plConvertPixelFormat( &image, PL_IMAGEFORMAT_RGBA8 ) ) {
+		LogWarn( "Failed to convert \"%s\" to RGBA8, ignoring!\n%s\n", argv[ 1 ], plGetError() );
+		plFreeImage( &image );
+		return;
+	}
+
+	const uint8_t* pixels = image.data[ 0 ];
+	unsigned int w = image.width, h = image.height;
+	double num_pixels = static_cast<double>(w) * h;
+	LogInfo( "Compressing \"%s\", %ux%u, %u iterations (would pick %s)\n", argv[ 1 ], w, h, num_iterations,
+			 Dxt_GetBestFormat( pixels, w, h ) == DXT_FORMAT_BC1 ? "BC1" : "BC3" );
+
+	static const struct {
+		const char* name;
+		DxtFormat format;
+	} formats[] = {
+		{ "BC1", DXT_FORMAT_BC1 },
+		{ "BC3", DXT_FORMAT_BC3 },
+	};
+	for ( const auto& format : formats ) {
+		std::vector<uint8_t> blocks( Dxt_GetLevelSize( format.format, w, h ) );
+		std::vector<uint8_t> decoded( w * h * 4 );
+
+		auto start = std::chrono::steady_clock::now();
+		for ( unsigned int i = 0; i < num_iterations; ++i ) {
+			Dxt_EncodeImage( format.format, pixels, w, h, blocks.data() );
+		}
+		double encode_ms = std::chrono::duration<double, std::milli>( std::chrono::steady_clock::now() - start ).count()
+			/ num_iterations;
+
+		start = std::chrono::steady_clock::now();
+		for ( unsigned int i = 0; i < num_iterations; ++i ) {
+			Dxt_DecodeImage( format.format, blocks.data(), w, h, decoded.data() );
+		}
+		double decode_ms = std::chrono::duration<double, std::milli>( std::chrono::steady_clock::now() - start ).count()
+			/ num_iterations;
+
+		// BC1 only keeps colour where alpha survives, so that's all that's compared
+		double colour_error = 0.0, alpha_error = 0.0;
+		unsigned int num_colour = 0;
+		for ( unsigned int i = 0; i < w * h; ++i ) {
+			const uint8_t* a = &pixels[ i * 4 ];
+			const uint8_t* b = &decoded[ i * 4 ];
+			if ( format.format != DXT_FORMAT_BC1 || b[ 3 ] != 0 ) {
+				for ( unsigned int j = 0; j < 3; ++j ) {
+					colour_error += ( a[ j ] - b[ j ] ) * ( a[ j ] - b[ j ] );
+				}
+				num_colour++;
+			}
+			alpha_error += ( a[ 3 ] - b[ 3 ] ) * ( a[ 3 ] - b[ 3 ] );
+		}
+		double colour_rmse = ( num_colour > 0 ) ? std::sqrt( colour_error / ( num_colour * 3.0 ) ) : 0.0;
+		double alpha_rmse = std::sqrt( alpha_error / num_pixels );
+		auto psnr = []( double rmse ) {
+			return ( rmse > 0.0 ) ? 20.0 * std::log10( 255.0 / rmse ) : 99.0;
+		};
+
+		LogInfo( "%s encode %.3fms (%.1f MPixel/s), decode %.3fms (%.1f MPixel/s), %ukb\n",
+				 format.name,
+				 encode_ms, num_pixels / ( encode_ms * 1000.0 ),
+				 decode_ms, num_pixels / ( decode_ms * 1000.0 ),
+				 static_cast<unsigned int>( plBytesToKilobytes( blocks.size() ) ) );
+		LogInfo( "%s colour rmse %.2f (%.1fdB), alpha rmse %.2f (%.1fdB)\n",
+				 format.name, colour_rmse, psnr( colour_rmse ), alpha_rmse, psnr( alpha_rmse ) );
+	}
+
+	// and finally, make sure the whole chain makes it to disk and back
+	std::string cache_path = Engine::GetCacheDirectory();
+	if ( cache_path.empty() ) {
+		plFreeImage( &image );
+		return;
+	}
+	cache_path += "benchmark.dxt";
+
+	DxtHandle* handle = Dxt_CreateHandle( Dxt_GetBestFormat( pixels, w, h ), pixels, w, h );
+	plFreeImage( &image );
+	if ( handle == nullptr ) {
+		return;
+	}
+
+	DxtHandle* loaded = nullptr;
+	if ( Dxt_WriteFile( handle, cache_path.c_str() ) ) {
+		loaded = Dxt_LoadFile( cache_path.c_str() );
+		plDeleteFile( cache_path.c_str() );
+	}
+
+	bool match = ( loaded != nullptr && loaded->format == handle->format && loaded->num_levels == handle->num_levels );
+	for ( unsigned int i = 0; match && i < handle->num_levels; ++i ) {
+		size_t size = Dxt_GetLevelSize( handle->format, std::max( w >> i, 1u ), std::max( h >> i, 1u ) );
+		match = ( memcmp( handle->levels[ i ], loaded->levels[ i ], size ) == 0 );
+	}
+
+	if ( match ) {
+		LogInfo( "Container round trip of %u levels passed\n", handle->num_levels );
+	} else {
+		LogWarn( "Container round trip failed!\n" );
+	}
+
+	Dxt_DestroyHandle( loaded );
+	Dxt_DestroyHandle( handle );
+}
@@ -17,10 +17,41 @@
 
 #pragma once
 
+#include <memory>
+#include <set>
+
 namespace openhow {
 class Engine;
 }
 
+template<typename T>
+class AsyncResource;
+
+typedef std::shared_ptr<AsyncResource<PLTexture>> AsyncTexture;
+typedef std::shared_ptr<AsyncResource<PLModel>> AsyncModel;
+
+/* How long each stage of loading a resource took, in milliseconds, only recorded
+ * while debug_resource_stats is enabled. Models that the platform library loads
+ * in one go, rather than being read in ahead of time, count entirely as upload. */
+struct ResourceLoadTimes {
+	double io{ 0 };
+	double decode{ 0 };
+	double upload{ 0 };
+};
+
+/* Every load takes a reference on the resource, which must be handed back
+ * through Release once it's no longer needed. Anything that isn't persistent
+ * and has no references left may be evicted, least recently used first, once
+ * the cache grows past graphics_resource_budget.
+ *
+ * Resources can also be gathered into named groups, such as everything for the
+ * current map, each of which holds its own reference on everything within it
+ * until the whole group is released at once. Between BeginGroup and EndGroup,
+ * everything loaded is added into that group without needing to be named.
+ *
+ * While a map is being played, every resource asked for is recorded into a
+ * preload manifest for it, which is used to load everything in up front the
+ * next time the map is played, rather than as each actor spawns in. */
 class ResourceManager {
 private:
 	ResourceManager();
@@ -30,11 +61,39 @@ public:
 	PLTexture* GetCachedTexture( const std::string& path );
 	PLModel* GetCachedModel( const std::string& path );
 
+	void Release( PLTexture* texture );
+	void Release( PLModel* model );
+
 	PLTexture* LoadTexture( const std::string& path,
 							PLTextureFilter filter = PL_TEXTURE_FILTER_MIPMAP_NEAREST,
 							bool persist = false, bool abort_on_fail = false );
 	PLModel* LoadModel( const std::string& path, bool persist = false, bool abort_on_fail = false );
 
+	AsyncTexture LoadTextureAsync( const std::string& path,
+								   PLTextureFilter filter = PL_TEXTURE_FILTER_MIPMAP_NEAREST,
+								   bool persist = false );
+	AsyncModel LoadModelAsync( const std::string& path, bool persist = false );
+
+	void AddToGroup( const std::string& group, PLTexture* texture );
+	void AddToGroup( const std::string& group, PLModel* model );
+	void PreloadGroup( const std::string& group,
+					   const std::vector<std::string>& textures, const std::vector<std::string>& models,
+					   PLTextureFilter filter = PL_TEXTURE_FILTER_MIPMAP_NEAREST );
+	void PreloadGroupAsync( const std::string& group,
+							const std::vector<std::string>& textures, const std::vector<std::string>& models,
+							PLTextureFilter filter = PL_TEXTURE_FILTER_MIPMAP_NEAREST );
+	void ReleaseGroup( const std::string& group );
+	void BeginGroup( const std::string& group );
+	void EndGroup();
+
+	void BeginMapSession( const std::string& map );
+	void EndMapSession();
+	void RecordSampleRequest( const std::string& path );
+
+	void ProcessPendingLoads();
+	unsigned int GetNumPendingLoads() const { return static_cast<unsigned int>( pending_loads_.size() ); }
+	uint8_t GetLoadProgress() const;
+
 	PLTexture* GetFallbackTexture();
 	PLModel* GetFallbackModel();
 
@@ -43,10 +102,37 @@ public:
 
 	void ClearAll();
 
+	size_t GetCPUBytes() const;
+	size_t GetGPUBytes() const;
+
+	static bool IsTextureCompressionSupported();
+
 private:
 	static void ListCachedResources( unsigned int argc, char** argv );
+	static void DumpResourceStatsCommand( unsigned int argc, char** argv );
 	static void ClearTexturesCommand( unsigned int argc, char** argv );
 	static void ClearModelsCommand( unsigned int argc, char** argv );
+	static void TextureCompressionBenchmarkCommand( unsigned int argc, char** argv );
+	static void ListResourceGroupsCommand( unsigned int argc, char** argv );
+	static void ReleaseResourceGroupCommand( unsigned int argc, char** argv );
+	static void PreloadManifestReportCommand( unsigned int argc, char** argv );
+	static void RegeneratePreloadManifestCommand( unsigned int argc, char** argv );
+	static void ClearTextureCacheCommand( unsigned int argc, char** argv );
+	static void TextureCacheBenchmarkCommand( unsigned int argc, char** argv );
+
+	struct PendingLoad;
+	void FinishLoad( PendingLoad* load );
+	PLTexture* FinishTextureLoad( PendingLoad* load );
+	PLModel* FinishModelLoad( PendingLoad* load );
+	void AdoptIntoGroup( const std::string& group, PendingLoad* load );
+
+	// in the order they were requested, only removed once uploaded
+	std::list<std::shared_ptr<PendingLoad>> pending_loads_;
+	std::map<std::string, AsyncTexture> pending_textures_;
+	std::map<std::string, AsyncModel> pending_models_;
+	// since the queue was last empty, for the loading screen
+	unsigned int num_loads_queued_{ 0 };
+	unsigned int num_loads_finished_{ 0 };
 
 	struct TextureHandle {
 		TextureHandle( PLTexture* texture_ptr, bool persist ) {
@@ -56,12 +142,21 @@ private:
 
 		PLTexture* texture_ptr{ nullptr };
 		bool persist{ false };
+
+		unsigned int ref_count{ 0 };
+		unsigned int last_used{ 0 };
+		size_t cpu_bytes{ 0 }; // nothing's kept around once uploaded
+		size_t gpu_bytes{ 0 };
+
+		unsigned int hit_count{ 0 };
+		unsigned int last_used_tick{ 0 };
+		ResourceLoadTimes load_times;
 	};
-	std::map<std::string, TextureHandle> textures_;
-	inline PLTexture* CacheTexture( const std::string& path, PLTexture* texture_ptr, bool persist = false ) {
-		textures_.insert( std::pair<std::string, TextureHandle>( path, { texture_ptr, persist } ) );
-		return texture_ptr;
-	}
+	typedef std::map<std::string, TextureHandle> TextureMap;
+	TextureMap textures_;
+	TextureMap::iterator UncacheTexture( TextureMap::iterator texture );
+	PLTexture* CacheTexture( const std::string& path, PLTexture* texture_ptr, bool persist = false,
+							 const ResourceLoadTimes* times = nullptr );
 
 	struct ModelHandle {
 		ModelHandle( PLModel* model_ptr, bool persist ) {
@@ -71,15 +166,100 @@ private:
 
 		PLModel* model_ptr{ nullptr };
 		bool persist{ false };
+
+		unsigned int ref_count{ 0 };
+		unsigned int last_used{ 0 };
+		size_t cpu_bytes{ 0 };
+		size_t gpu_bytes{ 0 };
+
+		unsigned int hit_count{ 0 };
+		unsigned int last_used_tick{ 0 };
+		ResourceLoadTimes load_times;
 	};
-	std::map<std::string, ModelHandle> models_;
-	inline PLModel* CacheModel( const std::string& path, PLModel* model_ptr, bool persist = false ) {
-		models_.insert( std::pair<std::string, ModelHandle>( path, { model_ptr, persist } ) );
-		return model_ptr;
-	}
+	typedef std::map<std::string, ModelHandle> ModelMap;
+	ModelMap models_;
+	ModelMap::iterator UncacheModel( ModelMap::iterator model );
+	PLModel* CacheModel( const std::string& path, PLModel* model_ptr, bool persist = false,
+						 const ResourceLoadTimes* times = nullptr );
+
+	// by the paths they're cached under, rather than the resources themselves
+	struct ResourceGroup {
+		std::set<std::string> textures;
+		std::set<std::string> models;
+	};
+	std::map<std::string, ResourceGroup> groups_;
+	std::string current_group_; // empty outside of BeginGroup and EndGroup
+
+	// back from each resource to where it's cached, for releasing, bar the fallbacks
+	std::map<const PLTexture*, TextureMap::iterator> texture_entries_;
+	std::map<const PLModel*, ModelMap::iterator> model_entries_;
+
+	// totals across everything cached, kept up to date as it comes and goes
+	size_t cpu_bytes_{ 0 };
+	size_t gpu_bytes_{ 0 };
+
+	// by the paths they were asked for under, along with the filter the texture was first asked for with
+	struct PreloadManifest {
+		std::map<std::string, PLTextureFilter> textures;
+		std::set<std::string> models;
+		std::set<std::string> samples;
+	};
+	static bool ReadPreloadManifest( const std::string& path, PreloadManifest* manifest );
+	static bool WritePreloadManifest( const std::string& path, const PreloadManifest& manifest );
+	void ReportPreloadManifest() const;
+
+	// empty while no map is being played, or if manifests are disabled
+	std::string session_map_;
+	bool session_has_manifest_{ false };
+	bool session_regenerate_{ false };
+	PreloadManifest session_manifest_;
+	PreloadManifest session_requests_;
+
+	struct ResourceStats {
+		const char* type;
+		std::string path;
+		const char* name;
+		bool persist;
+		unsigned int ref_count;
+		size_t cpu_bytes, gpu_bytes;
+		unsigned int hit_count;
+		unsigned int last_used_tick;
+		ResourceLoadTimes load_times;
+	};
+	std::vector<ResourceStats> GetResourceStats() const;
+
+	// bumped on every load and release, for working out which was used least recently
+	unsigned int use_counter_{ 0 };
+	void EvictToBudget();
 
 	PLTexture* fallback_texture_{ nullptr };
 	PLModel* fallback_model_{ nullptr };
 
 	friend class openhow::Engine;
 };
+
+/**
+ * Handed back straight away by the async loaders, giving the fallback in place
+ * of the resource until it's been loaded in and uploaded, after which it holds
+ * a reference on the resource until it's destroyed. Main thread only.
+ */
+template<typename T>
+class AsyncResource {
+public:
+	AsyncResource( ResourceManager* manager, T* fallback ) : manager_( manager ), resource_( fallback ) {}
+	~AsyncResource() {
+		if ( ready_ ) {
+			manager_->Release( resource_ );
+		}
+	}
+
+	T* Get() const { return resource_; }
+	bool IsReady() const { return ready_; }
+
+private:
+	ResourceManager* manager_;
+	T* resource_;
+	bool ready_{ false };
+
+	friend class ResourceManager;
+};
@@ -89,6 +89,10 @@ int System_SetSwapInterval( int interval ) {
 	return SDL_GL_GetSwapInterval();
 }
 
+bool System_IsGLExtensionSupported( const char* extension ) {
+	return ( gl_context != nullptr && SDL_GL_ExtensionSupported( extension ) == SDL_TRUE );
+}
+
 static void System_SetWindowIcon( const char* path ) {
 	PLImage image;
 	if ( !plLoadImage( path, &image ) ) {
@@ -15,295 +15,2025 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
-#include <list>
+#include <chrono>
+#include <functional>
+
+#if defined( __SSE2__ ) || defined( _M_X64 )
+#   include <emmintrin.h>
+#   define TERRAIN_SIMD_SSE2
+#elif defined( __ARM_NEON )
+#   include <arm_neon.h>
+#   define TERRAIN_SIMD_NEON
+#endif
 
 #include "engine.h"
 #include "terrain.h"
+#include "Map.h"
 
+#include "graphics/camera.h"
 #include "graphics/mesh.h"
 #include "graphics/shaders.h"
 #include "graphics/texture_atlas.h"
 #include "graphics/display.h"
 
-//Precalculated vertices for chunk rendering
-//TODO: Share one index buffer instance between all chunks
-const static unsigned int chunk_indices[96] = {
-	0, 2, 1, 1, 2, 3,
-	4, 6, 5, 5, 6, 7,
-	8, 10, 9, 9, 10, 11,
-	12, 14, 13, 13, 14, 15,
-	16, 18, 17, 17, 18, 19,
-	20, 22, 21, 21, 22, 23,
-	24, 26, 25, 25, 26, 27,
-	28, 30, 29, 29, 30, 31,
-	32, 34, 33, 33, 34, 35,
-	36, 38, 37, 37, 38, 39,
-	40, 42, 41, 41, 42, 43,
-	44, 46, 45, 45, 46, 47,
-	48, 50, 49, 49, 50, 51,
-	52, 54, 53, 53, 54, 55,
-	56, 58, 57, 57, 58, 59,
-	60, 62, 61, 61, 62, 63,
+/**
+ * Describes how a chunk is laid out at a given level of detail. Each quad
+ * spans one or more tiles and is textured using the top-left one, followed
+ * by skirts along the edges of the chunk to hide any cracks against a
+ * neighbour drawn at a different level. Every chunk shares the same layout,
+ * so these are only generated once.
+ */
+struct ChunkLayout {
+	struct Vertex {
+		uint8_t x, y;         // vertex coordinates within the chunk
+		uint8_t tile;         // tile to take the texture from
+		uint8_t corner;       // corner of the above tile
+		int8_t skirt;         // edge of the chunk this hangs from, or -1
+	};
+	std::vector<Vertex> vertices;
+	std::vector<unsigned int> indices;
 };
 
+static const ChunkLayout& GetChunkLayout( unsigned int lod ) {
+	static ChunkLayout layouts[ TERRAIN_LODS ];
+	ChunkLayout& layout = layouts[ lod ];
+	if ( !layout.vertices.empty() ) {
+		return layout;
+	}
+
+	unsigned int span = 1U << lod;
+	unsigned int quads = TERRAIN_CHUNK_ROW_TILES / span;
+	for ( unsigned int quad_y = 0; quad_y < quads; ++quad_y ) {
+		for ( unsigned int quad_x = 0; quad_x < quads; ++quad_x ) {
+			unsigned int base = layout.vertices.size();
+			for ( unsigned int i = 0; i < 4; ++i ) {
+				ChunkLayout::Vertex vertex{};
+				vertex.x = ( quad_x + ( i % 2 ) ) * span;
+				vertex.y = ( quad_y + ( i / 2 ) ) * span;
+				vertex.tile = quad_x * span + quad_y * span * TERRAIN_CHUNK_ROW_TILES;
+				vertex.corner = i;
+				vertex.skirt = -1;
+				layout.vertices.push_back( vertex );
+			}
+
+			unsigned int quad_indices[] = { 0, 2, 1, 1, 2, 3 };
+			for ( unsigned int index : quad_indices ) {
+				layout.indices.push_back( base + index );
+			}
+		}
+	}
+
+	// Skirts copy the quad corners along each edge (top, bottom, left then right),
+	// wound so that they face outwards to match the winding of the quads
+	for ( unsigned int edge = 0; edge < 4; ++edge ) {
+		for ( unsigned int i = 0; i < quads; ++i ) {
+			unsigned int quad, a, b;
+			switch ( edge ) {
+				case 0: quad = i; a = 0; b = 1; break;
+				case 1: quad = i + ( quads - 1 ) * quads; a = 3; b = 2; break;
+				case 2: quad = i * quads; a = 2; b = 0; break;
+				default: quad = ( quads - 1 ) + i * quads; a = 1; b = 3; break;
+			}
+
+			unsigned int top_a = quad * 4 + a;
+			unsigned int top_b = quad * 4 + b;
+			unsigned int bottom = layout.vertices.size();
+
+			ChunkLayout::Vertex vertex = layout.vertices[ top_a ];
+			vertex.skirt = edge;
+			layout.vertices.push_back( vertex );
+			vertex = layout.vertices[ top_b ];
+			vertex.skirt = edge;
+			layout.vertices.push_back( vertex );
+
+			unsigned int skirt_indices[] = { top_a, top_b, bottom, top_b, bottom + 1, bottom };
+			for ( unsigned int index : skirt_indices ) {
+				layout.indices.push_back( index );
+			}
+		}
+	}
+
+	return layout;
+}
+
 Terrain::Terrain( const std::string& tileset ) {
-	// attempt to load in the atlas sheet
 	// TODO: allow us to change this on the fly
-	atlas_ = new TextureAtlas( 512, 8 );
-	for ( unsigned int i = 0; i < 256; ++i ) {
-		if ( !atlas_->AddImage( tileset + std::to_string( i ) ) ) {
-			break;
+	atlas_ = CreateTileAtlas( tileset );
+	GenerateTextureCoords( atlas_, texture_coords_ );
+
+	chunks_.resize( TERRAIN_CHUNKS );
+	for ( unsigned int i = 0; i < chunks_.size(); ++i ) {
+		unsigned int chunk_x = i % TERRAIN_CHUNK_ROW;
+		unsigned int chunk_y = i / TERRAIN_CHUNK_ROW;
+		chunks_[ i ].sector =
+			( chunk_x / TERRAIN_SECTOR_ROW_CHUNKS ) + ( chunk_y / TERRAIN_SECTOR_ROW_CHUNKS ) * TERRAIN_SECTOR_ROW;
+		chunks_[ i ].slot =
+			( chunk_x % TERRAIN_SECTOR_ROW_CHUNKS ) + ( chunk_y % TERRAIN_SECTOR_ROW_CHUNKS ) * TERRAIN_SECTOR_ROW_CHUNKS;
+		GenerateBounds( chunk_x, chunk_y );
+	}
+
+	visible_chunks_.resize( TERRAIN_CHUNKS );
+
+	GenerateSectors();
+
+	normals_.resize( TERRAIN_ROW_VERTICES * TERRAIN_ROW_VERTICES );
+	overview_pixels_.resize( TERRAIN_ROW_TILES * TERRAIN_ROW_TILES * 3 );
+
+	static_assert( ( TERRAIN_ROW_TILES >> ( TERRAIN_HEIGHT_LEVELS - 1 ) ) == 1, "Height pyramid doesn't end on a single node!" );
+	for ( unsigned int level = 0; level < TERRAIN_HEIGHT_LEVELS; ++level ) {
+		unsigned int row = TERRAIN_ROW_TILES >> level;
+		height_pyramid_[ level ].min.resize( row * row );
+		height_pyramid_[ level ].max.resize( row * row );
+	}
+	GenerateHeightPyramid( 0, 0, TERRAIN_ROW_TILES - 1, TERRAIN_ROW_TILES - 1 );
+	GenerateTileMasks();
+}
+
+Terrain::~Terrain() {
+	delete atlas_;
+
+	plDestroyTexture( overview_ );
+
+	for ( auto& sector : sectors_ ) {
+		for ( auto& lod : sector.lods ) {
+			plDestroyModel( lod );
+		}
+	}
+}
+
+Terrain::Chunk* Terrain::GetChunk( const PLVector2& pos ) {
+	if ( pos.x < 0 || std::floor( pos.x ) >= TERRAIN_PIXEL_WIDTH ||
+		pos.y < 0 || std::floor( pos.y ) >= TERRAIN_PIXEL_WIDTH ) {
+		return nullptr;
+	}
+
+	uint idx =
+		( ( uint ) ( pos.x ) / TERRAIN_CHUNK_PIXEL_WIDTH )
+			+ ( ( ( uint ) ( pos.y ) / TERRAIN_CHUNK_PIXEL_WIDTH ) * TERRAIN_CHUNK_ROW );
+	if ( idx >= chunks_.size() ) {
+		LogWarn( "Attempted to get an out of bounds chunk index (%d)!\n", idx );
+		return nullptr;
+	}
+
+	return &chunks_[ idx ];
+}
+
+Terrain::Tile Terrain::GetTile( const PLVector2& pos ) {
+	if ( pos.x < 0 || std::floor( pos.x ) >= TERRAIN_PIXEL_WIDTH ||
+		pos.y < 0 || std::floor( pos.y ) >= TERRAIN_PIXEL_WIDTH ) {
+		return Tile();
+	}
+
+	return Tile( this, ( uint ) ( pos.x ) / TERRAIN_TILE_PIXEL_WIDTH, ( uint ) ( pos.y ) / TERRAIN_TILE_PIXEL_WIDTH );
+}
+
+Terrain::Tile Terrain::GetTile( unsigned int x, unsigned int y ) {
+	if ( x >= TERRAIN_ROW_TILES || y >= TERRAIN_ROW_TILES ) {
+		return Tile();
+	}
+
+	return Tile( this, x, y );
+}
+
+Terrain::Storage::Storage() :
+	heights( TERRAIN_ROW_VERTICES * TERRAIN_ROW_VERTICES, 0 ),
+	shading( TERRAIN_ROW_VERTICES * TERRAIN_ROW_VERTICES, 255 ),
+	surfaces( TERRAIN_ROW_TILES * TERRAIN_ROW_TILES, Tile::SURFACE_MUD ),
+	behaviours( TERRAIN_ROW_TILES * TERRAIN_ROW_TILES, Tile::BEHAVIOUR_NONE ),
+	slips( TERRAIN_ROW_TILES * TERRAIN_ROW_TILES, 0 ),
+	textures( TERRAIN_ROW_TILES * TERRAIN_ROW_TILES, 0 ),
+	rotations( TERRAIN_ROW_TILES * TERRAIN_ROW_TILES, Tile::ROTATION_FLAG_NONE ) {}
+
+Terrain::Tile::Surface Terrain::Tile::GetSurface() const {
+	return static_cast<Surface>(terrain_->storage_.surfaces[ x_ + y_ * TERRAIN_ROW_TILES ]);
+}
+
+Terrain::Tile::Behaviour Terrain::Tile::GetBehaviour() const {
+	return static_cast<Behaviour>(terrain_->storage_.behaviours[ x_ + y_ * TERRAIN_ROW_TILES ]);
+}
+
+unsigned int Terrain::Tile::GetSlip() const {
+	return terrain_->storage_.slips[ x_ + y_ * TERRAIN_ROW_TILES ];
+}
+
+uint8_t Terrain::Tile::GetTexture() const {
+	return terrain_->storage_.textures[ x_ + y_ * TERRAIN_ROW_TILES ];
+}
+
+Terrain::Tile::Rotation Terrain::Tile::GetRotation() const {
+	return static_cast<Rotation>(terrain_->storage_.rotations[ x_ + y_ * TERRAIN_ROW_TILES ]);
+}
+
+float Terrain::Tile::GetHeight( unsigned int corner ) const {
+	return terrain_->storage_.heights[ ( x_ + ( corner % 2 ) ) + ( y_ + ( corner / 2 ) ) * TERRAIN_ROW_VERTICES ];
+}
+
+uint8_t Terrain::Tile::GetShading( unsigned int corner ) const {
+	return terrain_->storage_.shading[ ( x_ + ( corner % 2 ) ) + ( y_ + ( corner / 2 ) ) * TERRAIN_ROW_VERTICES ];
+}
+
+/**
+ * Flags the chunk at the given position to be regenerated on the next Update.
+ */
+void Terrain::MarkDirty( const PLVector2& pos ) {
+	Chunk* chunk = GetChunk( pos );
+	if ( chunk == nullptr ) {
+		return;
+	}
+
+	chunk->dirty = true;
+
+	unsigned int idx = static_cast<unsigned int>(chunk - chunks_.data());
+	GenerateBounds( idx % TERRAIN_CHUNK_ROW, idx / TERRAIN_CHUNK_ROW );
+}
+
+/**
+ * Sets the height of the given vertex, which is shared by up to four tiles.
+ */
+void Terrain::SetHeight( unsigned int x, unsigned int y, float height ) {
+	if ( x >= TERRAIN_ROW_VERTICES || y >= TERRAIN_ROW_VERTICES ) {
+		LogWarn( "Attempted to set height of an out of bounds vertex (%u %u)!\n", x, y );
+		return;
+	}
+
+	storage_.heights[ x + y * TERRAIN_ROW_VERTICES ] = height;
+	MarkVertexDirty( x, y );
+
+	GenerateHeightPyramid(
+		( x > 0 ) ? x - 1 : 0, ( y > 0 ) ? y - 1 : 0,
+		std::min( x, ( unsigned int ) TERRAIN_ROW_TILES - 1 ), std::min( y, ( unsigned int ) TERRAIN_ROW_TILES - 1 ) );
+
+	if ( height > max_height_ ) {
+		max_height_ = height;
+	}
+	if ( height < min_height_ ) {
+		min_height_ = height;
+	}
+}
+
+/**
+ * Sets the shading of the given vertex, which is shared by up to four tiles.
+ */
+void Terrain::SetShading( unsigned int x, unsigned int y, uint8_t shading ) {
+	if ( x >= TERRAIN_ROW_VERTICES || y >= TERRAIN_ROW_VERTICES ) {
+		LogWarn( "Attempted to set shading of an out of bounds vertex (%u %u)!\n", x, y );
+		return;
+	}
+
+	storage_.shading[ x + y * TERRAIN_ROW_VERTICES ] = shading;
+	MarkVertexDirty( x, y );
+}
+
+/**
+ * Flags every chunk sharing the given vertex, of which there can be up to four.
+ */
+void Terrain::MarkVertexDirty( unsigned int x, unsigned int y ) {
+	cache_key_ = 0;
+
+	unsigned int chunk_x = x / TERRAIN_CHUNK_ROW_TILES;
+	unsigned int chunk_y = y / TERRAIN_CHUNK_ROW_TILES;
+	for ( unsigned int cy = ( chunk_y > 0 && y % TERRAIN_CHUNK_ROW_TILES == 0 ) ? chunk_y - 1 : chunk_y;
+		  cy <= chunk_y && cy < TERRAIN_CHUNK_ROW; ++cy ) {
+		for ( unsigned int cx = ( chunk_x > 0 && x % TERRAIN_CHUNK_ROW_TILES == 0 ) ? chunk_x - 1 : chunk_x;
+			  cx <= chunk_x && cx < TERRAIN_CHUNK_ROW; ++cx ) {
+			chunks_[ cx + cy * TERRAIN_CHUNK_ROW ].dirty = true;
+			GenerateBounds( cx, cy );
+		}
+	}
+}
+
+void Terrain::SetTexture( unsigned int x, unsigned int y, uint8_t texture, Tile::Rotation rotation ) {
+	if ( x >= TERRAIN_ROW_TILES || y >= TERRAIN_ROW_TILES ) {
+		LogWarn( "Attempted to set texture of an out of bounds tile (%u %u)!\n", x, y );
+		return;
+	}
+
+	storage_.textures[ x + y * TERRAIN_ROW_TILES ] = texture;
+	storage_.rotations[ x + y * TERRAIN_ROW_TILES ] = rotation;
+	cache_key_ = 0;
+	chunks_[ ( x / TERRAIN_CHUNK_ROW_TILES ) + ( y / TERRAIN_CHUNK_ROW_TILES ) * TERRAIN_CHUNK_ROW ].dirty = true;
+}
+
+void Terrain::SetSurface( unsigned int x, unsigned int y, Tile::Surface surface ) {
+	if ( x >= TERRAIN_ROW_TILES || y >= TERRAIN_ROW_TILES || surface > Tile::SURFACE_LAVA ) {
+		LogWarn( "Attempted to set an invalid surface (%d) or that of an out of bounds tile (%u %u)!\n", surface, x, y );
+		return;
+	}
+
+	storage_.surfaces[ x + y * TERRAIN_ROW_TILES ] = surface;
+	GenerateTileMasks( x, y );
+	cache_key_ = 0;
+	chunks_[ ( x / TERRAIN_CHUNK_ROW_TILES ) + ( y / TERRAIN_CHUNK_ROW_TILES ) * TERRAIN_CHUNK_ROW ].overview_dirty = true;
+}
+
+void Terrain::SetBehaviour( unsigned int x, unsigned int y, Tile::Behaviour behaviour ) {
+	if ( x >= TERRAIN_ROW_TILES || y >= TERRAIN_ROW_TILES ) {
+		LogWarn( "Attempted to set behaviour of an out of bounds tile (%u %u)!\n", x, y );
+		return;
+	}
+
+	storage_.behaviours[ x + y * TERRAIN_ROW_TILES ] = behaviour & ~31U;
+	GenerateTileMasks( x, y );
+	cache_key_ = 0;
+	// mines are marked out on the overview
+	chunks_[ ( x / TERRAIN_CHUNK_ROW_TILES ) + ( y / TERRAIN_CHUNK_ROW_TILES ) * TERRAIN_CHUNK_ROW ].overview_dirty = true;
+}
+
+/**
+ * Moves the given tile into the masks for its current surface and behaviours.
+ */
+void Terrain::GenerateTileMasks( unsigned int x, unsigned int y ) {
+	unsigned int surface = storage_.surfaces[ x + y * TERRAIN_ROW_TILES ];
+	for ( unsigned int i = 0; i < plArrayElements( surface_masks_ ); ++i ) {
+		surface_masks_[ i ].Set( x, y, i == surface );
+	}
+
+	uint8_t behaviour = storage_.behaviours[ x + y * TERRAIN_ROW_TILES ];
+	behaviour_masks_[ 0 ].Set( x, y, behaviour == Tile::BEHAVIOUR_NONE );
+	behaviour_masks_[ 1 ].Set( x, y, ( behaviour & Tile::BEHAVIOUR_WATERY ) != 0 );
+	behaviour_masks_[ 2 ].Set( x, y, ( behaviour & Tile::BEHAVIOUR_MINE ) != 0 );
+	behaviour_masks_[ 3 ].Set( x, y, ( behaviour & Tile::BEHAVIOUR_WALL ) != 0 );
+}
+
+void Terrain::GenerateTileMasks() {
+	for ( unsigned int y = 0; y < TERRAIN_ROW_TILES; ++y ) {
+		for ( unsigned int x = 0; x < TERRAIN_ROW_TILES; ++x ) {
+			GenerateTileMasks( x, y );
+		}
+	}
+}
+
+const Terrain::TileMask& Terrain::GetBehaviourMask( Tile::Behaviour behaviour ) const {
+	switch ( behaviour ) {
+		case Tile::BEHAVIOUR_WATERY: return behaviour_masks_[ 1 ];
+		case Tile::BEHAVIOUR_MINE: return behaviour_masks_[ 2 ];
+		case Tile::BEHAVIOUR_WALL: return behaviour_masks_[ 3 ];
+		default:
+			u_assert( behaviour == Tile::BEHAVIOUR_NONE, "Only a single behaviour can be queried at a time!\n" );
+			return behaviour_masks_[ 0 ];
+	}
+}
+
+void Terrain::TileMask::Set( unsigned int x, unsigned int y, bool value ) {
+	if ( value ) {
+		rows_[ y ] |= ( 1ULL << x );
+	} else {
+		rows_[ y ] &= ~( 1ULL << x );
+	}
+}
+
+uint64_t Terrain::TileMask::GetSpanMask( unsigned int min_x, unsigned int max_x ) {
+	return ( ~0ULL >> ( 63 - max_x ) ) & ( ~0ULL << min_x );
+}
+
+/**
+ * Rows of tiles with their centres between the top and bottom of the circle,
+ * returning false if there aren't any.
+ */
+bool Terrain::TileMask::GetRadiusRows( const PLVector2& pos, float radius, unsigned int* min_y, unsigned int* max_y ) {
+	// written this way around so NaN is also rejected
+	if ( !( radius >= 0 ) ) {
+		return false;
+	}
+
+	float min = std::ceil( ( pos.y - radius ) / TERRAIN_TILE_PIXEL_WIDTH - 0.5f );
+	float max = std::floor( ( pos.y + radius ) / TERRAIN_TILE_PIXEL_WIDTH - 0.5f );
+	min = std::max( min, 0.0f );
+	max = std::min( max, static_cast<float>(TERRAIN_ROW_TILES - 1) );
+	if ( !( min <= max ) ) {
+		return false;
+	}
+
+	*min_y = static_cast<unsigned int>(min);
+	*max_y = static_cast<unsigned int>(max);
+	return true;
+}
+
+/**
+ * Tiles along the given row with their centres inside of the circle.
+ */
+uint64_t Terrain::TileMask::GetRadiusSpanMask( const PLVector2& pos, float radius, unsigned int y ) {
+	float dy = ( y + 0.5f ) * TERRAIN_TILE_PIXEL_WIDTH - pos.y;
+	float span = radius * radius - dy * dy;
+	if ( span < 0 ) {
+		return 0;
+	}
+
+	span = std::sqrt( span );
+	float min = std::ceil( ( pos.x - span ) / TERRAIN_TILE_PIXEL_WIDTH - 0.5f );
+	float max = std::floor( ( pos.x + span ) / TERRAIN_TILE_PIXEL_WIDTH - 0.5f );
+	min = std::max( min, 0.0f );
+	max = std::min( max, static_cast<float>(TERRAIN_ROW_TILES - 1) );
+	if ( !( min <= max ) ) {
+		return 0;
+	}
+
+	return GetSpanMask( static_cast<unsigned int>(min), static_cast<unsigned int>(max) );
+}
+
+unsigned int Terrain::TileMask::CountRect( unsigned int min_x, unsigned int min_y, unsigned int max_x, unsigned int max_y ) const {
+	max_x = std::min( max_x, ( unsigned int ) TERRAIN_ROW_TILES - 1 );
+	max_y = std::min( max_y, ( unsigned int ) TERRAIN_ROW_TILES - 1 );
+	if ( min_x > max_x ) {
+		return 0;
+	}
+
+	uint64_t span = GetSpanMask( min_x, max_x );
+	unsigned int count = 0;
+	for ( unsigned int y = min_y; y <= max_y; ++y ) {
+		count += __builtin_popcountll( rows_[ y ] & span );
+	}
+	return count;
+}
+
+unsigned int Terrain::TileMask::CountRadius( const PLVector2& pos, float radius ) const {
+	unsigned int min_y, max_y;
+	if ( !GetRadiusRows( pos, radius, &min_y, &max_y ) ) {
+		return 0;
+	}
+
+	unsigned int count = 0;
+	for ( unsigned int y = min_y; y <= max_y; ++y ) {
+		count += __builtin_popcountll( rows_[ y ] & GetRadiusSpanMask( pos, radius, y ) );
+	}
+	return count;
+}
+
+float Terrain::GetHeight( const PLVector2& pos ) {
+	// written this way around so NaN is also rejected
+	if ( !( pos.x >= 0 && pos.x < TERRAIN_PIXEL_WIDTH && pos.y >= 0 && pos.y < TERRAIN_PIXEL_WIDTH ) ) {
+		return 0;
+	}
+
+	float x = pos.x / TERRAIN_TILE_PIXEL_WIDTH;
+	float y = pos.y / TERRAIN_TILE_PIXEL_WIDTH;
+	auto tile_x = static_cast<unsigned int>(x);
+	auto tile_y = static_cast<unsigned int>(y);
+	x -= tile_x;
+	y -= tile_y;
+
+	const float* h = &storage_.heights[ tile_x + tile_y * TERRAIN_ROW_VERTICES ];
+	float top = h[ 0 ] + ( ( h[ 1 ] - h[ 0 ] ) * x );
+	float bottom = h[ TERRAIN_ROW_VERTICES ] + ( ( h[ TERRAIN_ROW_VERTICES + 1 ] - h[ TERRAIN_ROW_VERTICES ] ) * x );
+	return top + ( ( bottom - top ) * y );
+}
+
+static_assert( sizeof( PLVector2 ) == sizeof( float ) * 2, "Unexpected PLVector2 layout!" );
+
+/**
+ * Batched version of GetHeight, four positions are resolved at a time where SIMD is available.
+ * Positions outside of the terrain return a height of 0, same as GetHeight.
+ */
+void Terrain::GetHeights( const PLVector2* pos, float* heights, size_t num ) {
+	size_t i = 0;
+
+#if defined( TERRAIN_SIMD_SSE2 ) || defined( TERRAIN_SIMD_NEON )
+	const float* field = storage_.heights.data();
+	for ( ; i + 4 <= num; i += 4 ) {
+		alignas( 16 ) int32_t idx[4];
+		alignas( 16 ) float h00[4], h10[4], h01[4], h11[4];
+
+#if defined( TERRAIN_SIMD_SSE2 )
+		const float* src = &pos[ i ].x;
+		__m128 a = _mm_loadu_ps( src );
+		__m128 b = _mm_loadu_ps( src + 4 );
+		__m128 x = _mm_shuffle_ps( a, b, _MM_SHUFFLE( 2, 0, 2, 0 ) );
+		__m128 y = _mm_shuffle_ps( a, b, _MM_SHUFFLE( 3, 1, 3, 1 ) );
+
+		const __m128 zero = _mm_setzero_ps();
+		const __m128 width = _mm_set1_ps( TERRAIN_PIXEL_WIDTH );
+		__m128 valid = _mm_and_ps(
+			_mm_and_ps( _mm_cmpge_ps( x, zero ), _mm_cmplt_ps( x, width ) ),
+			_mm_and_ps( _mm_cmpge_ps( y, zero ), _mm_cmplt_ps( y, width ) ) );
+
+		// zero out anything invalid so the lookup below stays in bounds
+		const __m128 scale = _mm_set1_ps( 1.0f / TERRAIN_TILE_PIXEL_WIDTH );
+		x = _mm_mul_ps( _mm_and_ps( x, valid ), scale );
+		y = _mm_mul_ps( _mm_and_ps( y, valid ), scale );
+
+		__m128 tile_x = _mm_cvtepi32_ps( _mm_cvttps_epi32( x ) );
+		__m128 tile_y = _mm_cvtepi32_ps( _mm_cvttps_epi32( y ) );
+		x = _mm_sub_ps( x, tile_x );
+		y = _mm_sub_ps( y, tile_y );
+
+		__m128 row = _mm_set1_ps( TERRAIN_ROW_VERTICES );
+		_mm_store_si128( reinterpret_cast<__m128i*>(idx),
+						 _mm_cvttps_epi32( _mm_add_ps( _mm_mul_ps( tile_y, row ), tile_x ) ) );
+#else
+		float32x4x2_t xy = vld2q_f32( &pos[ i ].x );
+		float32x4_t x = xy.val[ 0 ];
+		float32x4_t y = xy.val[ 1 ];
+
+		const float32x4_t zero = vdupq_n_f32( 0 );
+		const float32x4_t width = vdupq_n_f32( TERRAIN_PIXEL_WIDTH );
+		uint32x4_t valid = vandq_u32(
+			vandq_u32( vcgeq_f32( x, zero ), vcltq_f32( x, width ) ),
+			vandq_u32( vcgeq_f32( y, zero ), vcltq_f32( y, width ) ) );
+
+		const float scale = 1.0f / TERRAIN_TILE_PIXEL_WIDTH;
+		x = vmulq_n_f32( vreinterpretq_f32_u32( vandq_u32( vreinterpretq_u32_f32( x ), valid ) ), scale );
+		y = vmulq_n_f32( vreinterpretq_f32_u32( vandq_u32( vreinterpretq_u32_f32( y ), valid ) ), scale );
+
+		int32x4_t tile_x = vcvtq_s32_f32( x );
+		int32x4_t tile_y = vcvtq_s32_f32( y );
+		x = vsubq_f32( x, vcvtq_f32_s32( tile_x ) );
+		y = vsubq_f32( y, vcvtq_f32_s32( tile_y ) );
+
+		vst1q_s32( idx, vmlaq_n_s32( tile_x, tile_y, TERRAIN_ROW_VERTICES ) );
+#endif
+
+		// no gather on either target, so fetch the corners individually
+		for ( unsigned int j = 0; j < 4; ++j ) {
+			const float* h = field + idx[ j ];
+			h00[ j ] = h[ 0 ];
+			h10[ j ] = h[ 1 ];
+			h01[ j ] = h[ TERRAIN_ROW_VERTICES ];
+			h11[ j ] = h[ TERRAIN_ROW_VERTICES + 1 ];
+		}
+
+#if defined( TERRAIN_SIMD_SSE2 )
+		__m128 c00 = _mm_load_ps( h00 );
+		__m128 c01 = _mm_load_ps( h01 );
+		__m128 top = _mm_add_ps( c00, _mm_mul_ps( _mm_sub_ps( _mm_load_ps( h10 ), c00 ), x ) );
+		__m128 bottom = _mm_add_ps( c01, _mm_mul_ps( _mm_sub_ps( _mm_load_ps( h11 ), c01 ), x ) );
+		__m128 z = _mm_add_ps( top, _mm_mul_ps( _mm_sub_ps( bottom, top ), y ) );
+		_mm_storeu_ps( heights + i, _mm_and_ps( z, valid ) );
+#else
+		float32x4_t c00 = vld1q_f32( h00 );
+		float32x4_t c01 = vld1q_f32( h01 );
+		float32x4_t top = vmlaq_f32( c00, vsubq_f32( vld1q_f32( h10 ), c00 ), x );
+		float32x4_t bottom = vmlaq_f32( c01, vsubq_f32( vld1q_f32( h11 ), c01 ), x );
+		float32x4_t z = vmlaq_f32( top, vsubq_f32( bottom, top ), y );
+		vst1q_f32( heights + i, vreinterpretq_f32_u32( vandq_u32( vreinterpretq_u32_f32( z ), valid ) ) );
+#endif
+	}
+#endif
+
+	for ( ; i < num; ++i ) {
+		heights[ i ] = GetHeight( pos[ i ] );
+	}
+}
+
+/**
+ * Updates the bounding box of the given chunk from its tile heights.
+ */
+void Terrain::GenerateBounds( unsigned int chunk_x, unsigned int chunk_y ) {
+	Chunk& chunk = chunks_[ chunk_x + chunk_y * TERRAIN_CHUNK_ROW ];
+
+	const float* heights = &storage_.heights[ ( chunk_x + chunk_y * TERRAIN_ROW_VERTICES ) * TERRAIN_CHUNK_ROW_TILES ];
+	float min = heights[ 0 ];
+	float max = min;
+	for ( unsigned int y = 0; y <= TERRAIN_CHUNK_ROW_TILES; ++y, heights += TERRAIN_ROW_VERTICES ) {
+		for ( unsigned int x = 0; x <= TERRAIN_CHUNK_ROW_TILES; ++x ) {
+			min = std::min( min, heights[ x ] );
+			max = std::max( max, heights[ x ] );
+		}
+	}
+
+	chunk.bounds_min = PLVector3(
+		static_cast<float>(chunk_x * TERRAIN_CHUNK_PIXEL_WIDTH ), min,
+		static_cast<float>(chunk_y * TERRAIN_CHUNK_PIXEL_WIDTH ) );
+	chunk.bounds_max = PLVector3(
+		static_cast<float>(( chunk_x + 1 ) * TERRAIN_CHUNK_PIXEL_WIDTH ), max,
+		static_cast<float>(( chunk_y + 1 ) * TERRAIN_CHUNK_PIXEL_WIDTH ) );
+}
+
+/**
+ * Refreshes the min/max heights for the given (inclusive) range of tiles,
+ * followed by the nodes covering them on each level above.
+ */
+void Terrain::GenerateHeightPyramid( unsigned int min_x, unsigned int min_y, unsigned int max_x, unsigned int max_y ) {
+	HeightLevel& tiles = height_pyramid_[ 0 ];
+	for ( unsigned int y = min_y; y <= max_y; ++y ) {
+		for ( unsigned int x = min_x; x <= max_x; ++x ) {
+			// heights are interpolated across the tile, so never leave its corners' range
+			const float* h = &storage_.heights[ x + y * TERRAIN_ROW_VERTICES ];
+			tiles.min[ x + y * TERRAIN_ROW_TILES ] =
+				std::min( std::min( h[ 0 ], h[ 1 ] ), std::min( h[ TERRAIN_ROW_VERTICES ], h[ TERRAIN_ROW_VERTICES + 1 ] ) );
+			tiles.max[ x + y * TERRAIN_ROW_TILES ] =
+				std::max( std::max( h[ 0 ], h[ 1 ] ), std::max( h[ TERRAIN_ROW_VERTICES ], h[ TERRAIN_ROW_VERTICES + 1 ] ) );
+		}
+	}
+
+	for ( unsigned int level = 1; level < TERRAIN_HEIGHT_LEVELS; ++level ) {
+		const HeightLevel& below = height_pyramid_[ level - 1 ];
+		HeightLevel& current = height_pyramid_[ level ];
+		unsigned int below_row = TERRAIN_ROW_TILES >> ( level - 1 );
+		unsigned int row = below_row / 2;
+		min_x /= 2;
+		min_y /= 2;
+		max_x /= 2;
+		max_y /= 2;
+		for ( unsigned int y = min_y; y <= max_y; ++y ) {
+			for ( unsigned int x = min_x; x <= max_x; ++x ) {
+				unsigned int child = ( x * 2 ) + ( y * 2 ) * below_row;
+				current.min[ x + y * row ] = std::min(
+					std::min( below.min[ child ], below.min[ child + 1 ] ),
+					std::min( below.min[ child + below_row ], below.min[ child + below_row + 1 ] ) );
+				current.max[ x + y * row ] = std::max(
+					std::max( below.max[ child ], below.max[ child + 1 ] ),
+					std::max( below.max[ child + below_row ], below.max[ child + below_row + 1 ] ) );
+			}
+		}
+	}
+}
+
+/**
+ * Clips the range along the ray to the part of it within the given box,
+ * returning false if none of it is.
+ */
+static bool ClipRayToBox( const PLVector3& origin, const PLVector3& direction,
+						  const PLVector3& mins, const PLVector3& maxs, float* min_t, float* max_t ) {
+	const float o[] = { origin.x, origin.y, origin.z };
+	const float d[] = { direction.x, direction.y, direction.z };
+	const float lo[] = { mins.x, mins.y, mins.z };
+	const float hi[] = { maxs.x, maxs.y, maxs.z };
+	for ( unsigned int i = 0; i < 3; ++i ) {
+		if ( std::fabs( d[ i ] ) < 1e-6f ) {
+			if ( o[ i ] < lo[ i ] || o[ i ] > hi[ i ] ) {
+				return false;
+			}
+			continue;
+		}
+
+		float t0 = ( lo[ i ] - o[ i ] ) / d[ i ];
+		float t1 = ( hi[ i ] - o[ i ] ) / d[ i ];
+		if ( t0 > t1 ) {
+			std::swap( t0, t1 );
+		}
+
+		*min_t = std::max( *min_t, t0 );
+		*max_t = std::min( *max_t, t1 );
+		if ( *min_t > *max_t ) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+/**
+ * Finds where the ray first meets the surface of the given tile, between min_t and max_t.
+ * The surface is interpolated the same way as GetHeight, which makes its height along
+ * the ray a quadratic, so this is solved directly rather than stepping across the tile.
+ */
+bool Terrain::RaycastTile( unsigned int x, unsigned int y, const PLVector3& origin, const PLVector3& direction,
+						   float min_t, float max_t, float* t ) {
+	const float* h = &storage_.heights[ x + y * TERRAIN_ROW_VERTICES ];
+	float dx = h[ 1 ] - h[ 0 ];
+	float dy = h[ TERRAIN_ROW_VERTICES ] - h[ 0 ];
+	float dxy = h[ 0 ] - h[ 1 ] - h[ TERRAIN_ROW_VERTICES ] + h[ TERRAIN_ROW_VERTICES + 1 ];
+
+	// work from where the ray enters the tile, to keep everything small
+	PLVector3 start = origin + direction * min_t;
+	float u = ( start.x / TERRAIN_TILE_PIXEL_WIDTH ) - x;
+	float v = ( start.z / TERRAIN_TILE_PIXEL_WIDTH ) - y;
+	float du = direction.x / TERRAIN_TILE_PIXEL_WIDTH;
+	float dv = direction.z / TERRAIN_TILE_PIXEL_WIDTH;
+
+	// distance above the surface is a*s^2 + b*s + c, s being how far along from the start
+	float a = -dxy * du * dv;
+	float b = direction.y - ( dx * du + dy * dv + dxy * ( u * dv + v * du ) );
+	float c = start.y - ( h[ 0 ] + dx * u + dy * v + dxy * u * v );
+	if ( c <= 0 ) {
+		*t = min_t;
+		return true;
+	}
+
+	float s;
+	if ( a == 0 ) {
+		if ( b >= 0 ) {
+			return false;
+		}
+		s = -c / b;
+	} else {
+		float discriminant = b * b - 4 * a * c;
+		if ( discriminant < 0 ) {
+			return false;
+		}
+
+		// c is positive, so the roots can't be zero; take the nearest one ahead
+		float q = -0.5f * ( b + std::copysign( std::sqrt( discriminant ), b ) );
+		float s0 = q / a;
+		float s1 = c / q;
+		if ( s0 > s1 ) {
+			std::swap( s0, s1 );
+		}
+		s = ( s0 >= 0 ) ? s0 : s1;
+		if ( s < 0 ) {
+			return false;
+		}
+	}
+
+	if ( s > max_t - min_t ) {
+		return false;
+	}
+
+	*t = min_t + s;
+	return true;
+}
+
+/**
+ * Walks the height pyramid front to back, skipping any node whose bounds the ray
+ * misses entirely, so only the tiles actually near the ray are tested. The
+ * children of a node never overlap along the ray, so the first hit is the nearest.
+ */
+bool Terrain::Raycast( const PLVector3& origin, const PLVector3& direction, float max_distance,
+					   PLVector3* hit, float* distance ) {
+	if ( !( max_distance > 0 ) ) {
+		return false;
+	}
+
+	struct Node {
+		unsigned int level;
+		unsigned int x;
+		unsigned int y;
+	};
+	Node stack[TERRAIN_HEIGHT_LEVELS * 4];
+	unsigned int num_nodes = 0;
+	stack[ num_nodes++ ] = { TERRAIN_HEIGHT_LEVELS - 1, 0, 0 };
+
+	// children nearest along the ray are pushed last, so they're visited first
+	unsigned int near_x = ( direction.x < 0 ) ? 1 : 0;
+	unsigned int near_y = ( direction.z < 0 ) ? 1 : 0;
+
+	while ( num_nodes > 0 ) {
+		Node node = stack[ --num_nodes ];
+		const HeightLevel& level = height_pyramid_[ node.level ];
+		unsigned int idx = node.x + node.y * ( TERRAIN_ROW_TILES >> node.level );
+		float size = static_cast<float>(TERRAIN_TILE_PIXEL_WIDTH << node.level);
+
+		PLVector3 mins( node.x * size, level.min[ idx ], node.y * size );
+		PLVector3 maxs( mins.x + size, level.max[ idx ], mins.z + size );
+		float min_t = 0;
+		float max_t = max_distance;
+		if ( !ClipRayToBox( origin, direction, mins, maxs, &min_t, &max_t ) ) {
+			continue;
+		}
+
+		if ( node.level == 0 ) {
+			float t;
+			if ( !RaycastTile( node.x, node.y, origin, direction, min_t, max_t, &t ) ) {
+				continue;
+			}
+
+			if ( hit != nullptr ) {
+				*hit = origin + direction * t;
+			}
+			if ( distance != nullptr ) {
+				*distance = t;
+			}
+			return true;
+		}
+
+		for ( int i = 3; i >= 0; --i ) {
+			stack[ num_nodes++ ] = {
+				node.level - 1,
+				node.x * 2 + ( ( i & 1 ) ? 1 - near_x : near_x ),
+				node.y * 2 + ( ( i & 2 ) ? 1 - near_y : near_y ) };
+		}
+	}
+
+	return false;
+}
+
+/**
+ * Checks whether the surface gets in the way between two points,
+ * both of which are expected to be above it.
+ */
+bool Terrain::HasLineOfSight( const PLVector3& from, const PLVector3& to ) {
+	PLVector3 delta = to - from;
+	float length = delta.Length();
+	if ( length <= 0 ) {
+		return true;
+	}
+
+	return !Raycast( from, delta / length, length );
+}
+
+/**
+ * Generates smooth normals for the given (inclusive) range of vertices
+ * from the heightfield. This matches what Mesh_GenerateFragmentedMeshNormals
+ * would produce for the chunk meshes, averaging the normals of every face
+ * sharing the vertex, but only needs to look at the immediate neighbours.
+ */
+void Terrain::GenerateNormals( unsigned int min_x, unsigned int min_y, unsigned int max_x, unsigned int max_y ) {
+	for ( unsigned int y = min_y; y <= max_y; ++y ) {
+		for ( unsigned int x = min_x; x <= max_x; ++x ) {
+			normals_[ x + y * TERRAIN_ROW_VERTICES ] = GenerateVertexNormal( storage_.heights.data(), TERRAIN_ROW_TILES, x, y );
+		}
+	}
+}
+
+/**
+ * Averages the normals of every face sharing the vertex, shared with
+ * PagedTerrain so both come out the same for the same heights.
+ */
+PLVector3 Terrain::GenerateVertexNormal( const float* heights, unsigned int row_tiles, unsigned int x, unsigned int y ) {
+	auto position = [ heights, row_tiles ]( unsigned int x, unsigned int y ) {
+		return PLVector3(
+			static_cast<float>(x * TERRAIN_TILE_PIXEL_WIDTH ),
+			heights[ x + y * ( row_tiles + 1 ) ],
+			static_cast<float>(y * TERRAIN_TILE_PIXEL_WIDTH ) );
+	};
+
+	PLVector3 sum;
+	unsigned int num_faces = 0;
+
+	// Each tile is split into two faces, 0-2-1 and 1-2-3, see GetChunkLayout
+	for ( unsigned int tile_y = ( y > 0 ) ? y - 1 : 0; tile_y <= y && tile_y < row_tiles; ++tile_y ) {
+		for ( unsigned int tile_x = ( x > 0 ) ? x - 1 : 0; tile_x <= x && tile_x < row_tiles; ++tile_x ) {
+			PLVector3 corners[] = {
+				position( tile_x, tile_y ), position( tile_x + 1, tile_y ),
+				position( tile_x, tile_y + 1 ), position( tile_x + 1, tile_y + 1 ),
+			};
+
+			unsigned int corner = ( x - tile_x ) + ( y - tile_y ) * 2;
+			if ( corner != 3 ) {
+				sum += plGenerateVertexNormal( corners[ 0 ], corners[ 2 ], corners[ 1 ] );
+				num_faces++;
+			}
+			if ( corner != 0 ) {
+				sum += plGenerateVertexNormal( corners[ 1 ], corners[ 2 ], corners[ 3 ] );
+				num_faces++;
+			}
+		}
+	}
+
+	return sum / num_faces;
+}
+
+/**
+ * Creates the static meshes that chunks are written into, one per level of
+ * detail. Every sector has the same layout so they all share the one set of
+ * indices per level, with each chunk owning a fixed range of the vertices.
+ */
+void Terrain::GenerateSectors() {
+	static std::vector<unsigned int> sector_indices[ TERRAIN_LODS ];
+
+	sectors_.resize( TERRAIN_SECTORS );
+	g_state.gfx.terrain_buffer_bytes = 0;
+	for ( unsigned int lod = 0; lod < TERRAIN_LODS; ++lod ) {
+		const ChunkLayout& layout = GetChunkLayout( lod );
+		if ( sector_indices[ lod ].empty() ) {
+			for ( unsigned int i = 0; i < TERRAIN_SECTOR_CHUNKS; ++i ) {
+				for ( unsigned int index : layout.indices ) {
+					sector_indices[ lod ].push_back( index + i * layout.vertices.size() );
+				}
+			}
+		}
+
+		unsigned int num_vertices = TERRAIN_SECTOR_CHUNKS * layout.vertices.size();
+		unsigned int num_indices = sector_indices[ lod ].size();
+		for ( auto& sector : sectors_ ) {
+			PLMesh* mesh = plCreateMeshInit( PL_MESH_TRIANGLES, PL_DRAW_STATIC,
+											 num_indices / 3, num_vertices,
+											 ( void* ) sector_indices[ lod ].data(), nullptr );
+			if ( mesh == nullptr ) {
+				Error( "Unable to create map sector mesh, aborting (%s)!\n", plGetError() );
+			}
+
+			mesh->texture = atlas_->GetTexture();
+
+			// attach the mesh to our model
+			if ( ( sector.lods[ lod ] = plCreateBasicStaticModel( mesh ) ) == nullptr ) {
+				Error( "Failed to create map model (%s), aborting!\n", plGetError() );
+			}
+		}
+
+		g_state.gfx.terrain_buffer_bytes +=
+			TERRAIN_SECTORS * ( num_vertices * sizeof( PLVertex ) + num_indices * sizeof( unsigned int ) );
+	}
+}
+
+TextureAtlas* Terrain::CreateTileAtlas( const std::string& tileset ) {
+	// tiles are all the same size, so rows already pack them without any gaps
+	auto* atlas = new TextureAtlas( 512, 8, TextureAtlas::PACKER_SHELF, false );
+	std::vector<std::string> tiles( 256 );
+	for ( unsigned int i = 0; i < tiles.size(); ++i ) {
+		tiles[ i ] = tileset + std::to_string( i );
+	}
+	atlas->AddImages( tiles );
+	atlas->Finalize();
+	return atlas;
+}
+
+void Terrain::GenerateTextureCoords( TextureAtlas* atlas, TextureCoords* coords ) {
+	for ( unsigned int i = 0; i < 256; ++i ) {
+		atlas->GetTextureCoords( atlas->GetHandle( std::to_string( i ) ), &coords[ i ].x, &coords[ i ].y, &coords[ i ].w, &coords[ i ].h );
+	}
+}
+
+void Terrain::GenerateTileCoords( const TextureCoords& coords, uint8_t rotation, float* s, float* t ) {
+	float tx_x = coords.x, tx_y = coords.y, tx_w = coords.w, tx_h = coords.h;
+
+	// TERRAIN_FLIP_FLAG_X flips around texture sheet coords, not TERRAIN coords.
+	if ( rotation & Tile::ROTATION_FLAG_X ) {
+		tx_x = tx_x + tx_w;
+		tx_w = -tx_w;
+	}
+
+	s[ 0 ] = tx_x;
+	s[ 1 ] = tx_x + tx_w;
+	s[ 2 ] = tx_x;
+	s[ 3 ] = tx_x + tx_w;
+	t[ 0 ] = tx_y;
+	t[ 1 ] = tx_y;
+	t[ 2 ] = tx_y + tx_h;
+	t[ 3 ] = tx_y + tx_h;
+
+	// Rotate a quad of ST coords 90 degrees clockwise.
+	auto rot90 = []( float* x ) {
+		float c = x[ 0 ];
+		x[ 0 ] = x[ 2 ];
+		x[ 2 ] = x[ 3 ];
+		x[ 3 ] = x[ 1 ];
+		x[ 1 ] = c;
+	};
+
+	if ( rotation & Tile::ROTATION_FLAG_ROTATE_90 ) {
+		rot90( s );
+		rot90( t );
+	}
+
+	if ( rotation & Tile::ROTATION_FLAG_ROTATE_180 ) {
+		rot90( s );
+		rot90( t );
+		rot90( s );
+		rot90( t );
+	}
+
+	// MAP_FLIP_FLAG_ROTATE_270 is implemented by ORing 90 and 180 together.
+}
+
+/**
+ * Writes the given chunk into its range of each of the sector meshes. This
+ * only touches the vertices belonging to the chunk, so chunks can be written
+ * from any thread; flagging the sector for upload is left to the caller.
+ */
+void Terrain::GenerateChunk( unsigned int chunk_x, unsigned int chunk_y, bool by_name ) {
+	Chunk* chunk = &chunks_[ chunk_x + chunk_y * TERRAIN_CHUNK_ROW ];
+	Sector* sector = &sectors_[ chunk->sector ];
+
+	// ST coords for each corner of each tile.
+	float tile_s[ TERRAIN_CHUNK_TILES ][ 4 ];
+	float tile_t[ TERRAIN_CHUNK_TILES ][ 4 ];
+	for ( unsigned int i = 0; i < TERRAIN_CHUNK_TILES; ++i ) {
+		unsigned int tile_idx = ( chunk_x * TERRAIN_CHUNK_ROW_TILES + ( i % TERRAIN_CHUNK_ROW_TILES ) ) +
+			( chunk_y * TERRAIN_CHUNK_ROW_TILES + ( i / TERRAIN_CHUNK_ROW_TILES ) ) * TERRAIN_ROW_TILES;
+		uint8_t rotation = storage_.rotations[ tile_idx ];
+
+		TextureCoords coords = texture_coords_[ storage_.textures[ tile_idx ] ];
+		if ( by_name ) {
+			atlas_->GetTextureCoords( std::to_string( storage_.textures[ tile_idx ] ), &coords.x, &coords.y, &coords.w, &coords.h );
+		}
+
+		GenerateTileCoords( coords, rotation, tile_s[ i ], tile_t[ i ] );
+	}
+
+	// Neighbours within the same sector are always drawn at the same level,
+	// so skirts are only dropped along edges shared with another sector
+	unsigned int skirts = 0;
+	if ( chunk_y % TERRAIN_SECTOR_ROW_CHUNKS == 0 && chunk_y > 0 ) {
+		skirts |= 1U;
+	}
+	if ( chunk_y % TERRAIN_SECTOR_ROW_CHUNKS == TERRAIN_SECTOR_ROW_CHUNKS - 1 && chunk_y < TERRAIN_CHUNK_ROW - 1 ) {
+		skirts |= 2U;
+	}
+	if ( chunk_x % TERRAIN_SECTOR_ROW_CHUNKS == 0 && chunk_x > 0 ) {
+		skirts |= 4U;
+	}
+	if ( chunk_x % TERRAIN_SECTOR_ROW_CHUNKS == TERRAIN_SECTOR_ROW_CHUNKS - 1 && chunk_x < TERRAIN_CHUNK_ROW - 1 ) {
+		skirts |= 8U;
+	}
+
+	// Any gap along an edge can't be any lower than the lowest point of the chunk
+	float skirt_height = chunk->bounds_min.y - TERRAIN_SKIRT_DEPTH;
+
+	for ( unsigned int lod = 0; lod < TERRAIN_LODS; ++lod ) {
+		const ChunkLayout& layout = GetChunkLayout( lod );
+		PLMesh* chunk_mesh = plGetModelLodLevel( sector->lods[ lod ], 0 )->meshes[ 0 ];
+
+		unsigned int cm_idx = chunk->slot * layout.vertices.size();
+		for ( const auto& vertex : layout.vertices ) {
+			unsigned int vertex_x = chunk_x * TERRAIN_CHUNK_ROW_TILES + vertex.x;
+			unsigned int vertex_y = chunk_y * TERRAIN_CHUNK_ROW_TILES + vertex.y;
+			unsigned int grid_idx = vertex_x + vertex_y * TERRAIN_ROW_VERTICES;
+
+			// unused skirts are left collapsed along the edge
+			float height = storage_.heights[ grid_idx ];
+			if ( vertex.skirt >= 0 && ( skirts & ( 1U << vertex.skirt ) ) ) {
+				height = skirt_height;
+			}
+
+			uint8_t shading = storage_.shading[ grid_idx ];
+
+			PLVertex* mesh_vertex = &chunk_mesh->vertices[ cm_idx++ ];
+			mesh_vertex->position = PLVector3(
+				static_cast<float>(vertex_x * TERRAIN_TILE_PIXEL_WIDTH),
+				height,
+				static_cast<float>(vertex_y * TERRAIN_TILE_PIXEL_WIDTH) );
+			mesh_vertex->normal = normals_[ grid_idx ];
+			mesh_vertex->st[ 0 ] = PLVector2( tile_s[ vertex.tile ][ vertex.corner ], tile_t[ vertex.tile ][ vertex.corner ] );
+			mesh_vertex->colour = PLColour( shading, shading, shading );
+		}
+	}
+}
+
+/**
+ * Refreshes the normals for an existing chunk, for when
+ * a neighbouring chunk has changed along the seam.
+ */
+void Terrain::GenerateChunkNormals( unsigned int chunk_x, unsigned int chunk_y ) {
+	Chunk* chunk = &chunks_[ chunk_x + chunk_y * TERRAIN_CHUNK_ROW ];
+	Sector* sector = &sectors_[ chunk->sector ];
+
+	for ( unsigned int lod = 0; lod < TERRAIN_LODS; ++lod ) {
+		const ChunkLayout& layout = GetChunkLayout( lod );
+		PLMesh* chunk_mesh = plGetModelLodLevel( sector->lods[ lod ], 0 )->meshes[ 0 ];
+
+		unsigned int cm_idx = chunk->slot * layout.vertices.size();
+		for ( const auto& vertex : layout.vertices ) {
+			unsigned int x = chunk_x * TERRAIN_CHUNK_ROW_TILES + vertex.x;
+			unsigned int y = chunk_y * TERRAIN_CHUNK_ROW_TILES + vertex.y;
+			chunk_mesh->vertices[ cm_idx++ ].normal = normals_[ x + y * TERRAIN_ROW_VERTICES ];
+		}
+	}
+}
+
+/**
+ * Writes the overview pixels covered by the given chunk, at overview_scale_
+ * pixels along each side of a tile, shading each by the height beneath it.
+ * The result isn't visible until UploadOverview is called.
+ */
+void Terrain::GenerateOverview( unsigned int chunk_x, unsigned int chunk_y ) {
+	static const PLColour colours[] = {
+		{ 60, 50, 40 },     // Mud
+		{ 40, 70, 40 },     // Grass
+		{ 128, 128, 128 },  // Metal
+		{ 153, 94, 34 },    // Wood
+		{ 90, 90, 150 },    // Water
+		{ 50, 50, 50 },     // Stone
+		{ 50, 50, 50 },     // Rock
+		{ 100, 80, 30 },    // Sand
+		{ 180, 240, 240 },  // Ice
+		{ 100, 100, 100 },  // Snow
+		{ 60, 50, 40 },     // Quagmire
+		{ 100, 240, 53 }    // Lava/Poison
+	};
+
+	// fetch the heights for the whole chunk up front
+	unsigned int row_pixels = TERRAIN_CHUNK_ROW_TILES * overview_scale_;
+	unsigned int num_pixels = row_pixels * row_pixels;
+	float pixel_width = static_cast<float>(TERRAIN_TILE_PIXEL_WIDTH) / overview_scale_;
+	PLVector2 positions[TERRAIN_CHUNK_TILES * TERRAIN_OVERVIEW_MAX_SCALE * TERRAIN_OVERVIEW_MAX_SCALE];
+	float heights[TERRAIN_CHUNK_TILES * TERRAIN_OVERVIEW_MAX_SCALE * TERRAIN_OVERVIEW_MAX_SCALE];
+	for ( unsigned int i = 0; i < num_pixels; ++i ) {
+		positions[ i ] = PLVector2(
+			( chunk_x * row_pixels + ( i % row_pixels ) ) * pixel_width,
+			( chunk_y * row_pixels + ( i / row_pixels ) ) * pixel_width );
+	}
+	GetHeights( positions, heights, num_pixels );
+
+	unsigned int overview_width = GetOverviewWidth();
+	for ( unsigned int i = 0; i < num_pixels; ++i ) {
+		unsigned int px = chunk_x * row_pixels + ( i % row_pixels );
+		unsigned int py = chunk_y * row_pixels + ( i / row_pixels );
+		unsigned int x = px / overview_scale_;
+		unsigned int y = py / overview_scale_;
+		uint8_t surface = storage_.surfaces[ x + y * TERRAIN_ROW_TILES ];
+		u_assert( surface < plArrayElements( colours ), "Hit an invalid tile during overview generation!\n" );
+
+		auto mod = static_cast<int>(( heights[ i ] + overview_mid_height_ ) / 255);
+		PLColour rgb = PLColour(
+			std::min( ( colours[ surface ].r / 9 ) * mod, 255 ),
+			std::min( ( colours[ surface ].g / 9 ) * mod, 255 ),
+			std::min( ( colours[ surface ].b / 9 ) * mod, 255 )
+		);
+		if ( storage_.behaviours[ x + y * TERRAIN_ROW_TILES ] & Tile::BEHAVIOUR_MINE ) {
+			rgb = PLColour( 255, 0, 0 );
+		}
+
+		uint8_t* buf = &overview_pixels_[ ( px + py * overview_width ) * 3 ];
+		*( buf++ ) = rgb.r;
+		*( buf++ ) = rgb.g;
+		*( buf++ ) = rgb.b;
+	}
+}
+
+void Terrain::UploadOverview() {
+	unsigned int overview_width = GetOverviewWidth();
+	PLImage* image = plCreateImage( nullptr, overview_width, overview_width, PL_COLOURFORMAT_RGB, PL_IMAGEFORMAT_RGB8 );
+	memcpy( image->data[ 0 ], overview_pixels_.data(), overview_pixels_.size() );
+
+	// the texture is kept around between updates, just replacing its contents
+	if ( overview_ == nullptr && ( overview_ = plCreateTexture() ) == nullptr ) {
+		Error( "Failed to generate overview texture slot!\n%s\n", plGetError() );
+	}
+
+	plUploadTextureImage( overview_, image );
+	plDestroyImage( image );
+}
+
+bool Terrain::WriteOverview( const std::string& path ) {
+	unsigned int overview_width = GetOverviewWidth();
+	PLImage* image = plCreateImage( nullptr, overview_width, overview_width, PL_COLOURFORMAT_RGB, PL_IMAGEFORMAT_RGB8 );
+	memcpy( image->data[ 0 ], overview_pixels_.data(), overview_pixels_.size() );
+
+	bool status = plWriteImage( image, path.c_str() );
+	plDestroyImage( image );
+	return status;
+}
+
+/**
+ * Fills in the vertices for the given chunks, along with the normals of any
+ * chunks along their seams. Everything here is CPU-side, so it's spread across
+ * the job pool; every job writes to its own set of vertices, so the result is
+ * identical to running serially. Sectors that need uploading are flagged.
+ */
+void Terrain::GenerateMeshes( const std::vector<unsigned int>& chunks, bool parallel, bool by_name ) {
+	JobPool* jobs = parallel ? openhow::Engine::Jobs() : nullptr;
+	auto for_each = [ jobs ]( unsigned int count, const std::function<void( unsigned int )>& func ) {
+		if ( jobs != nullptr ) {
+			jobs->ParallelFor( count, func );
+			return;
+		}
+
+		for ( unsigned int i = 0; i < count; ++i ) {
+			func( i );
+		}
+	};
+
+	enum { CHUNK_UNCHANGED, CHUNK_SEAM, CHUNK_REGENERATE };
+	std::vector<uint8_t> states( chunks_.size(), CHUNK_UNCHANGED );
+
+	// Normals depend on the neighbouring heights, so any vertex within one of
+	// an edited chunk is affected, which spills over into the surrounding chunks
+	std::vector<uint8_t> stale_normals( TERRAIN_ROW_VERTICES * TERRAIN_ROW_VERTICES, 0 );
+	for ( unsigned int i : chunks ) {
+		unsigned int chunk_x = i % TERRAIN_CHUNK_ROW;
+		unsigned int chunk_y = i / TERRAIN_CHUNK_ROW;
+		unsigned int min_x = chunk_x * TERRAIN_CHUNK_ROW_TILES;
+		unsigned int min_y = chunk_y * TERRAIN_CHUNK_ROW_TILES;
+		unsigned int max_x = std::min( min_x + TERRAIN_CHUNK_ROW_TILES + 1, ( unsigned int ) TERRAIN_ROW_VERTICES - 1 );
+		unsigned int max_y = std::min( min_y + TERRAIN_CHUNK_ROW_TILES + 1, ( unsigned int ) TERRAIN_ROW_VERTICES - 1 );
+		for ( unsigned int y = ( min_y > 0 ) ? min_y - 1 : 0; y <= max_y; ++y ) {
+			for ( unsigned int x = ( min_x > 0 ) ? min_x - 1 : 0; x <= max_x; ++x ) {
+				stale_normals[ x + y * TERRAIN_ROW_VERTICES ] = 1;
+			}
+		}
+
+		for ( unsigned int y = ( chunk_y > 0 ) ? chunk_y - 1 : 0; y <= chunk_y + 1 && y < TERRAIN_CHUNK_ROW; ++y ) {
+			for ( unsigned int x = ( chunk_x > 0 ) ? chunk_x - 1 : 0; x <= chunk_x + 1 && x < TERRAIN_CHUNK_ROW; ++x ) {
+				states[ x + y * TERRAIN_CHUNK_ROW ] = CHUNK_SEAM;
+			}
+		}
+	}
+	for ( unsigned int i : chunks ) {
+		states[ i ] = CHUNK_REGENERATE;
+	}
+
+	// one row of the grid per job, regenerating each run of stale normals
+	for_each( TERRAIN_ROW_VERTICES, [ this, &stale_normals ]( unsigned int y ) {
+		const uint8_t* row = &stale_normals[ y * TERRAIN_ROW_VERTICES ];
+		for ( unsigned int x = 0; x < TERRAIN_ROW_VERTICES; ++x ) {
+			if ( !row[ x ] ) {
+				continue;
+			}
+
+			unsigned int end = x;
+			while ( end + 1 < TERRAIN_ROW_VERTICES && row[ end + 1 ] ) {
+				end++;
+			}
+
+			GenerateNormals( x, y, end, y );
+			x = end;
+		}
+	} );
+
+	for_each( chunks.size(), [ this, &chunks, by_name ]( unsigned int i ) {
+		GenerateChunk( chunks[ i ] % TERRAIN_CHUNK_ROW, chunks[ i ] / TERRAIN_CHUNK_ROW, by_name );
+	} );
+
+	std::vector<unsigned int> seams;
+	for ( unsigned int i = 0; i < chunks_.size(); ++i ) {
+		if ( states[ i ] == CHUNK_SEAM ) {
+			seams.push_back( i );
+		}
+	}
+
+	for_each( seams.size(), [ this, &seams ]( unsigned int i ) {
+		GenerateChunkNormals( seams[ i ] % TERRAIN_CHUNK_ROW, seams[ i ] / TERRAIN_CHUNK_ROW );
+	} );
+
+	for ( unsigned int i = 0; i < chunks_.size(); ++i ) {
+		if ( states[ i ] != CHUNK_UNCHANGED ) {
+			sectors_[ chunks_[ i ].sector ].dirty = true;
+		}
+	}
+}
+
+/**
+ * Regenerates anything that has been flagged as dirty since the last
+ * call. Editing a chunk only costs that chunk's mesh plus a normals
+ * refresh for the neighbouring chunks along its seams, and the overview
+ * pixels it covers, while changing a surface or behaviour only costs the
+ * overview pixels. Both the meshes and the overview are generated across
+ * the job pool, leaving only the uploads to this thread.
+ */
+void Terrain::Update() {
+	auto start = std::chrono::steady_clock::now();
+
+	std::vector<unsigned int> dirty_chunks;
+	std::vector<unsigned int> overview_chunks;
+	for ( unsigned int i = 0; i < chunks_.size(); ++i ) {
+		if ( chunks_[ i ].dirty ) {
+			dirty_chunks.push_back( i );
+		}
+		if ( chunks_[ i ].dirty || chunks_[ i ].overview_dirty ) {
+			overview_chunks.push_back( i );
+		}
+	}
+
+	// changing the overview's resolution means starting it over from scratch
+	unsigned int overview_scale = static_cast<unsigned int>(
+		std::min( std::max( cv_graphics_terrain_overview_scale->i_value, 1 ), TERRAIN_OVERVIEW_MAX_SCALE ) );
+	bool rescale_overview = ( overview_scale != overview_scale_ );
+	if ( rescale_overview ) {
+		overview_scale_ = overview_scale;
+		overview_pixels_.resize( GetOverviewWidth() * GetOverviewWidth() * 3 );
+	}
+
+	if ( overview_chunks.empty() && !rescale_overview ) {
+		return;
+	}
+
+	if ( !dirty_chunks.empty() ) {
+		GenerateMeshes( dirty_chunks, true );
+	}
+
+	auto generate_end = std::chrono::steady_clock::now();
+
+	// Meshes can only be uploaded whole, so any edit costs every level of its
+	// sector rather than just the chunk's range of them. That's a couple of
+	// thousand vertices, which is timed here to keep an eye on it.
+	unsigned int upload_bytes = 0;
+	for ( auto& sector : sectors_ ) {
+		if ( !sector.dirty ) {
+			continue;
+		}
+
+		for ( auto& lod : sector.lods ) {
+			PLMesh* mesh = plGetModelLodLevel( lod, 0 )->meshes[ 0 ];
+			plUploadMesh( mesh );
+			upload_bytes += mesh->num_verts * sizeof( PLVertex );
+		}
+		sector.dirty = false;
+	}
+
+	auto upload_end = std::chrono::steady_clock::now();
+
+	// The overview is shaded relative to the overall height range, so if
+	// that has moved then every pixel needs to be redone
+	float mid_height = ( GetMaxHeight() + GetMinHeight() ) / 2;
+	if ( mid_height != overview_mid_height_ || rescale_overview ) {
+		overview_mid_height_ = mid_height;
+		overview_chunks.resize( chunks_.size() );
+		for ( unsigned int i = 0; i < chunks_.size(); ++i ) {
+			overview_chunks[ i ] = i;
+		}
+	}
+
+	// each chunk only writes its own pixels
+	JobPool* jobs = openhow::Engine::Jobs();
+	auto generate_overview = [ this, &overview_chunks ]( unsigned int i ) {
+		GenerateOverview( overview_chunks[ i ] % TERRAIN_CHUNK_ROW, overview_chunks[ i ] / TERRAIN_CHUNK_ROW );
+	};
+	if ( jobs != nullptr ) {
+		jobs->ParallelFor( overview_chunks.size(), generate_overview );
+	} else {
+		for ( unsigned int i = 0; i < overview_chunks.size(); ++i ) {
+			generate_overview( i );
+		}
+	}
+	UploadOverview();
+
+	for ( unsigned int i : dirty_chunks ) {
+		chunks_[ i ].dirty = false;
+	}
+	for ( auto& chunk : chunks_ ) {
+		chunk.overview_dirty = false;
+	}
+
+	LogDebug( "Regenerated %u terrain chunks and %u overview chunks in %.2fms "
+			  "(%.2fms generating, %.2fms uploading %ukb)\n",
+			  static_cast<unsigned int>(dirty_chunks.size()), static_cast<unsigned int>(overview_chunks.size()),
+			  std::chrono::duration<double, std::milli>( std::chrono::steady_clock::now() - start ).count(),
+			  std::chrono::duration<double, std::milli>( generate_end - start ).count(),
+			  std::chrono::duration<double, std::milli>( upload_end - generate_end ).count(),
+			  static_cast<unsigned int>( plBytesToKilobytes( upload_bytes ) ) );
+}
+
+unsigned int Terrain::CullChunks( const ViewFrustum& frustum, const std::vector<Chunk>& chunks, std::vector<bool>& visible ) {
+	visible.resize( chunks.size() );
+
+	unsigned int num_visible = 0;
+	for ( unsigned int i = 0; i < chunks.size(); ++i ) {
+		visible[ i ] = frustum.IntersectsBox( chunks[ i ].bounds_min, chunks[ i ].bounds_max );
+		if ( visible[ i ] ) {
+			num_visible++;
+		}
+	}
+
+	return num_visible;
+}
+
+void Terrain::Draw() {
+	Shaders_SetProgramByName( cv_graphics_debug_normals->b_value ? "debug_normals" : "generic_textured_lit" );
+
+	Camera* camera = openhow::Engine::Game()->GetCamera();
+	if ( cv_graphics_cull->b_value ) {
+		CullChunks( camera->GetFrustum(), chunks_, visible_chunks_ );
+	} else {
+		std::fill( visible_chunks_.begin(), visible_chunks_.end(), true );
+	}
+
+	// Sectors are the smallest unit we can submit, so draw any with a visible chunk
+	unsigned int visible_sector_chunks[ TERRAIN_SECTORS ] = {};
+	PLVector3 sector_mins[ TERRAIN_SECTORS ];
+	PLVector3 sector_maxs[ TERRAIN_SECTORS ];
+	for ( unsigned int i = 0; i < chunks_.size(); ++i ) {
+		const Chunk& chunk = chunks_[ i ];
+		if ( visible_chunks_[ i ] ) {
+			visible_sector_chunks[ chunk.sector ]++;
+		}
+
+		PLVector3& mins = sector_mins[ chunk.sector ];
+		PLVector3& maxs = sector_maxs[ chunk.sector ];
+		if ( chunk.slot == 0 ) {
+			mins = chunk.bounds_min;
+			maxs = chunk.bounds_max;
+			continue;
+		}
+
+		mins = PLVector3( std::min( mins.x, chunk.bounds_min.x ), std::min( mins.y, chunk.bounds_min.y ),
+						  std::min( mins.z, chunk.bounds_min.z ) );
+		maxs = PLVector3( std::max( maxs.x, chunk.bounds_max.x ), std::max( maxs.y, chunk.bounds_max.y ),
+						  std::max( maxs.z, chunk.bounds_max.z ) );
+	}
+
+	PLVector3 camera_position = camera->GetPosition();
+	float lod_distance = cv_graphics_terrain_lod_distance->f_value;
+
+	g_state.gfx.num_chunks_drawn = 0;
+	g_state.gfx.num_chunks_total = TERRAIN_CHUNKS;
+	g_state.gfx.num_terrain_draws = 0;
+	for ( unsigned int i = 0; i < sectors_.size(); ++i ) {
+		if ( visible_sector_chunks[ i ] == 0 ) {
+			continue;
+		}
+
+		// Pick the level from the distance to the nearest point of the sector
+		unsigned int lod = 0;
+		if ( lod_distance > 0 ) {
+			float dx = std::max( std::max( sector_mins[ i ].x - camera_position.x, camera_position.x - sector_maxs[ i ].x ), 0.0f );
+			float dy = std::max( std::max( sector_mins[ i ].y - camera_position.y, camera_position.y - sector_maxs[ i ].y ), 0.0f );
+			float dz = std::max( std::max( sector_mins[ i ].z - camera_position.z, camera_position.z - sector_maxs[ i ].z ), 0.0f );
+			float distance = std::sqrt( dx * dx + dy * dy + dz * dz );
+			lod = std::min( static_cast<unsigned int>(distance / lod_distance), ( unsigned int ) TERRAIN_LODS - 1 );
+		}
+
+		// Only count what passed culling, the rest of the sector is drawn regardless
+		g_state.gfx.num_chunks_drawn += visible_sector_chunks[ i ];
+		g_state.gfx.num_terrain_draws++;
+		plDrawModel( sectors_[ i ].lods[ lod ] );
+	}
+}
+
+static uint16_t ReadLittleInt16( const uint8_t* data ) {
+	return static_cast<uint16_t>(data[ 0 ] | ( data[ 1 ] << 8U ));
+}
+
+static uint32_t ReadLittleInt32( const uint8_t* data ) {
+	return static_cast<uint32_t>(data[ 0 ]) | ( static_cast<uint32_t>(data[ 1 ]) << 8U ) |
+		( static_cast<uint32_t>(data[ 2 ]) << 16U ) | ( static_cast<uint32_t>(data[ 3 ]) << 24U );
+}
+
+/**
+ * Fields are assembled byte by byte, so this doesn't depend on the host's
+ * byte order or alignment. The record must be TERRAIN_PMG_CHUNK_BYTES long.
+ * Any tile with an out of range surface, rotation or texture is reset.
+ */
+unsigned int Terrain::DecodePmgChunk( const uint8_t* record, PmgChunk& chunk ) {
+	// header is only offsets, which we don't use
+	const uint8_t* vertices = record + 8;
+	const uint8_t* tiles = vertices + ( TERRAIN_CHUNK_VERTICES * 4 ) + 4;
+
+	for ( unsigned int i = 0; i < TERRAIN_CHUNK_VERTICES; ++i ) {
+		const uint8_t* vertex = vertices + i * 4;
+		chunk.heights[ i ] = static_cast<int16_t>(ReadLittleInt16( vertex ));
+		chunk.shading[ i ] = static_cast<uint8_t>(ReadLittleInt16( vertex + 2 ));
+	}
+
+	unsigned int num_invalid = 0;
+	for ( unsigned int i = 0; i < TERRAIN_CHUNK_TILES; ++i ) {
+		const uint8_t* tile = tiles + i * 16;
+		uint8_t type = tile[ 6 ];
+		uint8_t rotation = tile[ 10 ];
+		uint32_t texture = ReadLittleInt32( tile + 11 );
+		if ( rotation > 7 || texture > UINT8_MAX || ( type & 31U ) > Tile::SURFACE_LAVA ) {
+			type &= ~31U;
+			rotation = Tile::ROTATION_FLAG_NONE;
+			texture = 0;
+			num_invalid++;
+		}
+
+		chunk.surfaces[ i ] = type & 31U;
+		chunk.behaviours[ i ] = type & ~31U;
+		chunk.rotations[ i ] = rotation;
+		chunk.textures[ i ] = static_cast<uint8_t>(texture);
+	}
+
+	return num_invalid;
+}
+
+/**
+ * Decodes the tiles for every chunk from a complete pmg in a single pass.
+ * Returns false if the data is too short.
+ */
+bool Terrain::DecodePmg( const uint8_t* data, size_t length, Storage& storage, const char* path ) {
+	const size_t expected_length = TERRAIN_CHUNKS * TERRAIN_PMG_CHUNK_BYTES;
+	if ( length < expected_length ) {
+		LogWarn( "Unexpected size for \"%s\", %u bytes vs %u, aborting!\n",
+				 path, static_cast<unsigned int>(length), static_cast<unsigned int>(expected_length) );
+		return false;
+	} else if ( length > expected_length ) {
+		LogWarn( "Ignoring %u bytes of trailing data in \"%s\"!\n",
+				 static_cast<unsigned int>(length - expected_length), path );
+	}
+
+	unsigned int num_invalid = 0;
+	const uint8_t* record = data;
+	for ( unsigned int i = 0; i < TERRAIN_CHUNKS; ++i, record += TERRAIN_PMG_CHUNK_BYTES ) {
+		unsigned int chunk_x = i % TERRAIN_CHUNK_ROW;
+		unsigned int chunk_y = i / TERRAIN_CHUNK_ROW;
+
+		PmgChunk chunk;
+		num_invalid += DecodePmgChunk( record, chunk );
+
+		// vertices along the edges are shared with the neighbouring chunks
+		for ( unsigned int vertex_y = 0; vertex_y < TERRAIN_CHUNK_ROW_VERTICES; ++vertex_y ) {
+			unsigned int idx = ( chunk_x * TERRAIN_CHUNK_ROW_TILES ) +
+				( chunk_y * TERRAIN_CHUNK_ROW_TILES + vertex_y ) * TERRAIN_ROW_VERTICES;
+			memcpy( &storage.heights[ idx ], &chunk.heights[ vertex_y * TERRAIN_CHUNK_ROW_VERTICES ],
+					TERRAIN_CHUNK_ROW_VERTICES * sizeof( float ) );
+			memcpy( &storage.shading[ idx ], &chunk.shading[ vertex_y * TERRAIN_CHUNK_ROW_VERTICES ],
+					TERRAIN_CHUNK_ROW_VERTICES );
+		}
+
+		for ( unsigned int tile_y = 0; tile_y < TERRAIN_CHUNK_ROW_TILES; ++tile_y ) {
+			unsigned int idx = ( chunk_x * TERRAIN_CHUNK_ROW_TILES ) +
+				( chunk_y * TERRAIN_CHUNK_ROW_TILES + tile_y ) * TERRAIN_ROW_TILES;
+			unsigned int src = tile_y * TERRAIN_CHUNK_ROW_TILES;
+			memcpy( &storage.surfaces[ idx ], &chunk.surfaces[ src ], TERRAIN_CHUNK_ROW_TILES );
+			memcpy( &storage.behaviours[ idx ], &chunk.behaviours[ src ], TERRAIN_CHUNK_ROW_TILES );
+			memcpy( &storage.rotations[ idx ], &chunk.rotations[ src ], TERRAIN_CHUNK_ROW_TILES );
+			memcpy( &storage.textures[ idx ], &chunk.textures[ src ], TERRAIN_CHUNK_ROW_TILES );
+			memset( &storage.slips[ idx ], 0, TERRAIN_CHUNK_ROW_TILES );
+		}
+	}
+
+	if ( num_invalid > 0 ) {
+		LogWarn( "%u tiles in \"%s\" had an invalid surface, rotation or texture, reset!\n", num_invalid, path );
+	}
+
+	return true;
+}
+
+/**
+ * Loads the tiles in from the given pmg. The whole file is read in with a
+ * single read and then decoded in place, rather than field by field.
+ */
+void Terrain::LoadPmg( const std::string& path ) {
+	auto start = std::chrono::steady_clock::now();
+
+	PLFile* fh = plOpenFile( path.c_str(), false );
+	if ( fh == nullptr ) {
+		LogWarn( "Failed to open tile data, \"%s\", aborting\n", path.c_str() );
+		return;
+	}
+
+	std::vector<uint8_t> buffer( plGetFileSize( fh ) );
+	size_t length = plReadFile( fh, buffer.data(), sizeof( uint8_t ), buffer.size() );
+	plCloseFile( fh );
+
+	// nothing is written unless the pmg is valid, so a bad one leaves the terrain untouched
+	if ( !DecodePmg( buffer.data(), length, storage_, path.c_str() ) ) {
+		return;
+	}
+
+	cache_key_ = GetCacheKey( buffer.data(), length );
+	GenerateTileMasks();
+
+	for ( unsigned int chunk_y = 0; chunk_y < TERRAIN_CHUNK_ROW; ++chunk_y ) {
+		for ( unsigned int chunk_x = 0; chunk_x < TERRAIN_CHUNK_ROW; ++chunk_x ) {
+			Chunk& current_chunk = chunks_[ chunk_x + chunk_y * TERRAIN_CHUNK_ROW ];
+			current_chunk.dirty = true;
+
+			GenerateBounds( chunk_x, chunk_y );
+
+			// Find the maximum and minimum points
+			if ( current_chunk.bounds_max.y > max_height_ ) {
+				max_height_ = current_chunk.bounds_max.y;
+			}
+			if ( current_chunk.bounds_min.y < min_height_ ) {
+				min_height_ = current_chunk.bounds_min.y;
+			}
+		}
+	}
+
+	GenerateHeightPyramid( 0, 0, TERRAIN_ROW_TILES - 1, TERRAIN_ROW_TILES - 1 );
+
+	LogDebug( "Read \"%s\" in %.2fms\n", path.c_str(),
+			  std::chrono::duration<double, std::milli>( std::chrono::steady_clock::now() - start ).count() );
+
+	Update();
+}
+
+void Terrain::LoadHeightmap( const std::string& path, int multiplier ) {
+	PLImage image;
+	if ( !plLoadImage( path.c_str(), &image ) ) {
+		LogWarn( "Failed to load the specified heightmap, \"%s\" (%s)!\n", path.c_str(), plGetError() );
+		return;
+	}
+
+	if ( image.width < 65 || image.height < 65 ) {
+		plFreeImage( &image );
+		LogWarn( "Invalid image size for heightmap, %dx%d vs 65x65!\n", image.width, image.height );
+		return;
+	}
+
+	// Each channel is encoded with specific data
+	// red = height
+	// green = texture
+
+	unsigned int chan_length = image.width * image.height;
+
+	auto* rchan = static_cast<float*>(u_alloc( chan_length, sizeof( float ), true ));
+	uint8_t* pixel = image.data[ 0 ];
+	for ( unsigned int i = 0; i < chan_length; ++i ) {
+		rchan[ i ] = static_cast<int>(*pixel) * multiplier; //(static_cast<int>(*pixel) - 127) * 256;
+		pixel += 4;
+	}
+
+	auto* gchan = static_cast<uint8_t*>(u_alloc( chan_length, sizeof( uint8_t ), true ));
+	pixel = image.data[ 0 ] + 1;
+	for ( unsigned int i = 0; i < chan_length; ++i ) {
+		gchan[ i ] = *pixel;
+		pixel += 4;
+	}
+
+	plFreeImage( &image );
+
+	for ( unsigned int y = 0; y < TERRAIN_ROW_VERTICES; ++y ) {
+		for ( unsigned int x = 0; x < TERRAIN_ROW_VERTICES; ++x ) {
+			storage_.heights[ x + y * TERRAIN_ROW_VERTICES ] = rchan[ x + y * 65 ];
+			// hrm...
+			storage_.shading[ x + y * TERRAIN_ROW_VERTICES ] = 255;
+		}
+	}
+
+	for ( unsigned int y = 0; y < TERRAIN_ROW_TILES; ++y ) {
+		for ( unsigned int x = 0; x < TERRAIN_ROW_TILES; ++x ) {
+			storage_.textures[ x + y * TERRAIN_ROW_TILES ] = gchan[ x + y * 65 ];
+		}
+	}
+
+	max_height_ = min_height_ = rchan[ 0 ];
+	cache_key_ = 0;
+
+	for ( unsigned int chunk_y = 0; chunk_y < TERRAIN_CHUNK_ROW; ++chunk_y ) {
+		for ( unsigned int chunk_x = 0; chunk_x < TERRAIN_CHUNK_ROW; ++chunk_x ) {
+			Chunk& current_chunk = chunks_[ chunk_x + chunk_y * TERRAIN_CHUNK_ROW ];
+			current_chunk.dirty = true;
+
+			GenerateBounds( chunk_x, chunk_y );
+
+			// Find the maximum and minimum points
+			if ( current_chunk.bounds_max.y > max_height_ ) {
+				max_height_ = current_chunk.bounds_max.y;
+			}
+			if ( current_chunk.bounds_min.y < min_height_ ) {
+				min_height_ = current_chunk.bounds_min.y;
+			}
 		}
 	}
-	atlas_->Finalize();
 
-	chunks_.resize( TERRAIN_CHUNKS );
+	GenerateHeightPyramid( 0, 0, TERRAIN_ROW_TILES - 1, TERRAIN_ROW_TILES - 1 );
+
+	u_free( rchan );
+	u_free( gchan );
 
 	Update();
 }
 
-Terrain::~Terrain() {
-	delete atlas_;
-
-	for ( auto& chunk : chunks_ ) {
-		plDestroyModel( chunk.model );
-	}
+/**
+ * Key for the cooked terrain. The generated vertices depend on the pmg and,
+ * through their texture coords, where each tile ended up in the atlas.
+ */
+uint64_t Terrain::GetCacheKey( const uint8_t* pmg, size_t length ) const {
+	uint64_t key = u_hash( pmg, length, U_HASH_SEED );
+	key = u_hash( texture_coords_, sizeof( texture_coords_ ), key );
+	// zero is reserved for terrain that doesn't match its pmg
+	return ( key != 0 ) ? key : 1;
 }
 
-Terrain::Chunk* Terrain::GetChunk( const PLVector2& pos ) {
-	if ( pos.x < 0 || std::floor( pos.x ) >= TERRAIN_PIXEL_WIDTH ||
-		pos.y < 0 || std::floor( pos.y ) >= TERRAIN_PIXEL_WIDTH ) {
-		return nullptr;
-	}
+namespace {
+struct CacheHeader {
+	char magic[4];
+	uint32_t version;
+	uint64_t key;
+	uint32_t vertex_size;
+	uint32_t num_vertices[TERRAIN_LODS]; // per sector
+	uint32_t overview_scale;
+};
+}
 
-	uint idx =
-		( ( uint ) ( pos.x ) / TERRAIN_CHUNK_PIXEL_WIDTH )
-			+ ( ( ( uint ) ( pos.y ) / TERRAIN_CHUNK_PIXEL_WIDTH ) * TERRAIN_CHUNK_ROW );
-	if ( idx >= chunks_.size() ) {
-		LogWarn( "Attempted to get an out of bounds chunk index (%d)!\n", idx );
-		return nullptr;
+/**
+ * Everything is written out exactly as it's held in memory, as the cache
+ * is only ever meant to be read back on the same machine. If the terrain
+ * has been edited since it was loaded, it's not written at all.
+ */
+void Terrain::Serialize( const std::string& path ) {
+	if ( cache_key_ == 0 ) {
+		LogDebug( "Terrain wasn't loaded from a pmg or has since been edited, not writing \"%s\"\n", path.c_str() );
+		return;
 	}
 
-	return &chunks_[ idx ];
-}
+	// make sure there's nothing outstanding before writing out the meshes
+	Update();
 
-Terrain::Tile* Terrain::GetTile( const PLVector2& pos ) {
-	Chunk* chunk = GetChunk( pos );
-	if ( chunk == nullptr ) {
-		return nullptr;
+	FILE* fp = fopen( path.c_str(), "wb" );
+	if ( fp == nullptr ) {
+		LogWarn( "Failed to write terrain cache to \"%s\"!\n", path.c_str() );
+		return;
 	}
 
-	uint idx = ( ( ( uint ) ( pos.x ) / TERRAIN_TILE_PIXEL_WIDTH ) % TERRAIN_CHUNK_ROW_TILES ) +
-		( ( ( ( uint ) ( pos.y ) / TERRAIN_TILE_PIXEL_WIDTH ) % TERRAIN_CHUNK_ROW_TILES ) * TERRAIN_CHUNK_ROW_TILES );
-	if ( idx >= TERRAIN_CHUNK_TILES ) {
-		LogWarn( "Attempted to get an out of bounds tile index!\n" );
-		return nullptr;
+	CacheHeader header{};
+	memcpy( header.magic, "HTRC", sizeof( header.magic ) );
+	header.version = TERRAIN_CACHE_VERSION;
+	header.key = cache_key_;
+	header.vertex_size = sizeof( PLVertex );
+	for ( unsigned int i = 0; i < TERRAIN_LODS; ++i ) {
+		header.num_vertices[ i ] = plGetModelLodLevel( sectors_[ 0 ].lods[ i ], 0 )->meshes[ 0 ]->num_verts;
 	}
+	header.overview_scale = overview_scale_;
 
-	return &chunk->tiles[ idx ];
-}
+	bool status = true;
+	auto write = [ fp, &status ]( const void* data, size_t size ) {
+		status = status && ( fwrite( data, 1, size, fp ) == size );
+	};
 
-float Terrain::GetHeight( const PLVector2& pos ) {
-	Tile* tile = GetTile( pos );
-	if ( tile == nullptr ) {
-		return 0;
+	write( &header, sizeof( header ) );
+	write( storage_.heights.data(), storage_.heights.size() * sizeof( float ) );
+	write( storage_.shading.data(), storage_.shading.size() );
+	write( storage_.surfaces.data(), storage_.surfaces.size() );
+	write( storage_.behaviours.data(), storage_.behaviours.size() );
+	write( storage_.slips.data(), storage_.slips.size() );
+	write( storage_.textures.data(), storage_.textures.size() );
+	write( storage_.rotations.data(), storage_.rotations.size() );
+	write( normals_.data(), normals_.size() * sizeof( PLVector3 ) );
+	write( &min_height_, sizeof( min_height_ ) );
+	write( &max_height_, sizeof( max_height_ ) );
+	write( overview_pixels_.data(), overview_pixels_.size() );
+	write( &overview_mid_height_, sizeof( overview_mid_height_ ) );
+	for ( const auto& sector : sectors_ ) {
+		for ( unsigned int i = 0; i < TERRAIN_LODS; ++i ) {
+			PLMesh* mesh = plGetModelLodLevel( sector.lods[ i ], 0 )->meshes[ 0 ];
+			write( mesh->vertices, header.num_vertices[ i ] * sizeof( PLVertex ) );
+		}
 	}
 
-	float tile_x = pos.x - std::floor( pos.x );
-	float tile_y = pos.y - std::floor( pos.y );
-
-	float x = tile->height[ 0 ] + ( ( tile->height[ 1 ] - tile->height[ 0 ] ) * tile_x );
-	float y = tile->height[ 2 ] + ( ( tile->height[ 3 ] - tile->height[ 2 ] ) * tile_x );
-	float z = x + ( ( y - x ) * tile_y );
+	fclose( fp );
 
-	return z;
+	if ( !status ) {
+		LogWarn( "Failed to write terrain cache to \"%s\"!\n", path.c_str() );
+		remove( path.c_str() );
+	}
 }
 
-void Terrain::GenerateModel( Chunk* chunk, const PLVector2& offset ) {
-	if ( chunk->model != nullptr ) {
-		plDestroyModel( chunk->model );
-		chunk->model = nullptr;
-	}
+/**
+ * Loads the terrain written by Serialize, so long as the given pmg and the tileset
+ * still match what it was generated from. This skips parsing the pmg and generating
+ * any of the meshes, normals or overview; everything goes straight into place.
+ * Returns false, leaving the terrain untouched, if the cache is missing or stale.
+ */
+bool Terrain::Deserialize( const std::string& path, const std::string& pmg_path ) {
+	auto start = std::chrono::steady_clock::now();
 
-	PLMesh
-		* chunk_mesh = plCreateMeshInit( PL_MESH_TRIANGLES, PL_DRAW_DYNAMIC, 32, 64, ( void* ) chunk_indices, nullptr );
-	if ( chunk_mesh == nullptr ) {
-		Error( "Unable to create map chunk mesh, aborting (%s)!\n", plGetError() );
+	PLFile* fh = plOpenFile( pmg_path.c_str(), false );
+	if ( fh == nullptr ) {
+		return false;
 	}
 
-	int cm_idx = 0;
-	for ( unsigned int tile_y = 0; tile_y < TERRAIN_CHUNK_ROW_TILES; ++tile_y ) {
-		for ( unsigned int tile_x = 0; tile_x < TERRAIN_CHUNK_ROW_TILES; ++tile_x ) {
-			const Tile* current_tile = &chunk->tiles[ tile_x + tile_y * TERRAIN_CHUNK_ROW_TILES ];
-
-			float tx_x, tx_y, tx_w, tx_h;
-			atlas_->GetTextureCoords( std::to_string( current_tile->texture ), &tx_x, &tx_y, &tx_w, &tx_h );
-
-			// TERRAIN_FLIP_FLAG_X flips around texture sheet coords, not TERRAIN coords.
-			if ( current_tile->rotation & Tile::ROTATION_FLAG_X ) {
-				tx_x = tx_x + tx_w;
-				tx_w = -tx_w;
-			}
-
-			// ST coords for each corner of the tile.
-			float tx_Ax[] = { tx_x, tx_x + tx_w, tx_x, tx_x + tx_w };
-			float tx_Ay[] = { tx_y, tx_y, tx_y + tx_h, tx_y + tx_h };
-
-			// Rotate a quad of ST coords 90 degrees clockwise.
-			auto rot90 = []( float* x ) {
-				float c = x[ 0 ];
-				x[ 0 ] = x[ 2 ];
-				x[ 2 ] = x[ 3 ];
-				x[ 3 ] = x[ 1 ];
-				x[ 1 ] = c;
-			};
+	std::vector<uint8_t> pmg( plGetFileSize( fh ) );
+	size_t pmg_length = plReadFile( fh, pmg.data(), sizeof( uint8_t ), pmg.size() );
+	plCloseFile( fh );
+	uint64_t key = GetCacheKey( pmg.data(), pmg_length );
 
-			if ( current_tile->rotation & Tile::ROTATION_FLAG_ROTATE_90 ) {
-				rot90( tx_Ax );
-				rot90( tx_Ay );
-			}
+	FILE* fp = fopen( path.c_str(), "rb" );
+	if ( fp == nullptr ) {
+		return false;
+	}
 
-			if ( current_tile->rotation & Tile::ROTATION_FLAG_ROTATE_180 ) {
-				rot90( tx_Ax );
-				rot90( tx_Ay );
-				rot90( tx_Ax );
-				rot90( tx_Ay );
-			}
+	bool status = true;
+	auto read = [ fp, &status ]( void* data, size_t size ) {
+		status = status && ( fread( data, 1, size, fp ) == size );
+	};
 
-			// MAP_FLIP_FLAG_ROTATE_270 is implemented by ORing 90 and 180 together.
+	CacheHeader header{};
+	read( &header, sizeof( header ) );
+	if ( !status || memcmp( header.magic, "HTRC", sizeof( header.magic ) ) != 0 ||
+		header.version != TERRAIN_CACHE_VERSION || header.key != key || header.vertex_size != sizeof( PLVertex ) ||
+		header.overview_scale == 0 || header.overview_scale > TERRAIN_OVERVIEW_MAX_SCALE ) {
+		fclose( fp );
+		LogInfo( "Terrain cache \"%s\" is out of date, ignoring\n", path.c_str() );
+		return false;
+	}
 
-			for ( int i = 0; i < 4; ++i, ++cm_idx ) {
-				float x = ( offset.x * TERRAIN_CHUNK_PIXEL_WIDTH ) + ( tile_x + ( i % 2 ) ) * TERRAIN_TILE_PIXEL_WIDTH;
-				float z = ( offset.y * TERRAIN_CHUNK_PIXEL_WIDTH ) + ( tile_y + ( i / 2 ) ) * TERRAIN_TILE_PIXEL_WIDTH;
-				plSetMeshVertexST( chunk_mesh, cm_idx, tx_Ax[ i ], tx_Ay[ i ] );
-				plSetMeshVertexPosition( chunk_mesh, cm_idx, { x, current_tile->height[ i ], z } );
-				plSetMeshVertexColour( chunk_mesh, cm_idx, {
-					current_tile->shading[ i ],
-					current_tile->shading[ i ],
-					current_tile->shading[ i ] } );
-			}
+	for ( unsigned int i = 0; i < TERRAIN_LODS; ++i ) {
+		if ( header.num_vertices[ i ] != plGetModelLodLevel( sectors_[ 0 ].lods[ i ], 0 )->meshes[ 0 ]->num_verts ) {
+			fclose( fp );
+			LogInfo( "Terrain cache \"%s\" is out of date, ignoring\n", path.c_str() );
+			return false;
 		}
 	}
 
-	chunk_mesh->texture = atlas_->GetTexture();
+	// read everything in before touching the terrain, in case the cache is truncated
+	Storage storage;
+	std::vector<PLVector3> normals( normals_.size() );
+	float min_height, max_height, mid_height;
+	unsigned int overview_width = TERRAIN_ROW_TILES * header.overview_scale;
+	std::vector<uint8_t> overview_pixels( overview_width * overview_width * 3 );
+	read( storage.heights.data(), storage.heights.size() * sizeof( float ) );
+	read( storage.shading.data(), storage.shading.size() );
+	read( storage.surfaces.data(), storage.surfaces.size() );
+	read( storage.behaviours.data(), storage.behaviours.size() );
+	read( storage.slips.data(), storage.slips.size() );
+	read( storage.textures.data(), storage.textures.size() );
+	read( storage.rotations.data(), storage.rotations.size() );
+	read( normals.data(), normals.size() * sizeof( PLVector3 ) );
+	read( &min_height, sizeof( min_height ) );
+	read( &max_height, sizeof( max_height ) );
+	read( overview_pixels.data(), overview_pixels.size() );
+	read( &mid_height, sizeof( mid_height ) );
+
+	std::vector<PLVertex> vertices;
+	for ( unsigned int i = 0; i < TERRAIN_LODS; ++i ) {
+		vertices.resize( vertices.size() + header.num_vertices[ i ] * sectors_.size() );
+	}
+	read( vertices.data(), vertices.size() * sizeof( PLVertex ) );
+	fclose( fp );
 
-	// attach the mesh to our model
-	PLModel* model = plCreateBasicStaticModel( chunk_mesh );
-	if ( model == nullptr ) {
-		Error( "Failed to create map model (%s), aborting!\n", plGetError() );
+	if ( !status ) {
+		LogWarn( "Terrain cache \"%s\" is truncated, ignoring!\n", path.c_str() );
+		return false;
 	}
 
-	chunk->model = model;
-}
+	storage_ = std::move( storage );
+	normals_ = std::move( normals );
+	min_height_ = min_height;
+	max_height_ = max_height;
+	overview_pixels_ = std::move( overview_pixels );
+	overview_scale_ = header.overview_scale;
+	overview_mid_height_ = mid_height;
+	cache_key_ = key;
+
+	const PLVertex* vertex = vertices.data();
+	for ( auto& sector : sectors_ ) {
+		for ( unsigned int i = 0; i < TERRAIN_LODS; ++i ) {
+			PLMesh* mesh = plGetModelLodLevel( sector.lods[ i ], 0 )->meshes[ 0 ];
+			memcpy( mesh->vertices, vertex, header.num_vertices[ i ] * sizeof( PLVertex ) );
+			vertex += header.num_vertices[ i ];
+			plUploadMesh( mesh );
+		}
+		sector.dirty = false;
+	}
 
-void Terrain::GenerateOverview() {
-	static const PLColour colours[] = {
-		{ 60, 50, 40 },     // Mud
-		{ 40, 70, 40 },     // Grass
-		{ 128, 128, 128 },  // Metal
-		{ 153, 94, 34 },    // Wood
-		{ 90, 90, 150 },    // Water
-		{ 50, 50, 50 },     // Stone
-		{ 50, 50, 50 },     // Rock
-		{ 100, 80, 30 },    // Sand
-		{ 180, 240, 240 },  // Ice
-		{ 100, 100, 100 },  // Snow
-		{ 60, 50, 40 },     // Quagmire
-		{ 100, 240, 53 }    // Lava/Poison
-	};
+	for ( unsigned int chunk_y = 0; chunk_y < TERRAIN_CHUNK_ROW; ++chunk_y ) {
+		for ( unsigned int chunk_x = 0; chunk_x < TERRAIN_CHUNK_ROW; ++chunk_x ) {
+			chunks_[ chunk_x + chunk_y * TERRAIN_CHUNK_ROW ].dirty = false;
+			chunks_[ chunk_x + chunk_y * TERRAIN_CHUNK_ROW ].overview_dirty = false;
+			GenerateBounds( chunk_x, chunk_y );
+		}
+	}
+	GenerateHeightPyramid( 0, 0, TERRAIN_ROW_TILES - 1, TERRAIN_ROW_TILES - 1 );
+	GenerateTileMasks();
 
-	// Create our storage
-	PLImage* image = plCreateImage( nullptr, 64, 64, PL_COLOURFORMAT_RGB, PL_IMAGEFORMAT_RGB8 );
+	UploadOverview();
 
-	// Now write into the image buffer
-	uint8_t* buf = image->data[ 0 ];
-	for ( uint8_t y = 0; y < 64; ++y ) {
-		for ( uint8_t x = 0; x < 64; ++x ) {
-			PLVector2 position( x * ( TERRAIN_PIXEL_WIDTH / 64 ), y * ( TERRAIN_PIXEL_WIDTH / 64 ) );
-			Tile* tile = GetTile( position );
-			u_assert( tile != nullptr, "Hit an invalid tile during overview generation!\n" );
+	LogDebug( "Read terrain cache \"%s\" in %.2fms\n", path.c_str(),
+			  std::chrono::duration<double, std::milli>( std::chrono::steady_clock::now() - start ).count() );
+	return true;
+}
 
-			auto mod = static_cast<int>(( GetHeight( position ) + ( ( GetMaxHeight() + GetMinHeight() ) / 2 ) ) / 255);
-			PLColour rgb = PLColour(
-				std::min( ( colours[ tile->surface ].r / 9 ) * mod, 255 ),
-				std::min( ( colours[ tile->surface ].g / 9 ) * mod, 255 ),
-				std::min( ( colours[ tile->surface ].b / 9 ) * mod, 255 )
-			);
-			if ( tile->behaviour & Tile::BEHAVIOUR_MINE ) {
-				rgb = PLColour( 255, 0, 0 );
-			}
+/**
+ * Writes out the current map's overview as it was last generated, at
+ * whatever resolution it's currently being generated at.
+ * Usage: TerrainDumpOverview [path]
+ */
+void Terrain::DumpOverviewCommand( unsigned int argc, char** argv ) {
+	Map* map = openhow::Engine::Game()->GetCurrentMap();
+	if ( map == nullptr || map->GetTerrain() == nullptr ) {
+		LogWarn( "No map loaded, ignoring!\n" );
+		return;
+	}
 
-			*( buf++ ) = rgb.r;
-			*( buf++ ) = rgb.g;
-			*( buf++ ) = rgb.b;
+	Terrain* terrain = map->GetTerrain();
+	std::string path;
+	if ( argc > 1 ) {
+		path = argv[ 1 ];
+	} else {
+		if ( !plCreatePath( "./debug/generated/" ) ) {
+			LogWarn( "Failed to create \"./debug/generated/\"!\n%s\n", plGetError() );
+			return;
 		}
+
+		path = "./debug/generated/overview_" + std::to_string( terrain->GetOverviewWidth() ) + ".png";
 	}
 
-#ifdef _DEBUG
-	if ( plCreatePath( "./debug/generated/" ) ) {
-		char path[PL_SYSTEM_MAX_PATH];
-		static unsigned int id = 0;
-		snprintf( path, sizeof( path ) - 1, "./debug/generated/%dx%d_%d.png",
-				  image->width, image->height, id );
-		plWriteImage( image, path );
+	if ( !terrain->WriteOverview( path ) ) {
+		LogWarn( "Failed to write overview to \"%s\"!\n%s\n", path.c_str(), plGetError() );
+		return;
 	}
-#endif
 
-	// Allow rebuilding overview texture
-	plDestroyTexture( overview_ );
+	LogInfo( "Wrote %ux%u overview to \"%s\"\n", terrain->GetOverviewWidth(), terrain->GetOverviewWidth(), path.c_str() );
+}
 
-	if ( ( overview_ = plCreateTexture() ) == nullptr ) {
-		Error( "Failed to generate overview texture slot!\n%s\n", plGetError() );
+namespace {
+/**
+ * Always starts from the same seed, so benchmark runs are comparable.
+ */
+class BenchmarkRandom {
+public:
+	// Anywhere from zero up to, but not including, range
+	float Next( unsigned int range ) {
+		seed_ = seed_ * 1103515245 + 12345;
+		return static_cast<float>(( seed_ >> 8 ) % range);
 	}
 
-	plUploadTextureImage( overview_, image );
-	plDestroyImage( image );
+private:
+	unsigned int seed_{ 1 };
+};
 }
 
-void Terrain::Update() {
-	GenerateOverview();
+/**
+ * Compares the scalar height query against the batched one at random positions.
+ */
+void Terrain::BenchmarkHeights( Map* map, unsigned int num_samples ) {
+	Terrain* terrain = map->GetTerrain();
+
+	std::vector<PLVector2> positions( num_samples );
+	BenchmarkRandom random;
+	for ( auto& position : positions ) {
+		position.x = random.Next( TERRAIN_PIXEL_WIDTH * 16 ) / 16.0f;
+		position.y = random.Next( TERRAIN_PIXEL_WIDTH * 16 ) / 16.0f;
+	}
 
-	for ( unsigned int chunk_y = 0; chunk_y < TERRAIN_CHUNK_ROW; ++chunk_y ) {
-		for ( unsigned int chunk_x = 0; chunk_x < TERRAIN_CHUNK_ROW; ++chunk_x ) {
-			GenerateModel( &chunks_[ chunk_x + chunk_y * TERRAIN_CHUNK_ROW ],
-						   { static_cast<float>(chunk_x), static_cast<float>(chunk_y) } );
-		}
+	std::vector<float> scalar( num_samples );
+	std::vector<float> batched( num_samples );
+
+	auto start = std::chrono::steady_clock::now();
+	for ( unsigned int i = 0; i < num_samples; ++i ) {
+		scalar[ i ] = terrain->GetHeight( positions[ i ] );
 	}
+	auto scalar_end = std::chrono::steady_clock::now();
+	terrain->GetHeights( positions.data(), batched.data(), num_samples );
+	auto batched_end = std::chrono::steady_clock::now();
 
-	std::list<PLMesh*> meshes;
-	for ( auto& chunk : chunks_ ) {
-		PLModelLod* lod = plGetModelLodLevel( chunk.model, 0 );
-		meshes.push_back( lod->meshes[ 0 ] );
+	float max_error = 0;
+	for ( unsigned int i = 0; i < num_samples; ++i ) {
+		max_error = std::max( max_error, std::fabs( scalar[ i ] - batched[ i ] ) );
 	}
 
-	Mesh_GenerateFragmentedMeshNormals( meshes );
+	double scalar_ms = std::chrono::duration<double, std::milli>( scalar_end - start ).count();
+	double batched_ms = std::chrono::duration<double, std::milli>( batched_end - scalar_end ).count();
+	LogInfo( "GetHeight:  %u samples in %.3fms\n", num_samples, scalar_ms );
+	LogInfo( "GetHeights: %u samples in %.3fms (%.2fx, max error %f)\n",
+			 num_samples, batched_ms, scalar_ms / batched_ms, max_error );
 }
 
-void Terrain::Draw() {
-	Shaders_SetProgramByName( cv_graphics_debug_normals->b_value ? "debug_normals" : "generic_textured_lit" );
+/**
+ * Generates every chunk's mesh serially and then on the job pool, checking both match,
+ * and then times single chunk edits through Update, uploads and all.
+ */
+void Terrain::BenchmarkMeshes( Map* map, unsigned int num_samples ) {
+	Terrain* terrain = map->GetTerrain();
 
-	g_state.gfx.num_chunks_drawn = 0;
-	for ( const auto& chunk : chunks_ ) {
-		if ( chunk.model == nullptr ) {
-			continue;
+	std::vector<unsigned int> chunks( terrain->chunks_.size() );
+	for ( unsigned int i = 0; i < chunks.size(); ++i ) {
+		chunks[ i ] = i;
+	}
+
+	auto start = std::chrono::steady_clock::now();
+	for ( unsigned int i = 0; i < num_samples; ++i ) {
+		terrain->GenerateMeshes( chunks, false );
+	}
+	auto serial_end = std::chrono::steady_clock::now();
+
+	std::vector<std::vector<PLVertex>> serial_vertices;
+	for ( auto& sector : terrain->sectors_ ) {
+		for ( auto& lod : sector.lods ) {
+			PLMesh* mesh = plGetModelLodLevel( lod, 0 )->meshes[ 0 ];
+			serial_vertices.emplace_back( mesh->vertices, mesh->vertices + mesh->num_verts );
+		}
+	}
+
+	auto parallel_start = std::chrono::steady_clock::now();
+	for ( unsigned int i = 0; i < num_samples; ++i ) {
+		terrain->GenerateMeshes( chunks, true );
+	}
+	auto parallel_end = std::chrono::steady_clock::now();
+
+	// The output should match byte for byte, regardless of how the jobs were scheduled
+	unsigned int num_mismatches = 0;
+	unsigned int mesh_idx = 0;
+	for ( auto& sector : terrain->sectors_ ) {
+		for ( auto& lod : sector.lods ) {
+			PLMesh* mesh = plGetModelLodLevel( lod, 0 )->meshes[ 0 ];
+			const std::vector<PLVertex>& expected = serial_vertices[ mesh_idx++ ];
+			for ( unsigned int i = 0; i < mesh->num_verts; ++i ) {
+				if ( memcmp( &mesh->vertices[ i ], &expected[ i ], sizeof( PLVertex ) ) != 0 ) {
+					num_mismatches++;
+				}
+			}
 		}
 
-		g_state.gfx.num_chunks_drawn++;
-		plDrawModel( chunk.model );
+		// nothing has changed since the last upload
+		sector.dirty = false;
+	}
+
+	// and then what a single edit costs in game, from regenerating through to uploading its sector
+	BenchmarkRandom random;
+	auto edit_start = std::chrono::steady_clock::now();
+	for ( unsigned int i = 0; i < num_samples; ++i ) {
+		terrain->chunks_[ static_cast<unsigned int>(random.Next( TERRAIN_CHUNKS )) ].dirty = true;
+		terrain->Update();
 	}
+	auto edit_end = std::chrono::steady_clock::now();
+
+	JobPool* jobs = openhow::Engine::Jobs();
+	double serial_ms = std::chrono::duration<double, std::milli>( serial_end - start ).count();
+	double parallel_ms = std::chrono::duration<double, std::milli>( parallel_end - parallel_start ).count();
+	double edit_ms = std::chrono::duration<double, std::milli>( edit_end - edit_start ).count();
+	LogInfo( "Serial:   %u passes in %.3fms (%.3fms each)\n", num_samples, serial_ms, serial_ms / num_samples );
+	LogInfo( "Parallel: %u passes in %.3fms (%.3fms each, %.2fx, %u workers, %u mismatches)\n",
+			 num_samples, parallel_ms, parallel_ms / num_samples, serial_ms / parallel_ms,
+			 ( jobs != nullptr ) ? jobs->GetNumWorkers() : 0, num_mismatches );
+	LogInfo( "Edits:    %u single chunk updates in %.3fms (%.3fms each, including upload)\n",
+			 num_samples, edit_ms, edit_ms / num_samples );
 }
 
-void Terrain::LoadPmg( const std::string& path ) {
-	PLFile* fh = plOpenFile( path.c_str(), false );
-	if ( fh == nullptr ) {
-		LogWarn( "Failed to open tile data, \"%s\", aborting\n", path.c_str() );
-		return;
+/**
+ * Culls every chunk against random views of the terrain.
+ */
+void Terrain::BenchmarkCull( Map* map, unsigned int num_samples ) {
+	Terrain* terrain = map->GetTerrain();
+
+	// views are from above the terrain, looking down at the same angle as the game camera
+	std::vector<ViewFrustum> frustums( num_samples );
+	BenchmarkRandom random;
+	for ( auto& frustum : frustums ) {
+		float x = random.Next( TERRAIN_PIXEL_WIDTH );
+		float z = random.Next( TERRAIN_PIXEL_WIDTH );
+		float yaw = plDegreesToRadians( random.Next( 360 ) );
+		float pitch = plDegreesToRadians( -25.f );
+		frustum = ViewFrustum::FromView(
+			PLVector3( x, terrain->GetMaxHeight() + 500.f, z ),
+			PLVector3( cosf( yaw ) * cosf( pitch ), sinf( pitch ), sinf( yaw ) * cosf( pitch ) ),
+			cv_camera_fov->f_value, 4.f / 3.f, cv_camera_near->f_value, cv_camera_far->f_value );
+	}
+
+	std::vector<bool> visible;
+	unsigned long long total_visible = 0;
+	auto start = std::chrono::steady_clock::now();
+	for ( const auto& frustum : frustums ) {
+		total_visible += CullChunks( frustum, terrain->chunks_, visible );
 	}
+	double ms = std::chrono::duration<double, std::milli>( std::chrono::steady_clock::now() - start ).count();
+
+	LogInfo( "CullChunks: %u views in %.3fms (%.3fus each, %.1f/%u chunks visible on average)\n",
+			 num_samples, ms, ( ms * 1000.0 ) / num_samples,
+			 static_cast<double>(total_visible) / num_samples, TERRAIN_CHUNKS );
+}
 
+/**
+ * Reads in the tiles field by field from an open pmg. This is how pmgs were
+ * originally loaded, and is only kept around for comparison by BenchmarkPmg.
+ */
+bool Terrain::ReadPmgStreamed( PLFile* fh, Storage& storage ) {
 	for ( unsigned int chunk_y = 0; chunk_y < TERRAIN_CHUNK_ROW; ++chunk_y ) {
 		for ( unsigned int chunk_x = 0; chunk_x < TERRAIN_CHUNK_ROW; ++chunk_x ) {
-			Chunk& current_chunk = chunks_[ chunk_x + chunk_y * TERRAIN_CHUNK_ROW ];
-
 			struct __attribute__((packed)) {
 				/* offsets */
 				uint16_t x{ 0 };
@@ -319,7 +2049,8 @@ void Terrain::LoadPmg( const std::string& path ) {
 			chunk.unknown0 = plReadInt16( fh, false, &status );
 
 			if ( !status ) {
-				Error( "Failed to read in chunk descriptor in \"%s\"!\n", plGetFilePath( fh ) );
+				LogWarn( "Failed to read in chunk descriptor in \"%s\"!\n", plGetFilePath( fh ) );
+				return false;
 			}
 
 			struct __attribute__((packed)) {
@@ -327,21 +2058,21 @@ void Terrain::LoadPmg( const std::string& path ) {
 				uint16_t lighting{ 0 };
 			} vertices[25];
 
-			// Find the maximum and minimum points
 			for ( auto& vertex : vertices ) {
 				vertex.height = plReadInt16( fh, false, &status );
 				vertex.lighting = plReadInt16( fh, false, &status );
 
 				if ( !status ) {
-					Error( "Failed to read in vertex descriptor in \"%s\"!\n", plGetFilePath( fh ) );
+					LogWarn( "Failed to read in vertex descriptor in \"%s\"!\n", plGetFilePath( fh ) );
+					return false;
 				}
+			}
 
-				if ( static_cast<float>(vertex.height) > max_height_ ) {
-					max_height_ = vertex.height;
-				}
-				if ( static_cast<float>(vertex.height) < min_height_ ) {
-					min_height_ = vertex.height;
-				}
+			for ( unsigned int i = 0; i < 25; ++i ) {
+				unsigned int idx = ( chunk_x * TERRAIN_CHUNK_ROW_TILES + ( i % 5 ) ) +
+					( chunk_y * TERRAIN_CHUNK_ROW_TILES + ( i / 5 ) ) * TERRAIN_ROW_VERTICES;
+				storage.heights[ idx ] = vertices[ i ].height;
+				storage.shading[ idx ] = vertices[ i ].lighting;
 			}
 
 			plFileSeek( fh, 4, PL_SEEK_CUR );
@@ -360,7 +2091,8 @@ void Terrain::LoadPmg( const std::string& path ) {
 
 					// Skip unused data
 					if ( plReadFile( fh, tile.unused0, 6, 1 ) != 1 ) {
-						Error( "Failed to skip unused bytes in \"%s\"!\n", plGetFilePath( fh ) );
+						LogWarn( "Failed to skip unused bytes in \"%s\"!\n", plGetFilePath( fh ) );
+						return false;
 					}
 
 					tile.type = plReadInt8( fh, &status );
@@ -371,110 +2103,390 @@ void Terrain::LoadPmg( const std::string& path ) {
 					tile.unused2 = plReadInt8( fh, &status );
 
 					if ( !status ) {
-						Error( "Failed to read in tile descriptor in \"%s\"!\n", plGetFilePath( fh ) );
+						LogWarn( "Failed to read in tile descriptor in \"%s\"!\n", plGetFilePath( fh ) );
+						return false;
 					}
 
-					Tile* current_tile = &current_chunk.tiles[ tile_x + tile_y * TERRAIN_CHUNK_ROW_TILES ];
-					current_tile->surface = static_cast<Tile::Surface>(tile.type & 31U);
-					current_tile->behaviour = static_cast<Tile::Behaviour>(tile.type & ~31U);
-					current_tile->rotation = static_cast<Tile::Rotation>(tile.rotation);
-					current_tile->slip = 0;
-					current_tile->texture = tile.texture;
-
-					current_tile->height[ 0 ] = vertices[ ( tile_y * 5 ) + tile_x ].height;
-					current_tile->height[ 1 ] = vertices[ ( tile_y * 5 ) + tile_x + 1 ].height;
-					current_tile->height[ 2 ] = vertices[ ( ( tile_y + 1 ) * 5 ) + tile_x ].height;
-					current_tile->height[ 3 ] = vertices[ ( ( tile_y + 1 ) * 5 ) + tile_x + 1 ].height;
-
-					current_tile->shading[ 0 ] = vertices[ ( tile_y * 5 ) + tile_x ].lighting;
-					current_tile->shading[ 1 ] = vertices[ ( tile_y * 5 ) + tile_x + 1 ].lighting;
-					current_tile->shading[ 2 ] = vertices[ ( ( tile_y + 1 ) * 5 ) + tile_x ].lighting;
-					current_tile->shading[ 3 ] = vertices[ ( ( tile_y + 1 ) * 5 ) + tile_x + 1 ].lighting;
+					unsigned int idx = ( chunk_x * TERRAIN_CHUNK_ROW_TILES + tile_x ) +
+						( chunk_y * TERRAIN_CHUNK_ROW_TILES + tile_y ) * TERRAIN_ROW_TILES;
+					storage.surfaces[ idx ] = tile.type & 31U;
+					storage.behaviours[ idx ] = tile.type & ~31U;
+					storage.rotations[ idx ] = tile.rotation;
+					storage.slips[ idx ] = 0;
+					storage.textures[ idx ] = tile.texture;
 				}
 			}
 		}
 	}
 
-	plCloseFile( fh );
+	return true;
+}
 
-	Update();
+/**
+ * Compares loading the current map's pmg field by field, as it originally was,
+ * against reading it in whole and decoding it, checking both come out the same.
+ */
+void Terrain::BenchmarkPmg( Map* map, unsigned int num_samples ) {
+	std::string path = "maps/" + map->GetManifest()->filename + "/" + map->GetManifest()->filename + ".pmg";
+	Storage streamed;
+	Storage bulk;
+
+	auto start = std::chrono::steady_clock::now();
+	for ( unsigned int i = 0; i < num_samples; ++i ) {
+		PLFile* fh = plOpenFile( path.c_str(), false );
+		if ( fh == nullptr ) {
+			LogWarn( "Failed to open \"%s\", aborting!\n", path.c_str() );
+			return;
+		}
+
+		bool status = ReadPmgStreamed( fh, streamed );
+		plCloseFile( fh );
+		if ( !status ) {
+			return;
+		}
+	}
+	auto streamed_end = std::chrono::steady_clock::now();
+
+	double read_ms = 0;
+	double decode_ms = 0;
+	for ( unsigned int i = 0; i < num_samples; ++i ) {
+		auto read_start = std::chrono::steady_clock::now();
+		PLFile* fh = plOpenFile( path.c_str(), false );
+		if ( fh == nullptr ) {
+			LogWarn( "Failed to open \"%s\", aborting!\n", path.c_str() );
+			return;
+		}
+
+		std::vector<uint8_t> buffer( plGetFileSize( fh ) );
+		size_t length = plReadFile( fh, buffer.data(), sizeof( uint8_t ), buffer.size() );
+		plCloseFile( fh );
+		auto read_end = std::chrono::steady_clock::now();
+
+		if ( !DecodePmg( buffer.data(), length, bulk, path.c_str() ) ) {
+			return;
+		}
+		auto decode_end = std::chrono::steady_clock::now();
+
+		read_ms += std::chrono::duration<double, std::milli>( read_end - read_start ).count();
+		decode_ms += std::chrono::duration<double, std::milli>( decode_end - read_end ).count();
+	}
+
+	// tiles the bulk decoder had to reset as invalid will show up here too
+	struct {
+		const char* name;
+		const std::vector<uint8_t>& streamed;
+		const std::vector<uint8_t>& bulk;
+	} fields[] = {
+		{ "shading", streamed.shading, bulk.shading },
+		{ "surfaces", streamed.surfaces, bulk.surfaces },
+		{ "behaviours", streamed.behaviours, bulk.behaviours },
+		{ "slips", streamed.slips, bulk.slips },
+		{ "textures", streamed.textures, bulk.textures },
+		{ "rotations", streamed.rotations, bulk.rotations },
+	};
+
+	unsigned int num_height_mismatches = 0;
+	for ( unsigned int i = 0; i < streamed.heights.size(); ++i ) {
+		if ( streamed.heights[ i ] != bulk.heights[ i ] ) {
+			num_height_mismatches++;
+		}
+	}
+
+	unsigned int num_mismatches = num_height_mismatches;
+	if ( num_height_mismatches > 0 ) {
+		LogWarn( "%u mismatches in heights!\n", num_height_mismatches );
+	}
+	for ( const auto& field : fields ) {
+		unsigned int num_field_mismatches = 0;
+		for ( unsigned int i = 0; i < field.streamed.size(); ++i ) {
+			if ( field.streamed[ i ] != field.bulk[ i ] ) {
+				num_field_mismatches++;
+			}
+		}
+
+		if ( num_field_mismatches > 0 ) {
+			LogWarn( "%u mismatches in %s!\n", num_field_mismatches, field.name );
+		}
+		num_mismatches += num_field_mismatches;
+	}
+
+	double streamed_ms = std::chrono::duration<double, std::milli>( streamed_end - start ).count();
+	double bulk_ms = read_ms + decode_ms;
+	LogInfo( "Streamed: %u loads in %.3fms (%.3fms each)\n", num_samples, streamed_ms, streamed_ms / num_samples );
+	LogInfo( "Bulk:     %u loads in %.3fms (%.3fms each, %.3fms reading, %.3fms decoding, %.2fx, %u mismatches)\n",
+			 num_samples, bulk_ms, bulk_ms / num_samples, read_ms / num_samples, decode_ms / num_samples,
+			 streamed_ms / bulk_ms, num_mismatches );
 }
 
-void Terrain::LoadHeightmap( const std::string& path, int multiplier ) {
-	PLImage image;
-	if ( !plLoadImage( path.c_str(), &image ) ) {
-		LogWarn( "Failed to load the specified heightmap, \"%s\" (%s)!\n", path.c_str(), plGetError() );
-		return;
+/**
+ * Compares raycasting random rays against marching along them with GetHeight.
+ */
+void Terrain::BenchmarkRays( Map* map, unsigned int num_samples ) {
+	Terrain* terrain = map->GetTerrain();
+
+	// rays start above the surface, aimed anywhere from level down to steeply towards the ground
+	struct Ray {
+		PLVector3 origin;
+		PLVector3 direction;
+	};
+	std::vector<Ray> rays( num_samples );
+	BenchmarkRandom random;
+	for ( auto& ray : rays ) {
+		float x = random.Next( TERRAIN_PIXEL_WIDTH );
+		float z = random.Next( TERRAIN_PIXEL_WIDTH );
+		float above = random.Next( 2048 ) + 1.f;
+		float yaw = plDegreesToRadians( random.Next( 360 ) );
+		float pitch = plDegreesToRadians( -random.Next( 45 ) );
+		ray.origin = PLVector3( x, terrain->GetHeight( PLVector2( x, z ) ) + above, z );
+		ray.direction = PLVector3( cosf( yaw ) * cosf( pitch ), sinf( pitch ), sinf( yaw ) * cosf( pitch ) );
 	}
 
-	if ( image.width < 65 || image.height < 65 ) {
-		plFreeImage( &image );
-		LogWarn( "Invalid image size for heightmap, %dx%d vs 65x65!\n", image.width, image.height );
-		return;
+	const float max_distance = TERRAIN_PIXEL_WIDTH / 2;
+	const float step = TERRAIN_TILE_PIXEL_WIDTH / 16;
+
+	std::vector<float> raycast( num_samples, -1.f );
+	auto start = std::chrono::steady_clock::now();
+	for ( unsigned int i = 0; i < num_samples; ++i ) {
+		terrain->Raycast( rays[ i ].origin, rays[ i ].direction, max_distance, nullptr, &raycast[ i ] );
 	}
+	auto raycast_end = std::chrono::steady_clock::now();
+
+	std::vector<float> marched( num_samples, -1.f );
+	for ( unsigned int i = 0; i < num_samples; ++i ) {
+		for ( float t = 0; t <= max_distance; t += step ) {
+			PLVector3 point = rays[ i ].origin + rays[ i ].direction * t;
+			if ( point.x < 0 || point.x >= TERRAIN_PIXEL_WIDTH || point.z < 0 || point.z >= TERRAIN_PIXEL_WIDTH ) {
+				break;
+			}
 
-	// Each channel is encoded with specific data
-	// red = height
-	// green = texture
+			if ( point.y <= terrain->GetHeight( PLVector2( point.x, point.z ) ) ) {
+				marched[ i ] = t;
+				break;
+			}
+		}
+	}
+	auto marched_end = std::chrono::steady_clock::now();
+
+	// Marching can only be as accurate as its step, and can step over rays
+	// that only just clip the surface, so those are counted separately
+	unsigned int num_hits = 0;
+	unsigned int num_disagreements = 0;
+	for ( unsigned int i = 0; i < num_samples; ++i ) {
+		if ( raycast[ i ] >= 0 ) {
+			num_hits++;
+		}
+		if ( ( raycast[ i ] >= 0 ) != ( marched[ i ] >= 0 ) ||
+			std::fabs( raycast[ i ] - marched[ i ] ) > step ) {
+			num_disagreements++;
+		}
+	}
 
-	unsigned int chan_length = image.width * image.height;
+	double raycast_ms = std::chrono::duration<double, std::milli>( raycast_end - start ).count();
+	double marched_ms = std::chrono::duration<double, std::milli>( marched_end - raycast_end ).count();
+	LogInfo( "Marched: %u rays in %.3fms (%.3fus each)\n", num_samples, marched_ms, ( marched_ms * 1000.0 ) / num_samples );
+	LogInfo( "Raycast: %u rays in %.3fms (%.3fus each, %.2fx, %u hits, %u disagreements)\n",
+			 num_samples, raycast_ms, ( raycast_ms * 1000.0 ) / num_samples, marched_ms / raycast_ms,
+			 num_hits, num_disagreements );
+}
 
-	auto* rchan = static_cast<float*>(u_alloc( chan_length, sizeof( float ), true ));
-	uint8_t* pixel = image.data[ 0 ];
-	for ( unsigned int i = 0; i < chan_length; ++i ) {
-		rchan[ i ] = static_cast<int>(*pixel) * multiplier; //(static_cast<int>(*pixel) - 127) * 256;
-		pixel += 4;
+/**
+ * Compares resolving every tile's texture coords by name from the atlas against the table.
+ */
+void Terrain::BenchmarkUvs( Map* map, unsigned int num_samples ) {
+	Terrain* terrain = map->GetTerrain();
+
+	// Times a full serial rebuild using the table and then again looking each
+	// tile up by name, as the old rebuild did, checking both come out the same,
+	// along with resolving every tile's coords both ways on their own
+	std::vector<unsigned int> chunks( terrain->chunks_.size() );
+	for ( unsigned int i = 0; i < chunks.size(); ++i ) {
+		chunks[ i ] = i;
 	}
 
-	auto* gchan = static_cast<uint8_t*>(u_alloc( chan_length, sizeof( uint8_t ), true ));
-	pixel = image.data[ 0 ] + 1;
-	for ( unsigned int i = 0; i < chan_length; ++i ) {
-		gchan[ i ] = *pixel;
-		pixel += 4;
+	auto start = std::chrono::steady_clock::now();
+	for ( unsigned int i = 0; i < num_samples; ++i ) {
+		terrain->GenerateMeshes( chunks, false );
 	}
+	auto table_rebuild_end = std::chrono::steady_clock::now();
 
-	plFreeImage( &image );
+	std::vector<std::vector<PLVertex>> table_vertices;
+	for ( auto& sector : terrain->sectors_ ) {
+		for ( auto& lod : sector.lods ) {
+			PLMesh* mesh = plGetModelLodLevel( lod, 0 )->meshes[ 0 ];
+			table_vertices.emplace_back( mesh->vertices, mesh->vertices + mesh->num_verts );
+		}
+	}
 
-	for ( unsigned int chunk_y = 0; chunk_y < TERRAIN_CHUNK_ROW; ++chunk_y ) {
-		for ( unsigned int chunk_x = 0; chunk_x < TERRAIN_CHUNK_ROW; ++chunk_x ) {
-			Chunk& current_chunk = chunks_[ chunk_x + chunk_y * TERRAIN_CHUNK_ROW ];
-			for ( unsigned int tile_y = 0; tile_y < TERRAIN_CHUNK_ROW_TILES; ++tile_y ) {
-				for ( unsigned int tile_x = 0; tile_x < TERRAIN_CHUNK_ROW_TILES; ++tile_x ) {
-					Tile* current_tile = &current_chunk.tiles[ tile_x + tile_y * TERRAIN_CHUNK_ROW_TILES ];
-					unsigned int aaa = ( chunk_y * 4 * 65 ) + ( chunk_x * 4 );
-					current_tile->height[ 0 ] = rchan[ aaa + ( tile_y * 65 ) + tile_x ];
-					current_tile->height[ 1 ] = rchan[ aaa + ( tile_y * 65 ) + tile_x + 1 ];
-					current_tile->height[ 2 ] = rchan[ aaa + ( ( tile_y + 1 ) * 65 ) + tile_x ];
-					current_tile->height[ 3 ] = rchan[ aaa + ( ( tile_y + 1 ) * 65 ) + tile_x + 1 ];
-
-					current_tile->texture = gchan[ aaa + ( tile_y * 65 ) + tile_x ];
-
-					// hrm...
-					current_tile->shading[ 0 ] =
-					current_tile->shading[ 1 ] =
-					current_tile->shading[ 2 ] =
-					current_tile->shading[ 3 ] = 255;
+	auto by_name_rebuild_start = std::chrono::steady_clock::now();
+	for ( unsigned int i = 0; i < num_samples; ++i ) {
+		terrain->GenerateMeshes( chunks, false, true );
+	}
+	auto rebuild_end = std::chrono::steady_clock::now();
+
+	unsigned int num_mismatches = 0;
+	unsigned int mesh_idx = 0;
+	for ( auto& sector : terrain->sectors_ ) {
+		for ( auto& lod : sector.lods ) {
+			PLMesh* mesh = plGetModelLodLevel( lod, 0 )->meshes[ 0 ];
+			const std::vector<PLVertex>& expected = table_vertices[ mesh_idx++ ];
+			for ( unsigned int i = 0; i < mesh->num_verts; ++i ) {
+				if ( memcmp( &mesh->vertices[ i ], &expected[ i ], sizeof( PLVertex ) ) != 0 ) {
+					num_mismatches++;
 				}
 			}
+		}
+	}
 
-			max_height_ = min_height_ = current_chunk.tiles[ 0 ].height[ 0 ];
+	// both sides should cancel out, it's only there so neither loop gets optimised away
+	float checksum = 0;
+	for ( unsigned int i = 0; i < num_samples; ++i ) {
+		for ( uint8_t texture : terrain->storage_.textures ) {
+			float x, y, w, h;
+			terrain->atlas_->GetTextureCoords( std::to_string( texture ), &x, &y, &w, &h );
+			checksum += x + y + w + h;
+		}
+	}
+	auto by_name_end = std::chrono::steady_clock::now();
 
-			// Find the maximum and minimum points
-			for ( auto& tile : current_chunk.tiles ) {
-				for ( float i : tile.height ) {
-					if ( i > max_height_ ) {
-						max_height_ = i;
-					}
-					if ( i < min_height_ ) {
-						min_height_ = i;
-					}
+	for ( unsigned int i = 0; i < num_samples; ++i ) {
+		for ( uint8_t texture : terrain->storage_.textures ) {
+			const TextureCoords& coords = terrain->texture_coords_[ texture ];
+			checksum -= coords.x + coords.y + coords.w + coords.h;
+		}
+	}
+	auto table_end = std::chrono::steady_clock::now();
+
+	for ( auto& sector : terrain->sectors_ ) {
+		// nothing has changed since the last upload
+		sector.dirty = false;
+	}
+
+	double table_rebuild_ms =
+		std::chrono::duration<double, std::milli>( table_rebuild_end - start ).count() / num_samples;
+	double by_name_rebuild_ms =
+		std::chrono::duration<double, std::milli>( rebuild_end - by_name_rebuild_start ).count() / num_samples;
+	double by_name_ms = std::chrono::duration<double, std::milli>( by_name_end - rebuild_end ).count() / num_samples;
+	double table_ms = std::chrono::duration<double, std::milli>( table_end - by_name_end ).count() / num_samples;
+	LogInfo( "By name: %.3fms per %u tiles, rebuild took %.3fms\n",
+			 by_name_ms, TERRAIN_ROW_TILES * TERRAIN_ROW_TILES, by_name_rebuild_ms );
+	LogInfo( "Table:   %.3fms per %u tiles, rebuild took %.3fms (%.2fx, %.3fms saved, %u mismatches, checksum %f)\n",
+			 table_ms, TERRAIN_ROW_TILES * TERRAIN_ROW_TILES, table_rebuild_ms,
+			 by_name_rebuild_ms / table_rebuild_ms, by_name_rebuild_ms - table_rebuild_ms, num_mismatches, checksum );
+}
+
+/**
+ * Compares finding watery tiles around random points with the masks against GetTile.
+ */
+void Terrain::BenchmarkMasks( Map* map, unsigned int num_samples ) {
+	Terrain* terrain = map->GetTerrain();
+
+	// anything from a grenade to a large explosion
+	std::vector<PLVector3> areas( num_samples );
+	BenchmarkRandom random;
+	for ( auto& area : areas ) {
+		area.x = random.Next( TERRAIN_PIXEL_WIDTH );
+		area.y = random.Next( TERRAIN_PIXEL_WIDTH );
+		area.z = random.Next( TERRAIN_TILE_PIXEL_WIDTH * 8 ) + TERRAIN_TILE_PIXEL_WIDTH;
+	}
+
+	std::vector<unsigned int> by_tile( num_samples );
+	auto start = std::chrono::steady_clock::now();
+	for ( unsigned int i = 0; i < num_samples; ++i ) {
+		const PLVector3& area = areas[ i ];
+		int min_x = std::max( static_cast<int>(( area.x - area.z ) / TERRAIN_TILE_PIXEL_WIDTH), 0 );
+		int min_y = std::max( static_cast<int>(( area.y - area.z ) / TERRAIN_TILE_PIXEL_WIDTH), 0 );
+		int max_x = std::min( static_cast<int>(( area.x + area.z ) / TERRAIN_TILE_PIXEL_WIDTH), TERRAIN_ROW_TILES - 1 );
+		int max_y = std::min( static_cast<int>(( area.y + area.z ) / TERRAIN_TILE_PIXEL_WIDTH), TERRAIN_ROW_TILES - 1 );
+		for ( int y = min_y; y <= max_y; ++y ) {
+			for ( int x = min_x; x <= max_x; ++x ) {
+				float dx = ( x + 0.5f ) * TERRAIN_TILE_PIXEL_WIDTH - area.x;
+				float dy = ( y + 0.5f ) * TERRAIN_TILE_PIXEL_WIDTH - area.y;
+				if ( dx * dx + dy * dy <= area.z * area.z &&
+					( terrain->GetTile( x, y ).GetBehaviour() & Tile::BEHAVIOUR_WATERY ) ) {
+					by_tile[ i ]++;
 				}
 			}
 		}
 	}
+	auto by_tile_end = std::chrono::steady_clock::now();
 
-	u_free( rchan );
-	u_free( gchan );
+	std::vector<unsigned int> by_mask( num_samples );
+	const TileMask& watery = terrain->GetBehaviourMask( Tile::BEHAVIOUR_WATERY );
+	for ( unsigned int i = 0; i < num_samples; ++i ) {
+		by_mask[ i ] = watery.CountRadius( PLVector2( areas[ i ].x, areas[ i ].y ), areas[ i ].z );
+	}
+	auto by_mask_end = std::chrono::steady_clock::now();
 
-	Update();
+	unsigned int num_mismatches = 0;
+	unsigned long long total_tiles = 0;
+	for ( unsigned int i = 0; i < num_samples; ++i ) {
+		if ( by_tile[ i ] != by_mask[ i ] ) {
+			num_mismatches++;
+		}
+		total_tiles += by_mask[ i ];
+	}
+
+	double by_tile_ms = std::chrono::duration<double, std::milli>( by_tile_end - start ).count();
+	double by_mask_ms = std::chrono::duration<double, std::milli>( by_mask_end - by_tile_end ).count();
+	LogInfo( "GetTile: %u queries in %.3fms (%.3fus each)\n", num_samples, by_tile_ms, ( by_tile_ms * 1000.0 ) / num_samples );
+	LogInfo( "Masks:   %u queries in %.3fms (%.3fus each, %.2fx, %.1f watery tiles on average, %u mismatches)\n",
+			 num_samples, by_mask_ms, ( by_mask_ms * 1000.0 ) / num_samples, by_tile_ms / by_mask_ms,
+			 static_cast<double>(total_tiles) / num_samples, num_mismatches );
+}
+
+/**
+ * Usage: TerrainBenchmark [heights|meshes|cull|pmg|rays|uvs|masks] [samples]
+ */
+void Terrain::BenchmarkCommand( unsigned int argc, char** argv ) {
+	static const struct {
+		const char* mode;
+		unsigned int num_samples;
+		void ( * benchmark )( Map* map, unsigned int num_samples );
+	} benchmarks[] = {
+		{ "heights", 1000000, &Terrain::BenchmarkHeights },
+		{ "meshes", 100, &Terrain::BenchmarkMeshes },
+		{ "cull", 10000, &Terrain::BenchmarkCull },
+		{ "pmg", 100, &Terrain::BenchmarkPmg },
+		{ "rays", 10000, &Terrain::BenchmarkRays },
+		{ "uvs", 100, &Terrain::BenchmarkUvs },
+		{ "masks", 10000, &Terrain::BenchmarkMasks },
+	};
+
+	Map* map = openhow::Engine::Game()->GetCurrentMap();
+	if ( map == nullptr ) {
+		LogWarn( "No map loaded, ignoring!\n" );
+		return;
+	}
+
+	if ( map->GetTerrain() == nullptr ) {
+		LogWarn( "Benchmarks aren't supported on paged maps, ignoring!\n" );
+		return;
+	}
+
+	std::string mode = "heights";
+	unsigned int sample_arg = 1;
+	if ( argc > 1 && !isdigit( argv[ 1 ][ 0 ] ) ) {
+		mode = argv[ 1 ];
+		sample_arg = 2;
+	}
+
+	for ( const auto& benchmark : benchmarks ) {
+		if ( mode != benchmark.mode ) {
+			continue;
+		}
+
+		unsigned int num_samples = benchmark.num_samples;
+		if ( argc > sample_arg ) {
+			num_samples = strtoul( argv[ sample_arg ], nullptr, 10 );
+			if ( num_samples == 0 ) {
+				LogWarn( "Invalid number of samples, \"%s\", ignoring!\n", argv[ sample_arg ] );
+				return;
+			}
+		}
+
+		benchmark.benchmark( map, num_samples );
+		return;
+	}
+
+	LogWarn( "Unknown benchmark, \"%s\", ignoring!\n", mode.c_str() );
 }
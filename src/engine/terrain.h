@@ -21,22 +21,55 @@
 #define TERRAIN_CHUNKS              (TERRAIN_CHUNK_ROW * TERRAIN_CHUNK_ROW)
 #define TERRAIN_CHUNK_ROW_TILES     4
 #define TERRAIN_CHUNK_TILES         (TERRAIN_CHUNK_ROW_TILES * TERRAIN_CHUNK_ROW_TILES)
+#define TERRAIN_CHUNK_ROW_VERTICES  (TERRAIN_CHUNK_ROW_TILES + 1)
+#define TERRAIN_CHUNK_VERTICES      (TERRAIN_CHUNK_ROW_VERTICES * TERRAIN_CHUNK_ROW_VERTICES)
 
 #define TERRAIN_TILE_PIXEL_WIDTH    512
 #define TERRAIN_CHUNK_PIXEL_WIDTH   2048
 
 #define TERRAIN_ROW_TILES           (TERRAIN_CHUNK_ROW * TERRAIN_CHUNK_ROW_TILES)
+#define TERRAIN_ROW_VERTICES        (TERRAIN_ROW_TILES + 1)
+
+/* each level halves the number of quads along a chunk,
+ * down to a single quad covering the whole chunk */
+#define TERRAIN_LODS                3
+#define TERRAIN_SKIRT_DEPTH         32
+
+/* chunks are packed into sectors for drawing, each sector being
+ * a contiguous range of the terrain's vertices at each level of detail */
+#define TERRAIN_SECTOR_ROW_CHUNKS   4
+#define TERRAIN_SECTOR_CHUNKS       (TERRAIN_SECTOR_ROW_CHUNKS * TERRAIN_SECTOR_ROW_CHUNKS)
+#define TERRAIN_SECTOR_ROW          (TERRAIN_CHUNK_ROW / TERRAIN_SECTOR_ROW_CHUNKS)
+#define TERRAIN_SECTORS             (TERRAIN_SECTOR_ROW * TERRAIN_SECTOR_ROW)
 
 #define TERRAIN_PIXEL_WIDTH         (TERRAIN_TILE_PIXEL_WIDTH * TERRAIN_ROW_TILES)
 
+/* min/max heights over the tiles for raycasting, each level
+ * halving the row down to a single node covering the terrain */
+#define TERRAIN_HEIGHT_LEVELS       7
+
+/* each chunk in a pmg is an 8 byte header, 25 vertices,
+ * 4 bytes of padding and then 16 tiles of 16 bytes each */
+#define TERRAIN_PMG_CHUNK_BYTES     368
+
+/* bump whenever the layout of the cooked terrain cache changes */
+#define TERRAIN_CACHE_VERSION       2
+
+/* the overview is drawn at up to this many pixels along each side of a tile */
+#define TERRAIN_OVERVIEW_MAX_SCALE  8
+
+class Map;
 class TextureAtlas;
+struct ViewFrustum;
 
 class Terrain {
  public:
   explicit Terrain(const std::string& tileset);
   ~Terrain();
 
-  struct Tile {
+  /* view of a single tile within the terrain's storage */
+  class Tile {
+   public:
     /* surface properties */
     enum Surface {
       SURFACE_MUD = 0,
@@ -51,18 +84,14 @@ class Terrain {
       SURFACE_SNOW = 9,
       SURFACE_QUAGMIRE = 10,
       SURFACE_LAVA = 11,
-    } surface{SURFACE_MUD}; // e.g. wood
+    };
 
     enum Behaviour {
       BEHAVIOUR_NONE,
       BEHAVIOUR_WATERY = 32,
       BEHAVIOUR_MINE = 64,
       BEHAVIOUR_WALL = 128,
-    } behaviour{BEHAVIOUR_NONE}; // e.g. mine, watery
-
-    unsigned int slip{0}; // e.g. full, bottom or left?
-
-    uint8_t texture{0};
+    };
 
     enum Rotation {
       ROTATION_FLAG_NONE,
@@ -70,44 +99,253 @@ class Terrain {
       ROTATION_FLAG_ROTATE_90 = 2,
       ROTATION_FLAG_ROTATE_180 = 4,
       ROTATION_FLAG_ROTATE_270 = 6,
-    } rotation{ROTATION_FLAG_NONE};
+    };
+
+    Tile() = default;
+    Tile(const Terrain* terrain, unsigned int x, unsigned int y) : terrain_(terrain), x_(x), y_(y) {}
+
+    bool IsValid() const { return terrain_ != nullptr; }
+
+    Surface GetSurface() const;     // e.g. wood
+    Behaviour GetBehaviour() const; // e.g. mine, watery
+    unsigned int GetSlip() const;   // e.g. full, bottom or left?
+    uint8_t GetTexture() const;
+    Rotation GetRotation() const;
+
+    // corners are top left, top right, bottom left and then bottom right
+    float GetHeight(unsigned int corner) const;
+    uint8_t GetShading(unsigned int corner) const;
+
+   private:
+    const Terrain* terrain_{nullptr};
+    unsigned int x_{0};
+    unsigned int y_{0};
+  };
+
+  /* one bit per tile over the whole grid, with each row of tiles packed into a word */
+  class TileMask {
+   public:
+    bool Get(unsigned int x, unsigned int y) const { return ( rows_[y] >> x ) & 1U; }
+    void Set(unsigned int x, unsigned int y, bool value);
+
+    // Tiles within the (inclusive) rectangle of tiles.
+    unsigned int CountRect(unsigned int min_x, unsigned int min_y, unsigned int max_x, unsigned int max_y) const;
+    // Tiles with their centre within the radius of the given world position.
+    unsigned int CountRadius(const PLVector2& pos, float radius) const;
+
+    // Calls func(x, y) for each tile within the same areas as above, row by row.
+    template<typename F>
+    void ForEachRect(unsigned int min_x, unsigned int min_y, unsigned int max_x, unsigned int max_y, F func) const {
+      max_x = std::min(max_x, (unsigned int) TERRAIN_ROW_TILES - 1);
+      max_y = std::min(max_y, (unsigned int) TERRAIN_ROW_TILES - 1);
+      if (min_x > max_x) {
+        return;
+      }
+
+      uint64_t span = GetSpanMask(min_x, max_x);
+      for (unsigned int y = min_y; y <= max_y; ++y) {
+        ForEachBit(rows_[y] & span, y, func);
+      }
+    }
+
+    template<typename F>
+    void ForEachRadius(const PLVector2& pos, float radius, F func) const {
+      unsigned int min_y, max_y;
+      if (!GetRadiusRows(pos, radius, &min_y, &max_y)) {
+        return;
+      }
+
+      for (unsigned int y = min_y; y <= max_y; ++y) {
+        ForEachBit(rows_[y] & GetRadiusSpanMask(pos, radius, y), y, func);
+      }
+    }
 
-    float height[4]{0, 0, 0, 0};
-    uint8_t shading[4]{255, 255, 255, 255};
+   private:
+    static uint64_t GetSpanMask(unsigned int min_x, unsigned int max_x);
+    static bool GetRadiusRows(const PLVector2& pos, float radius, unsigned int* min_y, unsigned int* max_y);
+    static uint64_t GetRadiusSpanMask(const PLVector2& pos, float radius, unsigned int y);
+
+    template<typename F>
+    static void ForEachBit(uint64_t bits, unsigned int y, F& func) {
+      while (bits != 0) {
+        func(static_cast<unsigned int>(__builtin_ctzll(bits)), y);
+        bits &= bits - 1;
+      }
+    }
+
+    static_assert(TERRAIN_ROW_TILES == 64, "A row of tiles no longer fits in a word!");
+    uint64_t rows_[TERRAIN_ROW_TILES]{};
   };
 
   struct Chunk {
-    Tile tiles[16];
-    PLModel* model{nullptr};
+    unsigned int sector{0};       // sector this chunk is drawn as part of
+    unsigned int slot{0};         // position of this chunk within the sector's vertices
+    bool dirty{true};             // needs regenerating on next Update
+    bool overview_dirty{true};    // only its overview pixels need redoing on next Update
+
+    /* world space bounds, used for culling */
+    PLVector3 bounds_min;
+    PLVector3 bounds_max;
   };
 
   Chunk* GetChunk(const PLVector2& pos);
-  Tile* GetTile(const PLVector2& pos);
+  Tile GetTile(const PLVector2& pos);
+  Tile GetTile(unsigned int x, unsigned int y);
+
+  // Editing; x and y are vertex/tile coordinates rather than world positions.
+  // Changes are applied on the next Update, which only rebuilds what was touched.
+  void SetHeight(unsigned int x, unsigned int y, float height);
+  void SetShading(unsigned int x, unsigned int y, uint8_t shading);
+  void SetTexture(unsigned int x, unsigned int y, uint8_t texture, Tile::Rotation rotation);
+  void SetSurface(unsigned int x, unsigned int y, Tile::Surface surface);
+  void SetBehaviour(unsigned int x, unsigned int y, Tile::Behaviour behaviour);
+  void MarkDirty(const PLVector2& pos);
+
+  // Every tile with the given surface, or behaviour; behaviours are flags, so one at a time.
+  const TileMask& GetSurfaceMask(Tile::Surface surface) const { return surface_masks_[surface]; }
+  const TileMask& GetBehaviourMask(Tile::Behaviour behaviour) const;
 
   float GetHeight(const PLVector2& pos);
+  void GetHeights(const PLVector2* pos, float* heights, size_t num);
   float GetMaxHeight() { return max_height_; }
   float GetMinHeight() { return min_height_; }
 
+  // Finds the first point at which the ray meets the surface, up to max_distance
+  // along direction (which should be normalized). The origin should be above the surface.
+  bool Raycast(const PLVector3& origin, const PLVector3& direction, float max_distance,
+               PLVector3* hit = nullptr, float* distance = nullptr);
+  bool HasLineOfSight(const PLVector3& from, const PLVector3& to);
+
   void LoadPmg(const std::string& path);
   void LoadHeightmap(const std::string& path, int multiplier);
 
   PLTexture* GetOverview() { return overview_; }
+  unsigned int GetOverviewWidth() { return TERRAIN_ROW_TILES * overview_scale_; }
+  bool WriteOverview(const std::string& path);
 
+  // Writes out the fully generated terrain, keyed by the pmg and tileset it came from,
+  // which Deserialize can then load back in place of LoadPmg if neither has changed.
   void Serialize(const std::string& path);
+  bool Deserialize(const std::string& path, const std::string& pmg_path);
 
   void Draw();
   void Update();
 
+  // Flags which of the given chunks intersect the frustum, returning how many do.
+  static unsigned int CullChunks(const ViewFrustum& frustum, const std::vector<Chunk>& chunks, std::vector<bool>& visible);
+
+  static void BenchmarkCommand(unsigned int argc, char** argv);
+  static void DumpOverviewCommand(unsigned int argc, char** argv);
+
+  /* atlas coords for a tile texture */
+  struct TextureCoords {
+    float x, y, w, h;
+  };
+
+  // Packs all 256 tile textures from the tileset into a finalized atlas, owned by the caller.
+  static TextureAtlas* CreateTileAtlas(const std::string& tileset);
+  // Smooth normal for the given vertex of a heightfield stored as in Storage, row_tiles tiles wide.
+  static PLVector3 GenerateVertexNormal(const float* heights, unsigned int row_tiles, unsigned int x, unsigned int y);
+
+  // Resolves the coords of all 256 tile textures, the atlas must have been finalized.
+  static void GenerateTextureCoords(TextureAtlas* atlas, TextureCoords* coords);
+  // ST coords for each corner of a tile, flipped and rotated as given by the tile.
+  static void GenerateTileCoords(const TextureCoords& coords, uint8_t rotation, float* s, float* t);
+
+  /* a single chunk as laid out in a pmg, vertices and tiles in rows */
+  struct PmgChunk {
+    float heights[TERRAIN_CHUNK_VERTICES];
+    uint8_t shading[TERRAIN_CHUNK_VERTICES];
+    uint8_t surfaces[TERRAIN_CHUNK_TILES];
+    uint8_t behaviours[TERRAIN_CHUNK_TILES];
+    uint8_t rotations[TERRAIN_CHUNK_TILES];
+    uint8_t textures[TERRAIN_CHUNK_TILES];
+  };
+
+  // Decodes a single chunk from a pmg, returning how many of its tiles were invalid and reset.
+  static unsigned int DecodePmgChunk(const uint8_t* record, PmgChunk& chunk);
+
  protected:
  private:
-  void GenerateModel(Chunk* chunk, const PLVector2& offset);
-  void GenerateOverview();
+  /* everything is stored as flat arrays over the whole terrain,
+   * with vertices shared between the tiles that meet at them */
+  struct Storage {
+    // TERRAIN_ROW_VERTICES * TERRAIN_ROW_VERTICES
+    std::vector<float> heights;
+    std::vector<uint8_t> shading;
+
+    // TERRAIN_ROW_TILES * TERRAIN_ROW_TILES
+    std::vector<uint8_t> surfaces;
+    std::vector<uint8_t> behaviours;
+    std::vector<uint8_t> slips;
+    std::vector<uint8_t> textures;
+    std::vector<uint8_t> rotations;
+
+    Storage();
+  };
+
+  static bool DecodePmg(const uint8_t* data, size_t length, Storage& storage, const char* path);
+
+  void MarkVertexDirty(unsigned int x, unsigned int y);
+
+  uint64_t GetCacheKey(const uint8_t* pmg, size_t length) const;
+
+  void GenerateBounds(unsigned int chunk_x, unsigned int chunk_y);
+  void GenerateTileMasks(unsigned int x, unsigned int y);
+  void GenerateTileMasks();
+  void GenerateHeightPyramid(unsigned int min_x, unsigned int min_y, unsigned int max_x, unsigned int max_y);
+  bool RaycastTile(unsigned int x, unsigned int y, const PLVector3& origin, const PLVector3& direction,
+                   float min_t, float max_t, float* t);
+  void GenerateSectors();
+  // by_name looks each tile's coords up in the atlas rather than the table, only for benchmarking
+  void GenerateChunk(unsigned int chunk_x, unsigned int chunk_y, bool by_name = false);
+  void GenerateChunkNormals(unsigned int chunk_x, unsigned int chunk_y);
+  void GenerateMeshes(const std::vector<unsigned int>& chunks, bool parallel, bool by_name = false);
+  void GenerateOverview(unsigned int chunk_x, unsigned int chunk_y);
+  void GenerateNormals(unsigned int min_x, unsigned int min_y, unsigned int max_x, unsigned int max_y);
+  void UploadOverview();
+
+  static void BenchmarkHeights(Map* map, unsigned int num_samples);
+  static void BenchmarkMeshes(Map* map, unsigned int num_samples);
+  static void BenchmarkCull(Map* map, unsigned int num_samples);
+  static void BenchmarkPmg(Map* map, unsigned int num_samples);
+  static bool ReadPmgStreamed(PLFile* fh, Storage& storage);
+  static void BenchmarkRays(Map* map, unsigned int num_samples);
+  static void BenchmarkUvs(Map* map, unsigned int num_samples);
+  static void BenchmarkMasks(Map* map, unsigned int num_samples);
 
   float max_height_{0};
   float min_height_{0};
 
   std::vector<Chunk> chunks_;
 
+  struct Sector {
+    PLModel* lods[TERRAIN_LODS]{};
+    bool dirty{false}; // needs uploading
+  };
+  std::vector<Sector> sectors_;
+
+  std::vector<bool> visible_chunks_;
+
+  Storage storage_;
+  std::vector<PLVector3> normals_;
+
+  /* level 0 is per tile, each level above covering 2x2 of the one below */
+  struct HeightLevel {
+    std::vector<float> min;
+    std::vector<float> max;
+  };
+  HeightLevel height_pyramid_[TERRAIN_HEIGHT_LEVELS];
+
+  TileMask surface_masks_[Tile::SURFACE_LAVA + 1];
+  TileMask behaviour_masks_[4]; // none, watery, mine and wall
+
   TextureAtlas* atlas_{nullptr};
+  TextureCoords texture_coords_[256]; // per tile texture index
   PLTexture* overview_{nullptr};
+  std::vector<uint8_t> overview_pixels_; // RGB, overview_scale_ pixels along each side of a tile
+  unsigned int overview_scale_{1};
+  float overview_mid_height_{0};
+
+  uint64_t cache_key_{0}; // zero if the terrain no longer matches its pmg
 };
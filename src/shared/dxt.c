@@ -0,0 +1,640 @@
+/* OpenHoW
+ * Copyright (C) 2017-2020 Mark Sowden <markelswo@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <PL/platform_filesystem.h>
+
+#include <float.h>
+#include <math.h>
+
+#include "util.h"
+#include "dxt.h"
+
+/************************************************************/
+/* DXT/S3TC Block Compression (BC1 and BC3) */
+
+#define DXT_MAGIC   "HDXT"
+
+typedef struct DxtHeader {
+	char magic[ 4 ];
+	uint32_t version;
+	uint32_t format;
+	uint32_t width;
+	uint32_t height;
+	uint32_t num_levels;
+} DxtHeader;
+
+/* pixels below this are dropped entirely when encoding BC1 */
+#define DXT_ALPHA_THRESHOLD 128
+
+static unsigned int Dxt_GetBlockSize( DxtFormat format ) {
+	return ( format == DXT_FORMAT_BC1 ) ? 8 : 16;
+}
+
+size_t Dxt_GetLevelSize( DxtFormat format, unsigned int width, unsigned int height ) {
+	size_t blocks_x = ( width + 3 ) / 4, blocks_y = ( height + 3 ) / 4;
+	if ( blocks_x == 0 ) blocks_x = 1;
+	if ( blocks_y == 0 ) blocks_y = 1;
+	return blocks_x * blocks_y * Dxt_GetBlockSize( format );
+}
+
+DxtFormat Dxt_GetBestFormat( const uint8_t *rgba, unsigned int width, unsigned int height ) {
+	size_t num_pixels = ( size_t ) width * height;
+	for ( size_t i = 0; i < num_pixels; ++i ) {
+		uint8_t alpha = rgba[ i * 4 + 3 ];
+		if ( alpha != 0 && alpha != 255 ) {
+			return DXT_FORMAT_BC3;
+		}
+	}
+
+	return DXT_FORMAT_BC1;
+}
+
+/************************************************************/
+/* Colour Endpoints */
+
+static uint16_t Dxt_PackColour( const float *rgb ) {
+	int r = ( int ) ( rgb[ 0 ] * 31.0f / 255.0f + 0.5f );
+	int g = ( int ) ( rgb[ 1 ] * 63.0f / 255.0f + 0.5f );
+	int b = ( int ) ( rgb[ 2 ] * 31.0f / 255.0f + 0.5f );
+	r = r < 0 ? 0 : ( r > 31 ? 31 : r );
+	g = g < 0 ? 0 : ( g > 63 ? 63 : g );
+	b = b < 0 ? 0 : ( b > 31 ? 31 : b );
+	return ( uint16_t ) ( ( r << 11 ) | ( g << 5 ) | b );
+}
+
+static void Dxt_UnpackColour( uint16_t colour, int *rgb ) {
+	int r = ( colour >> 11 ) & 31, g = ( colour >> 5 ) & 63, b = colour & 31;
+	rgb[ 0 ] = ( r << 3 ) | ( r >> 2 );
+	rgb[ 1 ] = ( g << 2 ) | ( g >> 4 );
+	rgb[ 2 ] = ( b << 3 ) | ( b >> 2 );
+}
+
+/* the palette a block's endpoints expand to, as the hardware sees it;
+ * in three colour mode, the last entry is transparent black */
+static void Dxt_GetPalette( uint16_t c0, uint16_t c1, bool four_colour, int palette[ 4 ][ 3 ] ) {
+	Dxt_UnpackColour( c0, palette[ 0 ] );
+	Dxt_UnpackColour( c1, palette[ 1 ] );
+	for ( unsigned int i = 0; i < 3; ++i ) {
+		if ( four_colour ) {
+			palette[ 2 ][ i ] = ( 2 * palette[ 0 ][ i ] + palette[ 1 ][ i ] ) / 3;
+			palette[ 3 ][ i ] = ( palette[ 0 ][ i ] + 2 * palette[ 1 ][ i ] ) / 3;
+		} else {
+			palette[ 2 ][ i ] = ( palette[ 0 ][ i ] + palette[ 1 ][ i ] ) / 2;
+			palette[ 3 ][ i ] = 0;
+		}
+	}
+}
+
+/* picks the nearest palette entry for every opaque pixel, returning the total squared error */
+static unsigned int Dxt_FitIndices( const uint8_t block[ 16 ][ 4 ], const bool *opaque,
+									uint16_t c0, uint16_t c1, bool four_colour, uint8_t *indices ) {
+	int palette[ 4 ][ 3 ];
+	Dxt_GetPalette( c0, c1, four_colour, palette );
+
+	unsigned int num_entries = four_colour ? 4 : 3;
+	unsigned int error = 0;
+	for ( unsigned int i = 0; i < 16; ++i ) {
+		if ( !opaque[ i ] ) {
+			indices[ i ] = 3;
+			continue;
+		}
+
+		unsigned int best = 0, best_error = UINT32_MAX;
+		for ( unsigned int j = 0; j < num_entries; ++j ) {
+			int dr = block[ i ][ 0 ] - palette[ j ][ 0 ];
+			int dg = block[ i ][ 1 ] - palette[ j ][ 1 ];
+			int db = block[ i ][ 2 ] - palette[ j ][ 2 ];
+			unsigned int e = ( unsigned int ) ( dr * dr + dg * dg + db * db );
+			if ( e < best_error ) {
+				best_error = e;
+				best = j;
+			}
+		}
+
+		indices[ i ] = ( uint8_t ) best;
+		error += best_error;
+	}
+
+	return error;
+}
+
+/* finds the endpoints which best fit the pixels for the indices they've been given,
+ * by least squares, returning false if they can't be solved for */
+static bool Dxt_RefineEndpoints( const uint8_t block[ 16 ][ 4 ], const bool *opaque, const uint8_t *indices,
+								 bool four_colour, float *start, float *end ) {
+	static const float weights_four[ 4 ] = { 1.0f, 0.0f, 2.0f / 3.0f, 1.0f / 3.0f };
+	static const float weights_three[ 4 ] = { 1.0f, 0.0f, 0.5f, 0.0f };
+	const float *weights = four_colour ? weights_four : weights_three;
+
+	float aa = 0.0f, ab = 0.0f, bb = 0.0f;
+	float ax[ 3 ] = { 0.0f, 0.0f, 0.0f }, bx[ 3 ] = { 0.0f, 0.0f, 0.0f };
+	for ( unsigned int i = 0; i < 16; ++i ) {
+		if ( !opaque[ i ] ) {
+			continue;
+		}
+
+		float a = weights[ indices[ i ] ], b = 1.0f - a;
+		aa += a * a;
+		ab += a * b;
+		bb += b * b;
+		for ( unsigned int j = 0; j < 3; ++j ) {
+			ax[ j ] += a * block[ i ][ j ];
+			bx[ j ] += b * block[ i ][ j ];
+		}
+	}
+
+	float det = aa * bb - ab * ab;
+	if ( det < 1e-6f && det > -1e-6f ) {
+		return false;
+	}
+
+	for ( unsigned int j = 0; j < 3; ++j ) {
+		start[ j ] = ( ax[ j ] * bb - bx[ j ] * ab ) / det;
+		end[ j ] = ( bx[ j ] * aa - ax[ j ] * ab ) / det;
+	}
+
+	return true;
+}
+
+/* initial endpoints, from the extremes of the pixels along their principal axis */
+static void Dxt_GetEndpoints( const uint8_t block[ 16 ][ 4 ], const bool *opaque, float *start, float *end ) {
+	float mean[ 3 ] = { 0.0f, 0.0f, 0.0f };
+	unsigned int num_opaque = 0;
+	for ( unsigned int i = 0; i < 16; ++i ) {
+		if ( !opaque[ i ] ) {
+			continue;
+		}
+
+		for ( unsigned int j = 0; j < 3; ++j ) {
+			mean[ j ] += block[ i ][ j ];
+		}
+		num_opaque++;
+	}
+
+	for ( unsigned int j = 0; j < 3; ++j ) {
+		mean[ j ] /= ( float ) num_opaque;
+	}
+
+	/* r, g, b, rg, rb, gb */
+	float cov[ 6 ] = { 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f };
+	for ( unsigned int i = 0; i < 16; ++i ) {
+		if ( !opaque[ i ] ) {
+			continue;
+		}
+
+		float r = block[ i ][ 0 ] - mean[ 0 ], g = block[ i ][ 1 ] - mean[ 1 ], b = block[ i ][ 2 ] - mean[ 2 ];
+		cov[ 0 ] += r * r;
+		cov[ 1 ] += g * g;
+		cov[ 2 ] += b * b;
+		cov[ 3 ] += r * g;
+		cov[ 4 ] += r * b;
+		cov[ 5 ] += g * b;
+	}
+
+	/* power iteration converges on the axis quickly enough for a 4x4 block */
+	float axis[ 3 ] = { 1.0f, 1.0f, 1.0f };
+	for ( unsigned int n = 0; n < 8; ++n ) {
+		float x = cov[ 0 ] * axis[ 0 ] + cov[ 3 ] * axis[ 1 ] + cov[ 4 ] * axis[ 2 ];
+		float y = cov[ 3 ] * axis[ 0 ] + cov[ 1 ] * axis[ 1 ] + cov[ 5 ] * axis[ 2 ];
+		float z = cov[ 4 ] * axis[ 0 ] + cov[ 5 ] * axis[ 1 ] + cov[ 2 ] * axis[ 2 ];
+		float length = fabsf( x );
+		if ( fabsf( y ) > length ) length = fabsf( y );
+		if ( fabsf( z ) > length ) length = fabsf( z );
+		if ( length < 1e-6f ) {
+			break;
+		}
+
+		axis[ 0 ] = x / length;
+		axis[ 1 ] = y / length;
+		axis[ 2 ] = z / length;
+	}
+
+	float min_t = FLT_MAX, max_t = -FLT_MAX;
+	for ( unsigned int i = 0; i < 16; ++i ) {
+		if ( !opaque[ i ] ) {
+			continue;
+		}
+
+		float t = ( block[ i ][ 0 ] - mean[ 0 ] ) * axis[ 0 ] +
+			( block[ i ][ 1 ] - mean[ 1 ] ) * axis[ 1 ] +
+			( block[ i ][ 2 ] - mean[ 2 ] ) * axis[ 2 ];
+		if ( t < min_t ) min_t = t;
+		if ( t > max_t ) max_t = t;
+	}
+
+	/* pull the endpoints in slightly, so the interpolated colours land nearer the pixels */
+	float inset = ( max_t - min_t ) / 16.0f;
+	min_t += inset;
+	max_t -= inset;
+
+	float length = axis[ 0 ] * axis[ 0 ] + axis[ 1 ] * axis[ 1 ] + axis[ 2 ] * axis[ 2 ];
+	if ( length < 1e-6f ) {
+		length = 1.0f;
+	}
+
+	for ( unsigned int j = 0; j < 3; ++j ) {
+		start[ j ] = mean[ j ] + axis[ j ] * max_t / length;
+		end[ j ] = mean[ j ] + axis[ j ] * min_t / length;
+	}
+}
+
+static void Dxt_WriteColourBlock( uint16_t c0, uint16_t c1, const uint8_t *indices, uint8_t *out ) {
+	uint32_t bits = 0;
+	for ( unsigned int i = 0; i < 16; ++i ) {
+		bits |= ( uint32_t ) indices[ i ] << ( i * 2 );
+	}
+
+	out[ 0 ] = ( uint8_t ) ( c0 & 0xFF );
+	out[ 1 ] = ( uint8_t ) ( c0 >> 8 );
+	out[ 2 ] = ( uint8_t ) ( c1 & 0xFF );
+	out[ 3 ] = ( uint8_t ) ( c1 >> 8 );
+	out[ 4 ] = ( uint8_t ) ( bits & 0xFF );
+	out[ 5 ] = ( uint8_t ) ( ( bits >> 8 ) & 0xFF );
+	out[ 6 ] = ( uint8_t ) ( ( bits >> 16 ) & 0xFF );
+	out[ 7 ] = ( uint8_t ) ( bits >> 24 );
+}
+
+/* BC3 always treats its colour block as four colour, while BC1 switches to three
+ * colours plus transparency whenever the first endpoint isn't the greater of the two */
+static void Dxt_EncodeColourBlock( const uint8_t block[ 16 ][ 4 ], bool punch_through, uint8_t *out ) {
+	bool opaque[ 16 ];
+	unsigned int num_opaque = 0;
+	for ( unsigned int i = 0; i < 16; ++i ) {
+		opaque[ i ] = !punch_through || block[ i ][ 3 ] >= DXT_ALPHA_THRESHOLD;
+		if ( opaque[ i ] ) {
+			num_opaque++;
+		}
+	}
+
+	uint8_t indices[ 16 ];
+	if ( num_opaque == 0 ) {
+		memset( indices, 3, sizeof( indices ) );
+		Dxt_WriteColourBlock( 0, 0xFFFF, indices, out );
+		return;
+	}
+
+	bool four_colour = ( num_opaque == 16 );
+
+	float start[ 3 ], end[ 3 ];
+	Dxt_GetEndpoints( block, opaque, start, end );
+	uint16_t c0 = Dxt_PackColour( start ), c1 = Dxt_PackColour( end );
+	unsigned int error = Dxt_FitIndices( block, opaque, c0, c1, four_colour, indices );
+
+	/* one round of refinement, kept only if it actually helps */
+	uint8_t refined_indices[ 16 ];
+	if ( Dxt_RefineEndpoints( block, opaque, indices, four_colour, start, end ) ) {
+		uint16_t r0 = Dxt_PackColour( start ), r1 = Dxt_PackColour( end );
+		unsigned int refined_error = Dxt_FitIndices( block, opaque, r0, r1, four_colour, refined_indices );
+		if ( refined_error < error ) {
+			c0 = r0;
+			c1 = r1;
+			error = refined_error;
+			memcpy( indices, refined_indices, sizeof( indices ) );
+		}
+	}
+
+	if ( four_colour ) {
+		if ( c0 == c1 ) {
+			/* would otherwise be read as three colour, but the first entry alone covers it */
+			memset( indices, 0, sizeof( indices ) );
+		} else if ( c0 < c1 ) {
+			uint16_t t = c0;
+			c0 = c1;
+			c1 = t;
+			for ( unsigned int i = 0; i < 16; ++i ) {
+				indices[ i ] ^= 1;
+			}
+		}
+	} else if ( c0 > c1 ) {
+		uint16_t t = c0;
+		c0 = c1;
+		c1 = t;
+		for ( unsigned int i = 0; i < 16; ++i ) {
+			if ( indices[ i ] < 2 ) {
+				indices[ i ] ^= 1;
+			}
+		}
+	}
+
+	Dxt_WriteColourBlock( c0, c1, indices, out );
+}
+
+/************************************************************/
+/* Alpha Block */
+
+static void Dxt_EncodeAlphaBlock( const uint8_t block[ 16 ][ 4 ], uint8_t *out ) {
+	uint8_t a0 = 0, a1 = 255;
+	for ( unsigned int i = 0; i < 16; ++i ) {
+		if ( block[ i ][ 3 ] > a0 ) a0 = block[ i ][ 3 ];
+		if ( block[ i ][ 3 ] < a1 ) a1 = block[ i ][ 3 ];
+	}
+
+	out[ 0 ] = a0;
+	out[ 1 ] = a1;
+	memset( out + 2, 0, 6 );
+	if ( a0 == a1 ) {
+		return;
+	}
+
+	/* eight values, from a0 down to a1, where index 1 is a1 and 2 through 7 are between */
+	int palette[ 8 ];
+	palette[ 0 ] = a0;
+	palette[ 1 ] = a1;
+	for ( int i = 1; i < 7; ++i ) {
+		palette[ i + 1 ] = ( ( 7 - i ) * a0 + i * a1 ) / 7;
+	}
+
+	uint64_t bits = 0;
+	for ( unsigned int i = 0; i < 16; ++i ) {
+		unsigned int best = 0, best_error = UINT32_MAX;
+		for ( unsigned int j = 0; j < 8; ++j ) {
+			int d = block[ i ][ 3 ] - palette[ j ];
+			unsigned int e = ( unsigned int ) ( d < 0 ? -d : d );
+			if ( e < best_error ) {
+				best_error = e;
+				best = j;
+			}
+		}
+
+		bits |= ( uint64_t ) best << ( i * 3 );
+	}
+
+	for ( unsigned int i = 0; i < 6; ++i ) {
+		out[ 2 + i ] = ( uint8_t ) ( ( bits >> ( i * 8 ) ) & 0xFF );
+	}
+}
+
+static void Dxt_DecodeAlphaBlock( const uint8_t *in, uint8_t *alpha ) {
+	int a0 = in[ 0 ], a1 = in[ 1 ];
+	int palette[ 8 ];
+	palette[ 0 ] = a0;
+	palette[ 1 ] = a1;
+	if ( a0 > a1 ) {
+		for ( int i = 1; i < 7; ++i ) {
+			palette[ i + 1 ] = ( ( 7 - i ) * a0 + i * a1 ) / 7;
+		}
+	} else {
+		for ( int i = 1; i < 5; ++i ) {
+			palette[ i + 1 ] = ( ( 5 - i ) * a0 + i * a1 ) / 5;
+		}
+		palette[ 6 ] = 0;
+		palette[ 7 ] = 255;
+	}
+
+	uint64_t bits = 0;
+	for ( unsigned int i = 0; i < 6; ++i ) {
+		bits |= ( uint64_t ) in[ 2 + i ] << ( i * 8 );
+	}
+
+	for ( unsigned int i = 0; i < 16; ++i ) {
+		alpha[ i ] = ( uint8_t ) palette[ ( bits >> ( i * 3 ) ) & 7 ];
+	}
+}
+
+static void Dxt_DecodeColourBlock( const uint8_t *in, bool allow_three_colour, uint8_t block[ 16 ][ 4 ] ) {
+	uint16_t c0 = ( uint16_t ) ( in[ 0 ] | ( in[ 1 ] << 8 ) );
+	uint16_t c1 = ( uint16_t ) ( in[ 2 ] | ( in[ 3 ] << 8 ) );
+	uint32_t bits = ( uint32_t ) in[ 4 ] | ( ( uint32_t ) in[ 5 ] << 8 ) |
+		( ( uint32_t ) in[ 6 ] << 16 ) | ( ( uint32_t ) in[ 7 ] << 24 );
+
+	bool four_colour = !allow_three_colour || c0 > c1;
+	int palette[ 4 ][ 3 ];
+	Dxt_GetPalette( c0, c1, four_colour, palette );
+
+	for ( unsigned int i = 0; i < 16; ++i ) {
+		unsigned int index = ( bits >> ( i * 2 ) ) & 3;
+		block[ i ][ 0 ] = ( uint8_t ) palette[ index ][ 0 ];
+		block[ i ][ 1 ] = ( uint8_t ) palette[ index ][ 1 ];
+		block[ i ][ 2 ] = ( uint8_t ) palette[ index ][ 2 ];
+		block[ i ][ 3 ] = ( !four_colour && index == 3 ) ? 0 : 255;
+	}
+}
+
+/************************************************************/
+
+void Dxt_EncodeImage( DxtFormat format, const uint8_t *rgba, unsigned int width, unsigned int height, uint8_t *out ) {
+	unsigned int block_size = Dxt_GetBlockSize( format );
+	for ( unsigned int by = 0; by < height; by += 4 ) {
+		for ( unsigned int bx = 0; bx < width; bx += 4 ) {
+			/* blocks hanging off the edge repeat the last row and column */
+			uint8_t block[ 16 ][ 4 ];
+			for ( unsigned int y = 0; y < 4; ++y ) {
+				unsigned int py = ( by + y < height ) ? by + y : height - 1;
+				for ( unsigned int x = 0; x < 4; ++x ) {
+					unsigned int px = ( bx + x < width ) ? bx + x : width - 1;
+					memcpy( block[ y * 4 + x ], rgba + ( ( size_t ) py * width + px ) * 4, 4 );
+				}
+			}
+
+			if ( format == DXT_FORMAT_BC1 ) {
+				Dxt_EncodeColourBlock( block, true, out );
+			} else {
+				Dxt_EncodeAlphaBlock( block, out );
+				Dxt_EncodeColourBlock( block, false, out + 8 );
+			}
+			out += block_size;
+		}
+	}
+}
+
+void Dxt_DecodeImage( DxtFormat format, const uint8_t *blocks, unsigned int width, unsigned int height, uint8_t *rgba ) {
+	unsigned int block_size = Dxt_GetBlockSize( format );
+	for ( unsigned int by = 0; by < height; by += 4 ) {
+		for ( unsigned int bx = 0; bx < width; bx += 4 ) {
+			uint8_t block[ 16 ][ 4 ];
+			if ( format == DXT_FORMAT_BC1 ) {
+				Dxt_DecodeColourBlock( blocks, true, block );
+			} else {
+				uint8_t alpha[ 16 ];
+				Dxt_DecodeAlphaBlock( blocks, alpha );
+				Dxt_DecodeColourBlock( blocks + 8, false, block );
+				for ( unsigned int i = 0; i < 16; ++i ) {
+					block[ i ][ 3 ] = alpha[ i ];
+				}
+			}
+			blocks += block_size;
+
+			for ( unsigned int y = 0; y < 4 && by + y < height; ++y ) {
+				for ( unsigned int x = 0; x < 4 && bx + x < width; ++x ) {
+					memcpy( rgba + ( ( size_t ) ( by + y ) * width + bx + x ) * 4, block[ y * 4 + x ], 4 );
+				}
+			}
+		}
+	}
+}
+
+/************************************************************/
+/* Container */
+
+static unsigned int Dxt_GetNumLevels( unsigned int width, unsigned int height ) {
+	unsigned int size = width > height ? width : height;
+	unsigned int levels = 1;
+	while ( size > 1 && levels < DXT_MAX_LEVELS ) {
+		size >>= 1;
+		levels++;
+	}
+
+	return levels;
+}
+
+/* 2x2 box filter, repeating the last row or column for odd sizes */
+static void Dxt_Downsample( const uint8_t *src, unsigned int src_width, unsigned int src_height,
+							uint8_t *dst, unsigned int dst_width, unsigned int dst_height ) {
+	for ( unsigned int y = 0; y < dst_height; ++y ) {
+		unsigned int y0 = ( y * 2 < src_height ) ? y * 2 : src_height - 1;
+		unsigned int y1 = ( y * 2 + 1 < src_height ) ? y * 2 + 1 : src_height - 1;
+		for ( unsigned int x = 0; x < dst_width; ++x ) {
+			unsigned int x0 = ( x * 2 < src_width ) ? x * 2 : src_width - 1;
+			unsigned int x1 = ( x * 2 + 1 < src_width ) ? x * 2 + 1 : src_width - 1;
+			const uint8_t *a = src + ( ( size_t ) y0 * src_width + x0 ) * 4;
+			const uint8_t *b = src + ( ( size_t ) y0 * src_width + x1 ) * 4;
+			const uint8_t *c = src + ( ( size_t ) y1 * src_width + x0 ) * 4;
+			const uint8_t *d = src + ( ( size_t ) y1 * src_width + x1 ) * 4;
+			uint8_t *out = dst + ( ( size_t ) y * dst_width + x ) * 4;
+			for ( unsigned int i = 0; i < 4; ++i ) {
+				out[ i ] = ( uint8_t ) ( ( a[ i ] + b[ i ] + c[ i ] + d[ i ] + 2 ) >> 2 );
+			}
+		}
+	}
+}
+
+DxtHandle *Dxt_CreateHandle( DxtFormat format, const uint8_t *rgba, unsigned int width, unsigned int height ) {
+	if ( width == 0 || height == 0 ) {
+		LogWarn( "Invalid dimensions for compression, %ux%u!\n", width, height );
+		return NULL;
+	}
+
+	DxtHandle *handle = u_alloc( 1, sizeof( DxtHandle ), true );
+	handle->format = format;
+	handle->width = width;
+	handle->height = height;
+	handle->num_levels = Dxt_GetNumLevels( width, height );
+
+	uint8_t *pixels = u_alloc( ( size_t ) width * height, 4, true );
+	memcpy( pixels, rgba, ( size_t ) width * height * 4 );
+
+	unsigned int level_width = width, level_height = height;
+	for ( unsigned int i = 0; i < handle->num_levels; ++i ) {
+		handle->levels[ i ] = u_alloc( 1, Dxt_GetLevelSize( format, level_width, level_height ), true );
+		Dxt_EncodeImage( format, pixels, level_width, level_height, handle->levels[ i ] );
+		if ( i + 1 == handle->num_levels ) {
+			break;
+		}
+
+		unsigned int next_width = level_width > 1 ? level_width / 2 : 1;
+		unsigned int next_height = level_height > 1 ? level_height / 2 : 1;
+		uint8_t *next = u_alloc( ( size_t ) next_width * next_height, 4, true );
+		Dxt_Downsample( pixels, level_width, level_height, next, next_width, next_height );
+		free( pixels );
+		pixels = next;
+		level_width = next_width;
+		level_height = next_height;
+	}
+
+	free( pixels );
+
+	return handle;
+}
+
+DxtHandle *Dxt_LoadFile( const char *path ) {
+	PLFile *filePtr = plOpenFile( path, false );
+	if ( filePtr == NULL ) {
+		LogWarn( "Failed to load Dxt \"%s\", aborting!\nPL: %s\n", path, plGetError() );
+		return NULL;
+	}
+
+	DxtHeader header;
+	if ( plReadFile( filePtr, &header, sizeof( DxtHeader ), 1 ) != 1 ||
+		strncmp( header.magic, DXT_MAGIC, 4 ) != 0 || header.version != DXT_VERSION ) {
+		plCloseFile( filePtr );
+		LogWarn( "Invalid or outdated header in Dxt \"%s\"!\n", path );
+		return NULL;
+	}
+
+	if ( ( header.format != DXT_FORMAT_BC1 && header.format != DXT_FORMAT_BC3 ) ||
+		header.width == 0 || header.height == 0 ||
+		header.num_levels == 0 || header.num_levels > Dxt_GetNumLevels( header.width, header.height ) ) {
+		plCloseFile( filePtr );
+		LogWarn( "Unexpected format or dimensions in Dxt \"%s\"!\n", path );
+		return NULL;
+	}
+
+	DxtHandle *handle = u_alloc( 1, sizeof( DxtHandle ), true );
+	handle->format = ( DxtFormat ) header.format;
+	handle->width = header.width;
+	handle->height = header.height;
+	handle->num_levels = header.num_levels;
+
+	for ( unsigned int i = 0; i < handle->num_levels; ++i ) {
+		unsigned int level_width = handle->width >> i, level_height = handle->height >> i;
+		size_t size = Dxt_GetLevelSize( handle->format, level_width > 0 ? level_width : 1, level_height > 0 ? level_height : 1 );
+		handle->levels[ i ] = u_alloc( 1, size, true );
+		if ( plReadFile( filePtr, handle->levels[ i ], size, 1 ) != 1 ) {
+			plCloseFile( filePtr );
+			LogWarn( "Failed to read in level %u, \"%s\"!\nPL: %s\n", i, path, plGetError() );
+			Dxt_DestroyHandle( handle );
+			return NULL;
+		}
+	}
+
+	plCloseFile( filePtr );
+
+	return handle;
+}
+
+bool Dxt_WriteFile( const DxtHandle *handle, const char *path ) {
+	FILE *fp = fopen( path, "wb" );
+	if ( fp == NULL ) {
+		LogWarn( "Failed to open, \"%s\"!\n", path );
+		return false;
+	}
+
+	DxtHeader header;
+	memcpy( header.magic, DXT_MAGIC, 4 );
+	header.version = DXT_VERSION;
+	header.format = handle->format;
+	header.width = handle->width;
+	header.height = handle->height;
+	header.num_levels = handle->num_levels;
+	bool status = ( fwrite( &header, sizeof( DxtHeader ), 1, fp ) == 1 );
+
+	for ( unsigned int i = 0; i < handle->num_levels && status; ++i ) {
+		unsigned int level_width = handle->width >> i, level_height = handle->height >> i;
+		size_t size = Dxt_GetLevelSize( handle->format, level_width > 0 ? level_width : 1, level_height > 0 ? level_height : 1 );
+		status = ( fwrite( handle->levels[ i ], size, 1, fp ) == 1 );
+	}
+
+	fclose( fp );
+
+	if ( !status ) {
+		LogWarn( "Failed to write out \"%s\"!\n", path );
+	}
+
+	return status;
+}
+
+void Dxt_DestroyHandle( DxtHandle *handle ) {
+	if ( handle == NULL ) {
+		return;
+	}
+
+	for ( unsigned int i = 0; i < handle->num_levels; ++i ) {
+		free( handle->levels[ i ] );
+	}
+
+	free( handle );
+}
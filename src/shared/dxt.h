@@ -0,0 +1,53 @@
+/* OpenHoW
+ * Copyright (C) 2017-2020 Mark Sowden <markelswo@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+PL_EXTERN_C
+
+/* bump whenever the layout of the container changes */
+#define DXT_VERSION     1
+#define DXT_MAX_LEVELS  16
+
+typedef enum DxtFormat {
+	DXT_FORMAT_BC1 = 1, /* 4bpp, colour with optional 1-bit alpha */
+	DXT_FORMAT_BC3 = 3, /* 8bpp, colour with full alpha */
+} DxtFormat;
+
+typedef struct DxtHandle {
+	DxtFormat format;
+	unsigned int width, height;
+
+	/* each level is half the size of the one before, down to 1x1 */
+	unsigned int num_levels;
+	uint8_t *levels[DXT_MAX_LEVELS];
+} DxtHandle;
+
+size_t Dxt_GetLevelSize( DxtFormat format, unsigned int width, unsigned int height );
+/* BC1 if every pixel is either fully opaque or fully transparent, otherwise BC3 */
+DxtFormat Dxt_GetBestFormat( const uint8_t *rgba, unsigned int width, unsigned int height );
+
+void Dxt_EncodeImage( DxtFormat format, const uint8_t *rgba, unsigned int width, unsigned int height, uint8_t *out );
+void Dxt_DecodeImage( DxtFormat format, const uint8_t *blocks, unsigned int width, unsigned int height, uint8_t *rgba );
+
+/* encodes the image, along with a full chain of mips generated from it */
+DxtHandle *Dxt_CreateHandle( DxtFormat format, const uint8_t *rgba, unsigned int width, unsigned int height );
+DxtHandle *Dxt_LoadFile( const char *path );
+bool Dxt_WriteFile( const DxtHandle *handle, const char *path );
+void Dxt_DestroyHandle( DxtHandle *handle );
+
+PL_EXTERN_C_END
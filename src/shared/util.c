@@ -109,3 +109,14 @@ const char* u_find2( const char* path, const char** preference, bool abort_on_fa
 	//LogDebug( "Found \"%s\"\n", out );
 	return out;
 }
+
+/****************************************************/
+/* Hashing */
+
+uint64_t u_hash( const void* data, size_t length, uint64_t hash ) {
+	const uint8_t* bytes = ( const uint8_t* ) data;
+	for ( size_t i = 0; i < length; ++i ) {
+		hash = ( hash ^ bytes[ i ] ) * 1099511628211ULL;
+	}
+	return hash;
+}
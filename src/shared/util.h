@@ -75,6 +75,11 @@ const char* u_find2(const char* path, const char** preference, bool abort_on_fai
 
 FILE* u_open(const char* path, const char* mode, bool abort_on_fail);
 
+/* FNV-1a, either started off from U_HASH_SEED, or carried on from
+ * the result of a previous call to hash several buffers as one */
+#define U_HASH_SEED 14695981039346656037ULL
+uint64_t u_hash(const void* data, size_t length, uint64_t hash);
+
 PL_EXTERN_C_END
 
 #ifdef _DEBUG
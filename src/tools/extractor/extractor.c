@@ -21,6 +21,7 @@
 #include "extractor.h"
 
 #include "../../shared/fac.h"
+#include "../../shared/dxt.h"
 
 static char g_input_path[PL_SYSTEM_MAX_PATH] = { '\0' };
 static char g_output_path[PL_SYSTEM_MAX_PATH];
@@ -31,6 +32,27 @@ static char g_output_path[PL_SYSTEM_MAX_PATH];
 /************************************************************/
 /* Data Conversion */
 
+/* writes a block compressed copy of an RGBA8 image alongside
+ * its PNG, which the engine will load in preference to it */
+static void WriteCompressedImage( const PLImage *image, const char *png_path ) {
+	char out_path[PL_SYSTEM_MAX_PATH];
+	plStripExtension( out_path, sizeof( out_path ), png_path );
+	strcat( out_path, ".dxt" );
+
+	DxtFormat format = Dxt_GetBestFormat( image->data[ 0 ], image->width, image->height );
+	DxtHandle *handle = Dxt_CreateHandle( format, image->data[ 0 ], image->width, image->height );
+	if ( handle == NULL ) {
+		LogWarn( "Failed to compress \"%s\"!\n", png_path );
+		return;
+	}
+
+	if ( !Dxt_WriteFile( handle, out_path ) ) {
+		LogWarn( "Failed to write DXT, \"%s\"!\n", out_path );
+	}
+
+	Dxt_DestroyHandle( handle );
+}
+
 static void ConvertImageToPng( const char *path ) {
 	LogInfo( "Converting %s...\n", path );
 
@@ -58,6 +80,8 @@ static void ConvertImageToPng( const char *path ) {
 				plReplaceImageColour( &image, PLColour( 255, 0, 255, 255 ), PLColour( 0, 0, 0, 0 ) );
 				if ( !plWriteImage( &image, out_path ) ) {
 					LogWarn( "Failed to write PNG, \"%s\" (%s)!\n", out_path, plGetError() );
+				} else {
+					WriteCompressedImage( &image, out_path );
 				}
 			} else {
 				LogWarn( "Failed to convert \"%s\", %s, aborting!\n", path, plGetError() );
@@ -459,7 +483,9 @@ static void MergeTextureTargets( void ) {
 		}
 
 		LogInfo( "Writing %s\n", merge->output );
-		plWriteImage( output, merge->output );
+		if ( plWriteImage( output, merge->output ) ) {
+			WriteCompressedImage( output, merge->output );
+		}
 		plDestroyImage( output );
 	}
 }